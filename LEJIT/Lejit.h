@@ -39,7 +39,13 @@
 struct LEJITReader_C;
 typedef struct LEJITReader_C LEJITReader_C;
 
+// Opaque handle to a registered function callback. Stays valid for the lifetime
+// of the reader, and always calls the most recently JITted version of the callback
+struct LEJITFunc_C;
+typedef struct LEJITFunc_C LEJITFunc_C;
+
 LEJITReader_C * LEJITReader_Create(const char *filename);
+void LEJITReader_Destroy(LEJITReader_C *reader);
 
 // Register Params
 void LEJITReader_RegisterInt(LEJITReader_C *reader, const char *id, int def_val);
@@ -47,18 +53,18 @@ void LEJITReader_RegisterDouble(LEJITReader_C *reader, const char *id, double de
 void LEJITReader_RegisterString(LEJITReader_C *reader, const char *id, char *def_val);
 void LEJITReader_RegisterArray_Int1D(LEJITReader_C *reader, const char *id, int def_val[], int length);
 void LEJITReader_RegisterArray_Double1D(LEJITReader_C *reader, const char *id, double def_val[], int length);
-void LEJITReader_RegisterFunction_i(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_ii_i(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_ii(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_d(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction__d(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_dd(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_dd_d(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_ddd_d(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_ai(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_ad(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_aiai(LEJITReader_C *reader, const char *id);
-void LEJITReader_RegisterFunction_adad(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_i(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_ii_i(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_ii(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction__d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_dd(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_dd_d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_ddd_d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_ai(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_ad(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_aiai(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_RegisterFunction_adad(LEJITReader_C *reader, const char *id);
 
 // Read Params
 void LEJITReader_ReadInt(LEJITReader_C *reader, const char *id, int *ptr);
@@ -69,18 +75,18 @@ void LEJITReader_ReadArray_Double1D(LEJITReader_C *reader, const char *id, doubl
 
 // Read function callbacks - reads function definition out of Lua config file and JIT compiles it.
 // Call the corresponding CallLuaFunction in order to execute it
-void LEJITReader_ReadFunction_i(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_ii_i(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_ii(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_d(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction__d(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_dd(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_dd_d(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_ddd_d(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_ai(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_ad(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_aiai(LEJITReader_C *reader, const char *id);
-void LEJITReader_ReadFunction_adad(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_i(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_ii_i(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_ii(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction__d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_dd(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_dd_d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_ddd_d(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_ai(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_ad(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_aiai(LEJITReader_C *reader, const char *id);
+LEJITFunc_C * LEJITReader_ReadFunction_adad(LEJITReader_C *reader, const char *id);
 
 // Call function callbacks - calls the most recently JITted version of the callback
 void LEJITReader_CallFunction_i(LEJITReader_C *reader, const char *id, int arg0);
@@ -96,7 +102,109 @@ void LEJITReader_CallFunction_ad(LEJITReader_C *reader, const char *id, double a
 void LEJITReader_CallFunction_aiai(LEJITReader_C *reader, const char *id, int arg0[], int arg1[]);
 void LEJITReader_CallFunction_adad(LEJITReader_C *reader, const char *id, double arg0[], double arg1[]);
 
+// Call function callbacks through a handle returned by Register or Read. Skips looking the
+// callback up by name, so these are preferred in inner loops
+void LEJITFunc_Call_i(LEJITFunc_C *func, int arg0);
+void LEJITFunc_Call_ii(LEJITFunc_C *func, int arg0, int arg1);
+void LEJITFunc_Call_ii_i(LEJITFunc_C *func, int arg0, int arg1, int *arg2);
+void LEJITFunc_Call_d(LEJITFunc_C *func, double arg0);
+void LEJITFunc_Call__d(LEJITFunc_C *func, double *arg0);
+void LEJITFunc_Call_dd(LEJITFunc_C *func, double arg0, double arg1);
+void LEJITFunc_Call_dd_d(LEJITFunc_C *func, double arg0, double arg1, double *arg2);
+void LEJITFunc_Call_ddd_d(LEJITFunc_C *func, double arg0, double arg1, double arg2, double *arg3);
+void LEJITFunc_Call_ai(LEJITFunc_C *func, int arg0[]);
+void LEJITFunc_Call_ad(LEJITFunc_C *func, double arg0[]);
+void LEJITFunc_Call_aiai(LEJITFunc_C *func, int arg0[], int arg1[]);
+void LEJITFunc_Call_adad(LEJITFunc_C *func, double arg0[], double arg1[]);
+
+// Read batched function callbacks - reads the batched form of a callback with scalar arguments,
+// which takes an element count n and one array of n values per argument. The Lua function is
+// called for each element from a loop running in Lua. Outparam arrays receive the results
+void LEJITReader_ReadBatchFunction_i(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction_ii(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction_ii_i(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction_d(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction__d(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction_dd(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction_dd_d(LEJITReader_C *reader, const char *id);
+void LEJITReader_ReadBatchFunction_ddd_d(LEJITReader_C *reader, const char *id);
+
+// Call batched function callbacks - calls the most recently JITted batched form of the callback
+void LEJITReader_CallBatchFunction_i(LEJITReader_C *reader, const char *id, int n, int arg0[]);
+void LEJITReader_CallBatchFunction_ii(LEJITReader_C *reader, const char *id, int n, int arg0[], int arg1[]);
+void LEJITReader_CallBatchFunction_ii_i(LEJITReader_C *reader, const char *id, int n, int arg0[], int arg1[], int arg2[]);
+void LEJITReader_CallBatchFunction_d(LEJITReader_C *reader, const char *id, int n, double arg0[]);
+void LEJITReader_CallBatchFunction__d(LEJITReader_C *reader, const char *id, int n, double arg0[]);
+void LEJITReader_CallBatchFunction_dd(LEJITReader_C *reader, const char *id, int n, double arg0[], double arg1[]);
+void LEJITReader_CallBatchFunction_dd_d(LEJITReader_C *reader, const char *id, int n, double arg0[], double arg1[], double arg2[]);
+void LEJITReader_CallBatchFunction_ddd_d(LEJITReader_C *reader, const char *id, int n, double arg0[], double arg1[], double arg2[], double arg3[]);
+
+// Call batched function callbacks through a handle returned by Register or Read
+void LEJITFunc_CallBatch_i(LEJITFunc_C *func, int n, int arg0[]);
+void LEJITFunc_CallBatch_ii(LEJITFunc_C *func, int n, int arg0[], int arg1[]);
+void LEJITFunc_CallBatch_ii_i(LEJITFunc_C *func, int n, int arg0[], int arg1[], int arg2[]);
+void LEJITFunc_CallBatch_d(LEJITFunc_C *func, int n, double arg0[]);
+void LEJITFunc_CallBatch__d(LEJITFunc_C *func, int n, double arg0[]);
+void LEJITFunc_CallBatch_dd(LEJITFunc_C *func, int n, double arg0[], double arg1[]);
+void LEJITFunc_CallBatch_dd_d(LEJITFunc_C *func, int n, double arg0[], double arg1[], double arg2[]);
+void LEJITFunc_CallBatch_ddd_d(LEJITFunc_C *func, int n, double arg0[], double arg1[], double arg2[], double arg3[]);
+
+// Let function callbacks be called from several threads at once
+void LEJITReader_EnableThreads(LEJITReader_C *reader);
+
+// Write call statistics of function callbacks as JSON
+int LEJITReader_WriteStatsFile(LEJITReader_C *reader, const char *filename);
+void LEJITReader_WriteStatsAtExit(LEJITReader_C *reader, const char *filename);
+
+// Time calls to function callbacks as well as counting them
+void LEJITReader_SetStatsTiming(LEJITReader_C *reader, int timing);
+
+// Set directory config file bytecode is cached in, empty string to disable
+void LEJITReader_SetBytecodeCache(LEJITReader_C *reader, const char *cache_dir);
+
+// Reload config file if it changed, returns 1 if it did
+int LEJITReader_ReloadIfChanged(LEJITReader_C *reader);
+
+// Call callback with data after each reload that changes the parameter, and after the first load
+void LEJITReader_OnChange(LEJITReader_C *reader, const char *id, void (*callback)(void *), void *data);
+
+// Bind Params - registers a parameter whose default is the current value at ptr, and
+// writes the value in the config file to ptr on each RefreshAll
+void LEJITReader_BindInt(LEJITReader_C *reader, const char *id, int *ptr);
+void LEJITReader_BindDouble(LEJITReader_C *reader, const char *id, double *ptr);
+void LEJITReader_BindArray_Int1D(LEJITReader_C *reader, const char *id, int *ptr, int length);
+void LEJITReader_BindArray_Double1D(LEJITReader_C *reader, const char *id, double *ptr, int length);
+void LEJITReader_RefreshAll(LEJITReader_C *reader);
+
+// Declare a function parameter with only int, double and bool arguments pure, caching
+// up to entries of its results, or a default number if entries is 0
+void LEJITReader_SetPure(LEJITReader_C *reader, const char *id, int entries);
+
+// Serve calls to a d>d or dd>d function parameter from a table of its values sampled on
+// an nx (by ny) grid, interpolated linearly. tolerance of 0 skips the error check
+void LEJITReader_Tabulate1D(LEJITReader_C *reader, const char *id, double x0, double x1, int nx, double tolerance);
+void LEJITReader_Tabulate2D(LEJITReader_C *reader, const char *id, double x0, double x1, int nx, double y0, double y1, int ny, double tolerance);
+
+// Compile a function parameter written in the numeric subset of Lua the native tier
+// supports to C, or call Lua again if native is 0
+void LEJITReader_SetNative(LEJITReader_C *reader, const char *id, int native);
+
+// Set the command native function parameters are compiled with
+void LEJITReader_SetNativeCompiler(LEJITReader_C *reader, const char *command);
+
+// Share evaluated config files between processes on the node through POSIX shared
+// memory, prefix NULL for the default, waiting up to timeout seconds for another
+// process to publish it
+void LEJITReader_EnableSharedConfig(LEJITReader_C *reader, const char *prefix, double timeout);
+
+// Remove the shared memory the current config file was published in
+void LEJITReader_RemoveSharedConfig(LEJITReader_C *reader);
+
 // Write config file
 int LEJITReader_WriteConfigFile(LEJITReader_C *reader);
 
+// Write the parameters of the config file as constants to a C++ header, read by
+// C++ code built with LEJIT_FROZEN
+int LEJITReader_WriteFrozenHeader(LEJITReader_C *reader, const char *filename);
+
 #endif
\ No newline at end of file
@@ -27,6 +27,9 @@
  *	C++ 1D, 2D, or 3D vector of int, double, boolean or std::string
  *	C++ std::function of any signature containing int, double, 
  *		boolean or 1D array of those types
+ *	NDArray of any rank
+ *
+ * See the Readme for the features built on top of these.
  */
 
 /*
@@ -36,6 +39,11 @@
  * b = bool
  * s = string (either std::string or char *)
  * a* = 1D array of non-array type * with no length specified (no bounds checking)
+ *      (any digits following an array type are ignored)
+ * c* = 1D array of type i, d or b passed to Lua as a zero-based LuaJIT FFI cdata
+ *      pointer. No allocation per call and element access is JIT compiled, but
+ *      there is no bounds checking, so pass the length as a separate int argument.
+ *      Must be an inparam; the Lua function writes to the array in place.
  * > = marks end of in parameters (arguments) and beginning of out parameters (results)
  *
  * All function parameters must have a void return values and return by reference (out parameter)
@@ -46,6 +54,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include <stdarg.h>
 #include <string>
 #include <vector>
@@ -56,10 +65,33 @@
 #include <regex>
 
 #include "Param.hpp"
+#include "Parallel.hpp"
 
 // Default filename for Lua config file
 #define DEFAULT_FILENAME "config.lua"
 
+// Default directory for cached config file bytecode, relative to the config file
+#define DEFAULT_CACHE_DIR ".lejit_cache"
+
+// Default number of elements from which writeConfigFile puts array defaults in
+// binary sidecar files instead of Lua tables
+#define DEFAULT_SIDECAR_THRESHOLD 65536
+
+// Default prefix of the names of shared memory objects configs are published
+// in, and the default number of seconds to wait for another process to
+// publish one
+#define DEFAULT_SHARED_PREFIX "/lejit_"
+#define DEFAULT_SHARED_TIMEOUT 60.0
+
+// Default number of entries in the result cache of a pure function parameter
+#define DEFAULT_MEMO_ENTRIES 4096
+
+// Header written by writeFrozenHeader which builds with LEJIT_FROZEN read
+// parameters from
+#ifndef LEJIT_FROZEN_HEADER
+#define LEJIT_FROZEN_HEADER "lejit_frozen.hpp"
+#endif
+
 /*
  * Class LEJITReader
  *		Used keep track of registered configurable parameters, write the Lua
@@ -71,9 +103,85 @@ private:
 	// Name of Lua config file to be written / read from
 	std::string filename;
 
+	// Directory of the config file with a trailing slash, empty if it is the
+	// working directory
+	std::string dir;
+
+	// Owner of L, shared with the function parameters and the callables read
+	// from them, so the state is only closed once all of them are gone
+	std::shared_ptr<lua_State> owner;
+
 	// Lua execution state
 	lua_State *L;
 
+	// True once the config file has been evaluated into the parameter snapshot
+	bool loaded;
+
+	// Per thread Lua states function parameters are called in. Null unless
+	// threads are enabled
+	std::shared_ptr<LuaStatePool> pool;
+
+	// Number of threads and chunk size used by parallelMap and parallelReduce
+	int num_threads, grain;
+
+	// Directory config file bytecode is cached in, empty if caching is disabled
+	std::string cache_dir;
+
+	// Number of config file loads served from and missing from the bytecode cache
+	size_t cache_hits, cache_misses;
+
+	// Compiler of native function parameters, caching them next to the
+	// config file bytecode
+	std::shared_ptr<NativeCompiler> native;
+
+	// Number of elements from which array defaults are written to sidecar
+	// files, 0 to always write Lua tables
+	size_t sidecar_threshold;
+
+	// Modification time in nanoseconds, size, inode and content hash of the
+	// config file when it was last checked for changes, and the time its
+	// contents were last hashed
+	uint64_t config_mtime;
+	off_t config_size;
+	ino_t config_ino;
+	uint64_t config_hash;
+	time_t config_hashed;
+
+	// Identifiers of the parameters which changed in the last reload
+	std::vector<std::string> changed;
+
+	// Prefix of the names of the shared memory objects the config file is
+	// published in, empty unless shared configs are enabled, and the number of
+	// seconds to wait for another process to publish it
+	std::string shared_prefix;
+	double shared_timeout;
+
+	// Name of the shared memory objects of the config file last loaded
+	std::string shared_name;
+
+	// True if the last load was served from a config published by another
+	// process
+	bool shared_loaded;
+
+	// True if calls to function parameters are timed as well as counted
+	bool stats_timing;
+
+	// Loads and runs the config file in the reader's state, returning its
+	// bytecode if dump is set or it is needed by per thread states
+	std::string evaluateConfig(bool dump);
+
+	// Loads the snapshot from a config published by another process on the
+	// node, or evaluates and publishes it. Returns false if the caller has to
+	// evaluate the config file itself
+	bool reloadShared();
+
+	// Checks if the config file changed since it was last checked
+	bool configChanged();
+
+	// Writes the snapshotted value of each bound parameter into the user's
+	// variable, by identifier
+	std::map<std::string, std::function<void()>> bindings;
+
 	// List of all registered configurable parameters regardless of type
 	std::map<std::string,Param*> paramlist;
 
@@ -90,6 +198,23 @@ private:
 	// Same as isRegistered but throws an error if not found
 	Param * checkRegistered(std::string id, std::type_index type);
 
+	// Same as checkRegistered but also makes sure the parameter has a value
+	// in the config file snapshot
+	Param * checkSnapshot(std::string id, std::type_index type);
+	Param * checkSnapshot(Param *p);
+
+	// Tabulates a registered function parameter over the domain in spec
+	void tabulateParam(std::string id, const LuaTableSpec &spec);
+
+	// Finds a registered function parameter by the type of its batched form
+	template <typename ...bargs> BatchParam<bargs...> * checkBatchRegistered(std::string id);
+
+	// Helper function to check that a config file array is long enough
+	void checkLength(std::string id, size_t length, size_t expected);
+
+	// Adds a newly registered parameter to the parameter list
+	void addParam(Param *p);
+
 	// Helper functions for converting C-style arrays to C++ vectors
 	template<typename T, size_t size> std::vector<T> convert1DArray(T (&arr)[size]);
 	template<typename T, size_t rows, size_t cols> std::vector<std::vector<T>> convert2DArray(T (&arr)[rows][cols]);
@@ -101,39 +226,88 @@ public:
 	LEJITReader() : LEJITReader(DEFAULT_FILENAME) {};
 	LEJITReader(std::string filename, bool torch_enabled = 0, bool gnuplot_enabled = 0);
 
+	// Destructor. Functions read from the reader keep its Lua state open
+	// until the last of them is destroyed
+	~LEJITReader();
+
+	LEJITReader(const LEJITReader&) = delete;
+	LEJITReader& operator=(const LEJITReader&) = delete;
+
 	// Template version for all non-array, non-function supported types
 	template<typename T> void registerParam(std::string id, T def_val);
 	template<typename T> void registerParam(std::string id, T def_val, std::string doc);
+	template<typename T> void registerParam(std::string id, T def_val, std::string doc, std::function<void()> on_change);
 
 	// Specialization for C++ std::functions
 	template<typename ...args> void registerParam(std::string id, std::function<void(args...)> def_val);
 	template<typename ...args> void registerParam(std::string id, std::function<void(args...)> def_val, std::string doc);
 	template<typename ...args> void registerParam(std::string id, std::string signature, std::function<void(args...)> def_val);
 	template<typename ...args> void registerParam(std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc);
+	template<typename ...args> void registerParam(std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc, std::function<void()> on_change);
 
 	// Specialization for 1D C-style array types
 	template<typename T, size_t size> void registerParam(std::string id, T (&def_val)[size]);
 	template<typename T, size_t size> void registerParam(std::string id, T (&def_val)[size], std::string doc);
+	template<typename T, size_t size> void registerParam(std::string id, T (&def_val)[size], std::string doc, std::function<void()> on_change);
 
 	// Specialization for 1D C++ dynamic array (vector) types
 	template<typename T> void registerParam(std::string id, std::vector<T> def_val);
 	template<typename T> void registerParam(std::string id, std::vector<T> def_val, std::string doc);
+	template<typename T> void registerParam(std::string id, std::vector<T> def_val, std::string doc, std::function<void()> on_change);
 
 	// Specialization for 2D C-style array types
 	template<typename T, size_t rows, size_t cols> void registerParam(std::string id, T (&def_val)[rows][cols]);
 	template<typename T, size_t rows, size_t cols> void registerParam(std::string id, T (&def_val)[rows][cols], std::string doc);
+	template<typename T, size_t rows, size_t cols> void registerParam(std::string id, T (&def_val)[rows][cols], std::string doc, std::function<void()> on_change);
 
 	// Specialization for 2D C++ vector types
 	template<typename T> void registerParam(std::string id, std::vector<std::vector<T>> def_val);
 	template<typename T> void registerParam(std::string id, std::vector<std::vector<T>> def_val, std::string doc);
+	template<typename T> void registerParam(std::string id, std::vector<std::vector<T>> def_val, std::string doc, std::function<void()> on_change);
 
 	// Specialization for 3D C-style array types
 	template<typename T, size_t rows, size_t cols, size_t depth> void registerParam(std::string id, T (&def_val)[rows][cols][depth]);
 	template<typename T, size_t rows, size_t cols, size_t depth> void registerParam(std::string id, T (&def_val)[rows][cols][depth], std::string doc);
+	template<typename T, size_t rows, size_t cols, size_t depth> void registerParam(std::string id, T (&def_val)[rows][cols][depth], std::string doc, std::function<void()> on_change);
 
 	// Specialization for 3D C++ vector types
 	template<typename T> void registerParam(std::string id, std::vector<std::vector<std::vector<T>>> def_val);
 	template<typename T> void registerParam(std::string id, std::vector<std::vector<std::vector<T>>> def_val, std::string doc);
+	template<typename T> void registerParam(std::string id, std::vector<std::vector<std::vector<T>>> def_val, std::string doc, std::function<void()> on_change);
+
+	// Adds a callback to a registered parameter, fired after each reload
+	// which changes its value
+	void onChange(std::string id, std::function<void()> on_change);
+
+	// Declares a function parameter with only scalar arguments pure, caching
+	// its results. Call it right after registering the parameter
+	void setPure(std::string id, size_t entries = DEFAULT_MEMO_ENTRIES);
+
+	// Serves calls to a d>d or dd>d function parameter from a table of nx (by
+	// ny) samples of it over [x0, x1] (by [y0, y1]), interpolated linearly.
+	// With a tolerance, warns and keeps calling Lua if the interpolation error
+	// halfway between samples is larger
+	void tabulateParam(std::string id, double x0, double x1, size_t nx, double tolerance = 0);
+	void tabulateParam(std::string id, double x0, double x1, size_t nx, double y0, double y1, size_t ny, double tolerance = 0);
+
+	// Compiles a function parameter to C each time it is bound, if it only
+	// uses the numeric subset of Lua the native tier supports. Otherwise it
+	// warns and keeps calling Lua. false goes back to calling Lua
+	void setNative(std::string id, bool native = true);
+
+	// Sets the command native function parameters are compiled with
+	void setNativeCompiler(std::string command);
+
+	// Registers a parameter bound to a variable, C-style array or vector. Its
+	// current contents are the default value, and refreshAll writes the value
+	// in the config file into it. The variable must outlive the reader
+	template<typename T> void bindParam(std::string id, T &var);
+	template<typename T> void bindParam(std::string id, T &var, std::string doc);
+	template<typename ...args> void bindParam(std::string id, std::string signature, std::function<void(args...)> &var, std::string doc);
+
+	// Same as bindParam, for a 1D array of size elements behind a pointer
+	template<typename T> void bindParam(std::string id, T *ptr, size_t size);
+	template<typename T> void bindParam(std::string id, T *ptr, size_t size, std::string doc);
 
 	// Template version for all non-array, non-function supported types
 	template<typename T> void readParam(std::string id, T &ptr);
@@ -155,14 +329,139 @@ public:
 	template<typename T, size_t arrdim0, size_t arrdim1> void readParam(std::string id, T *(&ptr)[arrdim0][arrdim1], size_t rows);
 	template<typename T, size_t rows, size_t cols, size_t depth> void readParam(std::string id, T (&ptr)[rows][cols][depth]);
 	template<typename T> void readParam(std::string id, std::vector<std::vector<std::vector<T>>> (&ptr));
+
+	// Specialization for reading a flat array of any rank into memory viewed
+	// by an NDView of the same shape, in one copy
+	template<typename T> void readParam(std::string id, NDView<T> view);
+
+	// Gets a view of a flat array parameter without copying it. Values mapped
+	// from sidecar files are used in place. Valid until a reload changes the
+	// parameter
+	template<typename T> NDView<const T> getArrayView(std::string id);
 	
+	// Reads the batched form of a function parameter with scalar arguments,
+	// taking an element count and one array per argument
+	template<typename ...bargs> void readBatchParam(std::string id, std::function<void(int, bargs...)> &ptr);
+
 	// Gets the most recently Jitted version of a function parameter
 	template <typename ...args> void getMostRecentFunc(std::string id, std::function<void(args...)> &ptr);
 
+	// Gets the registered function parameter itself, which stays valid for the
+	// lifetime of the reader
+	template <typename ...args> TypedParam<std::function<void(args...)>> * getFuncParam(std::string id);
+
+	// Gets the most recently Jitted batched form of a function parameter
+	template <typename ...bargs> void getMostRecentBatchFunc(std::string id, std::function<void(int, bargs...)> &ptr);
+
 	// Writes config file if it does not exist, does nothing and returns false if it does
 	bool writeConfigFile();
+
+	// Writes the snapshotted values of all parameters which can be C++
+	// constants to a header read by builds with LEJIT_FROZEN. Evaluates the
+	// config file if it hasn't been yet
+	bool writeFrozenHeader(std::string filename = LEJIT_FROZEN_HEADER);
+
+	// Sets the number of elements from which writeConfigFile writes array
+	// defaults to binary sidecar files. 0 always writes Lua tables
+	void setSidecarThreshold(size_t threshold) { this->sidecar_threshold = threshold; }
+
+	// Re-evaluates the config file and refreshes the snapshot readParam is served from
+	void reload();
+
+	// Reloads the config file and writes every bound parameter found in it
+	// into its variable
+	void refreshAll();
+
+	// Same as reload, but only if the config file changed since it was last
+	// evaluated. Cheap enough to call every timestep. Returns true if it reloaded
+	bool reloadIfChanged();
+
+	// Gets the identifiers of the parameters whose values or function
+	// definitions changed in the last reload
+	std::vector<std::string> getChanged() { return this->changed; }
+
+	// Sets the directory config file bytecode is cached in. An empty string
+	// disables the cache
+	void setBytecodeCache(std::string cache_dir);
+
+	// Number of config file loads served from and missing from the bytecode cache
+	size_t getCacheHits() { return this->cache_hits; }
+	size_t getCacheMisses() { return this->cache_misses; }
+
+	// Shares evaluated config files between processes on the node through
+	// POSIX shared memory objects named prefix followed by a hash. timeout is
+	// the number of seconds to wait for another process to publish the config
+	void enableSharedConfig(std::string prefix = DEFAULT_SHARED_PREFIX, double timeout = DEFAULT_SHARED_TIMEOUT);
+
+	// Removes the shared memory objects the current config file was published
+	// in. Processes which already loaded it are unaffected
+	void removeSharedConfig();
+
+	// True if the last load was served from a config published by another process
+	bool isSharedLoaded() { return this->shared_loaded; }
+
+	// Makes function parameters callable from several threads at once, each
+	// calling thread getting its own Lua state. Handles switch over at once,
+	// functions already read must be read again
+	void enableThreads();
+
+	// Gets the call statistics of a function parameter
+	LuaStatsValues getStats(std::string id);
+
+	// Gets the call statistics of all function parameters
+	std::map<std::string, LuaStatsValues> getAllStats();
+
+	// Sets the call statistics of all function parameters back to 0
+	void clearStats();
+
+	// Times calls to function parameters as well as counting them. Off by
+	// default, since it reads the clock twice per call
+	void setStatsTiming(bool timing);
+
+	// Writes the call statistics of all function parameters as JSON
+	std::string getStatsJSON();
+	bool writeStatsFile(std::string filename);
+
+	// Writes the call statistics to filename when the program exits, including
+	// when it exits because of a Lua error
+	void writeStatsAtExit(std::string filename);
+
+	// Sets the number of threads and the chunk size used by parallelMap and parallelReduce
+	void setParallelism(int num_threads, int grain = DEFAULT_GRAIN);
+
+	// Calls a function parameter with scalar arguments on each of the n
+	// elements of its argument arrays, spread across threads
+	template<typename ...bargs> void parallelMap(std::string id, int n, bargs... a);
+
+	// Calls a function parameter of type void(int, T*) on each index in
+	// [0, n), spread across threads, and combines the results with combine
+	template<typename T, typename F> T parallelReduce(std::string id, int n, T init, F combine);
 };
 
+// Frozen versions of readParam, reading the constant value of parameter id
+// out of the header written by writeFrozenHeader
+template<typename V, typename T> void lejit_readfrozen(const char *id, const V &value, T &ptr);
+template<typename V, size_t n, typename T> void lejit_readfrozen(const char *id, const V (&value)[n], std::vector<T> &ptr);
+template<typename V, size_t n, typename T> void lejit_readfrozen(const char *id, const V (&value)[n], T *(&ptr), size_t size);
+template<typename V, size_t n, typename T, size_t size> void lejit_readfrozen(const char *id, const V (&value)[n], T (&ptr)[size]);
+template<typename V, size_t n, size_t c, typename T, size_t arrdim> void lejit_readfrozen(const char *id, const V (&value)[n][c], T *(&ptr)[arrdim], size_t rows);
+template<typename V, size_t n, size_t c, typename T, size_t rows, size_t cols> void lejit_readfrozen(const char *id, const V (&value)[n][c], T (&ptr)[rows][cols]);
+template<typename V, size_t n, size_t c, size_t d, typename T, size_t arrdim0, size_t arrdim1> void lejit_readfrozen(const char *id, const V (&value)[n][c][d], T *(&ptr)[arrdim0][arrdim1], size_t rows);
+template<typename V, size_t n, size_t c, size_t d, typename T, size_t rows, size_t cols, size_t depth> void lejit_readfrozen(const char *id, const V (&value)[n][c][d], T (&ptr)[rows][cols][depth]);
+template<typename V, typename T> void lejit_readfrozen(const char *id, const V &value, NDView<T> view);
+
+/*
+ * LEJIT_READPARAM: reads parameter id, written without quotes, like readParam.
+ *		Built with LEJIT_FROZEN, it reads the constant in LEJIT_FROZEN_HEADER
+ *		instead, and the reader isn't used
+ */
+#ifdef LEJIT_FROZEN
+#include LEJIT_FROZEN_HEADER
+#define LEJIT_READPARAM(reader, id, ...) ((void) (reader), lejit_readfrozen(#id, lejit_frozen::id, __VA_ARGS__))
+#else
+#define LEJIT_READPARAM(reader, id, ...) (reader)->readParam(#id, __VA_ARGS__)
+#endif
+
 #include "Lejit.hxx"
 
 #endif
\ No newline at end of file
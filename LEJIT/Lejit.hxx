@@ -19,6 +19,8 @@
  */
 
 #include "Param.cpp"
+#include "Parallel.cpp"
+#include "Native.cpp"
 
 // Lua reserved words not allowed as parameter names
 #define LUA_RESERVED_WORDS "and|break|do|else|elseif|end|false|for|function|goto|if|in|local|nil|not|or|repeat|return|then|true|until|while"
@@ -37,6 +39,14 @@ extern "C"
 		return reinterpret_cast<LEJITReader_C*>( new LEJITReader(std::string(filename)) );
 	}
 
+	/*
+	 * destructor
+	 */
+	void LEJITReader_Destroy(LEJITReader_C *reader)
+	{
+		delete reinterpret_cast<LEJITReader*>(reader);
+	}
+
 	/*
 	 * C wrapper of registerParam for ints
 	 */
@@ -80,111 +90,135 @@ extern "C"
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "ii"
+	 * C wrapper of registerParam for function callbacks with signature "i".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_i(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_i(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "ii"
+	 * C wrapper of registerParam for function callbacks with signature "ii".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_ii(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_ii(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int,int)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int,int>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "ii>i"
+	 * C wrapper of registerParam for function callbacks with signature "ii>i".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_ii_i(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_ii_i(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int,int,int*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), "ii>i", stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int,int,int*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "d"
+	 * C wrapper of registerParam for function callbacks with signature "d".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature ">d"
+	 * C wrapper of registerParam for function callbacks with signature ">d".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction__d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction__d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), ">d", stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "dd"
+	 * C wrapper of registerParam for function callbacks with signature "dd".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_dd(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_dd(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double, double)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double, double>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "dd>d"
+	 * C wrapper of registerParam for function callbacks with signature "dd>d".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_dd_d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_dd_d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double, double, double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), "dd>d", stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double, double, double*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "ddd>d"
+	 * C wrapper of registerParam for function callbacks with signature "ddd>d".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_ddd_d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_ddd_d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double, double, double, double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), "ddd>d", stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double, double, double, double*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "ai"
+	 * C wrapper of registerParam for function callbacks with signature "ai".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_ai(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_ai(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "ad"
+	 * C wrapper of registerParam for function callbacks with signature "ad".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_ad(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_ad(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "aiai"
+	 * C wrapper of registerParam for function callbacks with signature "aiai".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_aiai(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_aiai(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int*,int*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int*,int*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper of registerParam for function callbacks with signature "adad"
+	 * C wrapper of registerParam for function callbacks with signature "adad".
+	 *	Returns a handle which can be used to call the function
 	 */
-	void LEJITReader_RegisterFunction_adad(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_RegisterFunction_adad(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double*,double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->registerParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double*,double*>(std::string(id)) );
 	}
 
 	/*
@@ -231,122 +265,146 @@ extern "C"
 
 	/*
 	 * C wrapper used to read function parameter with signature "i" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_i(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_i(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "ii" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_ii(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_ii(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int, int)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int, int>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "ii>i" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_ii_i(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_ii_i(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int, int, int*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int, int, int*>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "d" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature ">d" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction__d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction__d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double*>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "dd" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_dd(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_dd(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double, double)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double, double>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "dd>d" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_dd_d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_dd_d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double, double, double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double, double, double*>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "ddd>d" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_ddd_d(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_ddd_d(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double, double, double, double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double, double, double, double*>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "ai" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_ai(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_ai(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(int*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper used to read function parameter with signature "aiai" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 * C wrapper used to read function parameter with signature "ad" out of the config file
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_ad(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_ad(LEJITReader_C *reader, const char *id)
 	{
-		std::function<void(int*, int*)> stdf;
+		std::function<void(double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double*>(std::string(id)) );
 	}
 
 	/*
-	 * C wrapper used to read function parameter with signature "ad" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 * C wrapper used to read function parameter with signature "aiai" out of the config file
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_aiai(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_aiai(LEJITReader_C *reader, const char *id)
 	{
-		std::function<void(double*)> stdf;
+		std::function<void(int*, int*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<int*, int*>(std::string(id)) );
 	}
 
 	/*
 	 * C wrapper used to read function parameter with signature "adad" out of the config file
-	 *	and JIT compile it. Does not call the function.
+	 *	and JIT compile it. Does not call the function. Returns a handle which can be used to
+	 *	call the function
 	 */
-	void LEJITReader_ReadFunction_adad(LEJITReader_C *reader, const char *id)
+	LEJITFunc_C * LEJITReader_ReadFunction_adad(LEJITReader_C *reader, const char *id)
 	{
 		std::function<void(double*, double*)> stdf;
 		reinterpret_cast<LEJITReader*>(reader)->readParam(std::string(id), stdf);
+		return reinterpret_cast<LEJITFunc_C*>( reinterpret_cast<LEJITReader*>(reader)->getFuncParam<double*, double*>(std::string(id)) );
 	}
 
 	/*
@@ -470,223 +528,1340 @@ extern "C"
 	}
 
 	/*
-	 * C wrapper of writeConfigFile
+	 * C wrapper used to read the batched form of function parameter with signature "i" out
+	 *	of the config file and JIT compile it. Does not call the function.
 	 */
-	int LEJITReader_WriteConfigFile(LEJITReader_C *reader)
+	void LEJITReader_ReadBatchFunction_i(LEJITReader_C *reader, const char *id)
 	{
-		return reinterpret_cast<LEJITReader*>(reader)->writeConfigFile();
+		std::function<void(int, int*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
 	}
-}
 
-/* C++ implementations */
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature "ii" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction_ii(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, int*, int*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
+	}
 
-/*
- * filename LEJITReader constructor
- */
-LEJITReader::LEJITReader(std::string filename, bool torch_enabled, bool gnuplot_enabled)
-{
-	// Use given filename
-	this->filename = filename;
-	
-	// Create new Lua state and open standard libraries
-	this->L = luaL_newstate();
-	luaL_openlibs(this->L);
-	lua_openarray(this->L);
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature "ii>i" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction_ii_i(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, int*, int*, int*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
+	}
 
-	// Set library enable flags
-	this->torch_enabled = torch_enabled;
-	this->gnuplot_enabled = gnuplot_enabled;
-}
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature "d" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction_d(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
+	}
 
-/*
- * isLuaIdentifier: returns true if id is a valid Lua identifier and throws an
- *		error if not
- */
-bool LEJITReader::isLuaIdentifier(std::string id)
-{
-	std::regex rgx("[A-Za-z_][0-9A-Za-z_]*");
-	if (std::regex_match(id, rgx)) {
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature ">d" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction__d(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
+	}
 
-		// Check if it is a reserved word
-		std::regex reserved_words(LUA_RESERVED_WORDS);
-		if (!std::regex_match(id, reserved_words)) {
-			return true;
-		}
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature "dd" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction_dd(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, double*, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
 	}
 
-	throw std::invalid_argument(std::string("Parameter name '") + std::string(id.c_str())
-		+ std::string("' is not a valid Lua identifier."));
-}
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature "dd>d" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction_dd_d(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, double*, double*, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
+	}
 
-/*
- * this->isRegistered: returns the registered Param if a parameter has been registered with type type.
- * 		otherwise returns null. If the parameter has been registered with a
- *		different type, throws an error.
- */
-Param * LEJITReader::isRegistered(std::string id, std::type_index type)
-{
-	Param *p = nullptr;
-	try {
-		p = this->paramlist.at(id);
+	/*
+	 * C wrapper used to read the batched form of function parameter with signature "ddd>d" out
+	 *	of the config file and JIT compile it. Does not call the function.
+	 */
+	void LEJITReader_ReadBatchFunction_ddd_d(LEJITReader_C *reader, const char *id)
+	{
+		std::function<void(int, double*, double*, double*, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->readBatchParam(std::string(id), stdf);
 	}
-	catch (std::out_of_range& e) {
-		return p;
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "i" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_i(LEJITReader_C *reader, const char *id, int n, int arg0[])
+	{
+		std::function<void(int, int*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0);
 	}
 
-	if (p->getType() == type) {
-		return p;
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "ii" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_ii(LEJITReader_C *reader, const char *id, int n, int arg0[], int arg1[])
+	{
+		std::function<void(int, int*, int*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0, arg1);
 	}
-	else {
-		throw std::invalid_argument(std::string("Parameter name '") + std::string(id.c_str())
-			+ std::string("' is already registerd with a different type. Choose another identifier."));
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "ii>i" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_ii_i(LEJITReader_C *reader, const char *id, int n, int arg0[], int arg1[], int arg2[])
+	{
+		std::function<void(int, int*, int*, int*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0, arg1, arg2);
 	}
-}
 
-/*
- * this->checkRegistered: same as this->isRegistered but throws an error if the parameter is not found
- */
-Param * LEJITReader::checkRegistered(std::string id, std::type_index type)
-{
-	Param *p = this->isRegistered(id, type);
-	if (p) {
-		return p;
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "d" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_d(LEJITReader_C *reader, const char *id, int n, double arg0[])
+	{
+		std::function<void(int, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0);
 	}
-	else {
-		// If param not found
-		throw std::invalid_argument(std::string("Parameter '") + id
-		+ std::string("' is not registered. Register parameter before calling readParam\n"));
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature ">d" on n elements
+	 */
+	void LEJITReader_CallBatchFunction__d(LEJITReader_C *reader, const char *id, int n, double arg0[])
+	{
+		std::function<void(int, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0);
 	}
-}
 
-/*
- * convert1DArray: helper function to convert 1D c-style array types to std::vectors
- * 		arr: array to convert
- */
-template<typename T, size_t size> std::vector<T> LEJITReader::convert1DArray(T (&arr)[size])
-{
-	// Create and populate new std::vector
-	std::vector<T> v(arr, arr + size);
-	return v;
-}
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "dd" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_dd(LEJITReader_C *reader, const char *id, int n, double arg0[], double arg1[])
+	{
+		std::function<void(int, double*, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0, arg1);
+	}
 
-/*
- * convert2DArray: helper function to convert 2D c-style array types to std::vectors
- * 		arr: array to convert
- */
-template<typename T, size_t rows, size_t cols> std::vector<std::vector<T>> LEJITReader::convert2DArray(T (&arr)[rows][cols])
-{
-	// Create and populate new std::vector
-	std::vector<std::vector<T>> v;
-	for (int i = 0; i < rows; i++) {
-		std::vector<T> vi = convert1DArray(*(arr + i));
-		v.push_back(vi);
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "dd>d" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_dd_d(LEJITReader_C *reader, const char *id, int n, double arg0[], double arg1[], double arg2[])
+	{
+		std::function<void(int, double*, double*, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0, arg1, arg2);
 	}
-	return v;
-}
 
-/*
- * convert3DArray: helper function to convert 3D c-style array types to std::vectors
- * 		arr: array to convert
- */
-template<typename T, size_t rows, size_t cols, size_t depth> std::vector<std::vector<std::vector<T>>> LEJITReader::convert3DArray(T (&arr)[rows][cols][depth])
-{
-	// Create and populate new std::vector
-	std::vector<std::vector<std::vector<T>>> v;
-	for (int i = 0; i < rows; i++) {
-		std::vector<std::vector<T>> vi = convert2DArray(*(arr + i));
-		v.push_back(vi);
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "ddd>d" on n elements
+	 */
+	void LEJITReader_CallBatchFunction_ddd_d(LEJITReader_C *reader, const char *id, int n, double arg0[], double arg1[], double arg2[], double arg3[])
+	{
+		std::function<void(int, double*, double*, double*, double*)> stdf;
+		reinterpret_cast<LEJITReader*>(reader)->getMostRecentBatchFunc(std::string(id), stdf);
+		stdf(n, arg0, arg1, arg2, arg3);
 	}
-	return v;
-}
 
-/*
- * registerParam: template version to handle all non-array, non-function
- *		supported types
- *		Throws an error if the parameter name is an invalid Lua identifier
- *		or if it has already been registered as a different type. If it has
- *		already been registered as the same type, does nothing.
- *
- *		id: name to give parameter in Lua config file
- *		def_val: default value to assign the parameter in the Lua config file
- *			if the parameter is a function, it is not assigned def_val in the
- *			Lua config file, but appears as an empty function declaration
- *			(may be changed in the future)
- */
-template<typename T> void LEJITReader::registerParam(std::string id, T def_val)
-{
-	if (isLuaIdentifier(id)) {
-		if (this->isRegistered(id, type(T))) {
-			return;
-		}
-		else {
-			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<T>(id, def_val));
-		}
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "i"
+	 *	through a handle returned by LEJITReader_RegisterFunction_i or LEJITReader_ReadFunction_i
+	 */
+	void LEJITFunc_Call_i(LEJITFunc_C *func, int arg0)
+	{
+		reinterpret_cast<TypedParam<std::function<void(int)>>*>(func)->callMostRecent(arg0);
 	}
-}
 
-/*
- * registerParam: template version with optional docstring
- *		doc: string which appears as a doc comment accompanying the parameter
- *			in the Lua config file
- */
-template<typename T> void LEJITReader::registerParam(std::string id, T def_val, std::string doc)
-{
-	if (isLuaIdentifier(id)) {
-		if (this->isRegistered(id, type(T))) {
-			return;
-		}
-		else {
-			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<T>(id, def_val, doc));
-		}
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "ii"
+	 *	through a handle returned by LEJITReader_RegisterFunction_ii or LEJITReader_ReadFunction_ii
+	 */
+	void LEJITFunc_Call_ii(LEJITFunc_C *func, int arg0, int arg1)
+	{
+		reinterpret_cast<TypedParam<std::function<void(int, int)>>*>(func)->callMostRecent(arg0, arg1);
 	}
-}
 
-/*
- * registerParam: C++ std::function version
- */
-template<typename ...args> void LEJITReader::registerParam(std::string id, std::function<void(args...)> def_val)
-{
-	if (isLuaIdentifier(id)) {
-		if (this->isRegistered(id, type(std::function<void(args...)>))) {
-			return;
-		}
-		else {
-			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::function<void(args...)>>(this->L, id, def_val));
-		}
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "ii>i"
+	 *	through a handle returned by LEJITReader_RegisterFunction_ii_i or LEJITReader_ReadFunction_ii_i
+	 */
+	void LEJITFunc_Call_ii_i(LEJITFunc_C *func, int arg0, int arg1, int *arg2)
+	{
+		reinterpret_cast<TypedParam<std::function<void(int, int, int*)>>*>(func)->callMostRecent(arg0, arg1, arg2);
 	}
-}
 
-/*
- * registerParam: C++ std::function version with optional docstring
- */
-template<typename ...args> void LEJITReader::registerParam(std::string id, std::function<void(args...)> def_val, std::string doc)
-{
-	if (isLuaIdentifier(id)) {
-		if (this->isRegistered(id, type(std::function<void(args...)>))) {
-			return;
-		}
-		else {
-			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::function<void(args...)>>(this->L, id, def_val, doc));	
-		}
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "d"
+	 *	through a handle returned by LEJITReader_RegisterFunction_d or LEJITReader_ReadFunction_d
+	 */
+	void LEJITFunc_Call_d(LEJITFunc_C *func, double arg0)
+	{
+		reinterpret_cast<TypedParam<std::function<void(double)>>*>(func)->callMostRecent(arg0);
 	}
-}
 
-/*
- * registerParam: C++ std::function version with optional signature string
- */
-template<typename ...args> void LEJITReader::registerParam(std::string id, std::string signature, std::function<void(args...)> def_val)
-{
-	if (isLuaIdentifier(id)) {
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature ">d"
+	 *	through a handle returned by LEJITReader_RegisterFunction__d or LEJITReader_ReadFunction__d
+	 */
+	void LEJITFunc_Call__d(LEJITFunc_C *func, double *arg0)
+	{
+		reinterpret_cast<TypedParam<std::function<void(double*)>>*>(func)->callMostRecent(arg0);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "dd"
+	 *	through a handle returned by LEJITReader_RegisterFunction_dd or LEJITReader_ReadFunction_dd
+	 */
+	void LEJITFunc_Call_dd(LEJITFunc_C *func, double arg0, double arg1)
+	{
+		reinterpret_cast<TypedParam<std::function<void(double, double)>>*>(func)->callMostRecent(arg0, arg1);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "dd>d"
+	 *	through a handle returned by LEJITReader_RegisterFunction_dd_d or LEJITReader_ReadFunction_dd_d
+	 */
+	void LEJITFunc_Call_dd_d(LEJITFunc_C *func, double arg0, double arg1, double *arg2)
+	{
+		reinterpret_cast<TypedParam<std::function<void(double, double, double*)>>*>(func)->callMostRecent(arg0, arg1, arg2);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "ddd>d"
+	 *	through a handle returned by LEJITReader_RegisterFunction_ddd_d or LEJITReader_ReadFunction_ddd_d
+	 */
+	void LEJITFunc_Call_ddd_d(LEJITFunc_C *func, double arg0, double arg1, double arg2, double *arg3)
+	{
+		reinterpret_cast<TypedParam<std::function<void(double, double, double, double*)>>*>(func)->callMostRecent(arg0, arg1, arg2, arg3);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "ai"
+	 *	through a handle returned by LEJITReader_RegisterFunction_ai or LEJITReader_ReadFunction_ai
+	 */
+	void LEJITFunc_Call_ai(LEJITFunc_C *func, int arg0[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(int*)>>*>(func)->callMostRecent(arg0);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "ad"
+	 *	through a handle returned by LEJITReader_RegisterFunction_ad or LEJITReader_ReadFunction_ad
+	 */
+	void LEJITFunc_Call_ad(LEJITFunc_C *func, double arg0[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double*)>>*>(func)->callMostRecent(arg0);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "aiai"
+	 *	through a handle returned by LEJITReader_RegisterFunction_aiai or LEJITReader_ReadFunction_aiai
+	 */
+	void LEJITFunc_Call_aiai(LEJITFunc_C *func, int arg0[], int arg1[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(int*, int*)>>*>(func)->callMostRecent(arg0, arg1);
+	}
+
+	/*
+	 * C wrapper used to call most recently read version of function parameter with signature "adad"
+	 *	through a handle returned by LEJITReader_RegisterFunction_adad or LEJITReader_ReadFunction_adad
+	 */
+	void LEJITFunc_Call_adad(LEJITFunc_C *func, double arg0[], double arg1[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double*, double*)>>*>(func)->callMostRecent(arg0, arg1);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "i" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_i(LEJITFunc_C *func, int n, int arg0[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(int)>>*>(func)->callMostRecentBatch(n, arg0);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "ii" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_ii(LEJITFunc_C *func, int n, int arg0[], int arg1[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(int,int)>>*>(func)->callMostRecentBatch(n, arg0, arg1);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "ii>i" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_ii_i(LEJITFunc_C *func, int n, int arg0[], int arg1[], int arg2[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(int,int,int*)>>*>(func)->callMostRecentBatch(n, arg0, arg1, arg2);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "d" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_d(LEJITFunc_C *func, int n, double arg0[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double)>>*>(func)->callMostRecentBatch(n, arg0);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature ">d" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch__d(LEJITFunc_C *func, int n, double arg0[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double*)>>*>(func)->callMostRecentBatch(n, arg0);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "dd" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_dd(LEJITFunc_C *func, int n, double arg0[], double arg1[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double, double)>>*>(func)->callMostRecentBatch(n, arg0, arg1);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "dd>d" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_dd_d(LEJITFunc_C *func, int n, double arg0[], double arg1[], double arg2[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double, double, double*)>>*>(func)->callMostRecentBatch(n, arg0, arg1, arg2);
+	}
+
+	/*
+	 * C wrapper used to call most recently read batched form of function parameter with
+	 *	signature "ddd>d" on n elements through a handle
+	 */
+	void LEJITFunc_CallBatch_ddd_d(LEJITFunc_C *func, int n, double arg0[], double arg1[], double arg2[], double arg3[])
+	{
+		reinterpret_cast<TypedParam<std::function<void(double, double, double, double*)>>*>(func)->callMostRecentBatch(n, arg0, arg1, arg2, arg3);
+	}
+
+	/*
+	 * C wrapper of enableThreads
+	 */
+	void LEJITReader_EnableThreads(LEJITReader_C *reader)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->enableThreads();
+	}
+
+	/*
+	 * C wrapper of writeStatsFile
+	 */
+	int LEJITReader_WriteStatsFile(LEJITReader_C *reader, const char *filename)
+	{
+		return reinterpret_cast<LEJITReader*>(reader)->writeStatsFile(std::string(filename));
+	}
+
+	/*
+	 * C wrapper of writeStatsAtExit
+	 */
+	void LEJITReader_WriteStatsAtExit(LEJITReader_C *reader, const char *filename)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->writeStatsAtExit(std::string(filename));
+	}
+
+	/*
+	 * C wrapper of setStatsTiming
+	 */
+	void LEJITReader_SetStatsTiming(LEJITReader_C *reader, int timing)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->setStatsTiming(timing != 0);
+	}
+
+	/*
+	 * C wrapper of setBytecodeCache. Pass an empty string to disable the cache
+	 */
+	void LEJITReader_SetBytecodeCache(LEJITReader_C *reader, const char *cache_dir)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->setBytecodeCache(std::string(cache_dir));
+	}
+
+	/*
+	 * C wrapper of reloadIfChanged
+	 */
+	int LEJITReader_ReloadIfChanged(LEJITReader_C *reader)
+	{
+		return reinterpret_cast<LEJITReader*>(reader)->reloadIfChanged();
+	}
+
+	/*
+	 * C wrapper of onChange. callback is called with data
+	 */
+	void LEJITReader_OnChange(LEJITReader_C *reader, const char *id, void (*callback)(void *), void *data)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->onChange(std::string(id), [callback, data]() { callback(data); });
+	}
+
+	/*
+	 * C wrapper of bindParam for ints
+	 */
+	void LEJITReader_BindInt(LEJITReader_C *reader, const char *id, int *ptr)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->bindParam(std::string(id), *ptr);
+	}
+
+	/*
+	 * C wrapper of bindParam for doubles
+	 */
+	void LEJITReader_BindDouble(LEJITReader_C *reader, const char *id, double *ptr)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->bindParam(std::string(id), *ptr);
+	}
+
+	/*
+	 * C wrapper of bindParam for 1D int arrays
+	 */
+	void LEJITReader_BindArray_Int1D(LEJITReader_C *reader, const char *id, int *ptr, int length)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->bindParam(std::string(id), ptr, (size_t) length);
+	}
+
+	/*
+	 * C wrapper of bindParam for 1D double arrays
+	 */
+	void LEJITReader_BindArray_Double1D(LEJITReader_C *reader, const char *id, double *ptr, int length)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->bindParam(std::string(id), ptr, (size_t) length);
+	}
+
+	/*
+	 * C wrapper of refreshAll
+	 */
+	void LEJITReader_RefreshAll(LEJITReader_C *reader)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->refreshAll();
+	}
+
+	/*
+	 * C wrapper of setPure. entries of 0 or less uses the default
+	 */
+	void LEJITReader_SetPure(LEJITReader_C *reader, const char *id, int entries)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->setPure(id, entries > 0 ? entries : DEFAULT_MEMO_ENTRIES);
+	}
+
+	/*
+	 * C wrappers of tabulateParam
+	 */
+	void LEJITReader_Tabulate1D(LEJITReader_C *reader, const char *id, double x0, double x1, int nx, double tolerance)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->tabulateParam(id, x0, x1, nx, tolerance);
+	}
+
+	void LEJITReader_Tabulate2D(LEJITReader_C *reader, const char *id, double x0, double x1, int nx, double y0, double y1, int ny, double tolerance)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->tabulateParam(id, x0, x1, nx, y0, y1, ny, tolerance);
+	}
+
+	/*
+	 * C wrappers of setNative and setNativeCompiler
+	 */
+	void LEJITReader_SetNative(LEJITReader_C *reader, const char *id, int native)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->setNative(id, native != 0);
+	}
+
+	void LEJITReader_SetNativeCompiler(LEJITReader_C *reader, const char *command)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->setNativeCompiler(command);
+	}
+
+	/*
+	 * C wrapper of enableSharedConfig. A null prefix uses the default
+	 */
+	void LEJITReader_EnableSharedConfig(LEJITReader_C *reader, const char *prefix, double timeout)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->enableSharedConfig(prefix ? prefix : DEFAULT_SHARED_PREFIX, timeout);
+	}
+
+	/*
+	 * C wrapper of removeSharedConfig
+	 */
+	void LEJITReader_RemoveSharedConfig(LEJITReader_C *reader)
+	{
+		reinterpret_cast<LEJITReader*>(reader)->removeSharedConfig();
+	}
+
+	/*
+	 * C wrapper of writeConfigFile
+	 */
+	int LEJITReader_WriteConfigFile(LEJITReader_C *reader)
+	{
+		return reinterpret_cast<LEJITReader*>(reader)->writeConfigFile();
+	}
+
+	/*
+	 * C wrapper of writeFrozenHeader
+	 */
+	int LEJITReader_WriteFrozenHeader(LEJITReader_C *reader, const char *filename)
+	{
+		return reinterpret_cast<LEJITReader*>(reader)->writeFrozenHeader(std::string(filename));
+	}
+}
+
+/* C++ implementations */
+
+/*
+ * statsAtExit: readers whose call statistics are written when the program
+ *		exits, with the files to write them to
+ */
+static std::map<LEJITReader*, std::string> & statsAtExit()
+{
+	static std::map<LEJITReader*, std::string> readers;
+	return readers;
+}
+static void writeStatsAtExitHandler()
+{
+	for (auto ent : statsAtExit()) {
+		(ent.first)->writeStatsFile(ent.second);
+	}
+}
+
+/*
+ * filename LEJITReader constructor
+ */
+LEJITReader::LEJITReader(std::string filename, bool torch_enabled, bool gnuplot_enabled)
+{
+	// Use given filename
+	this->filename = filename;
+	
+	// Create new Lua state and open standard libraries
+	this->owner = lua_newshared();
+	this->L = this->owner.get();
+	luaL_openlibs(this->L);
+	lua_openarray(this->L);
+
+	// Sidecar files are found next to the config file
+	size_t slash = filename.find_last_of('/');
+	this->dir = (slash == std::string::npos) ? "" : filename.substr(0, slash + 1);
+	lua_openlejit(this->L, this->dir);
+
+	// Set library enable flags
+	this->torch_enabled = torch_enabled;
+	this->gnuplot_enabled = gnuplot_enabled;
+
+	// Config file is evaluated lazily by the first readParam
+	this->loaded = false;
+
+	// Parallel kernels use every hardware thread by default
+	this->num_threads = parallel_default_threads();
+	this->grain = DEFAULT_GRAIN;
+
+	// Cache bytecode next to the config file
+	this->cache_dir = this->dir + DEFAULT_CACHE_DIR;
+	this->cache_hits = 0;
+	this->cache_misses = 0;
+	this->native = std::make_shared<NativeCompiler>(DEFAULT_NATIVE_COMPILER, this->cache_dir);
+
+	this->sidecar_threshold = DEFAULT_SIDECAR_THRESHOLD;
+
+	// Config file hasn't been checked for changes yet
+	this->config_mtime = 0;
+	this->config_size = 0;
+	this->config_ino = 0;
+	this->config_hash = 0;
+	this->config_hashed = 0;
+
+	// Config files aren't shared between processes unless enabled
+	this->shared_timeout = DEFAULT_SHARED_TIMEOUT;
+	this->shared_loaded = false;
+
+	// Calls are only counted unless timing is enabled
+	this->stats_timing = false;
+}
+
+/*
+ * LEJITReader destructor: deletes all registered parameters, releasing their
+ *		references into the Lua state, then gives up its ownership of the
+ *		state. The state is closed here unless a function read from it is
+ *		still held by the application, in which case the last of those
+ *		closes it
+ */
+LEJITReader::~LEJITReader()
+{
+	statsAtExit().erase(this);
+
+	for (auto ent : this->paramlist) {
+		delete ent.second;
+	}
+	this->paramlist.clear();
+
+	this->owner.reset();
+}
+
+/*
+ * evaluateConfig: loads the config file, through the bytecode cache if
+ *		enabled, and runs it in the reader's state. Returns the bytecode if
+ *		dump is set or per thread states need it, otherwise it may be empty
+ */
+std::string LEJITReader::evaluateConfig(bool dump)
+{
+	std::string bytecode;
+	int status;
+	if (this->cache_dir.empty()) {
+		status = luaL_loadfile(this->L, this->filename.c_str());
+		if (!status && (dump || this->pool)) {
+			bytecode = lua_dumptop(this->L);
+		}
+	}
+	else {
+		bool hit;
+		status = lua_loadfilecached(this->L, this->filename, this->cache_dir, hit, bytecode);
+		if (!status) {
+			hit ? this->cache_hits++ : this->cache_misses++;
+		}
+	}
+
+	if (status) {
+		lua_error(this->L, "error in config file: %s\n", lua_tostring(this->L, -1));
+	}
+
+	// Per thread states run the same bytecode
+	if (this->pool) {
+		this->pool->setBytecode("@" + this->filename, bytecode);
+	}
+
+	if (lua_pcall(this->L, 0, 0, 0)) {
+		lua_error(this->L, "error in config file: %s\n", lua_tostring(this->L, -1));
+	}
+
+	return bytecode;
+}
+
+/*
+ * reload: evaluates the config file and snapshots the values of all
+ *		registered parameters. readParam is served from this snapshot until
+ *		the next call to reload
+ */
+void LEJITReader::reload()
+{
+	// Record the state of the file before loading it, so changes made while
+	// it is loaded are picked up by the next reloadIfChanged
+	this->configChanged();
+
+	// Snapshot each registered parameter, keeping track of which changed
+	this->changed.clear();
+	this->shared_loaded = false;
+	if (this->shared_prefix.empty() || !this->reloadShared()) {
+		this->evaluateConfig(false);
+		for (auto ent : this->paramlist) {
+			if ((ent.second)->snapshot(this->L)) {
+				this->changed.push_back(ent.first);
+			}
+		}
+	}
+
+	bool first_load = !this->loaded;
+	this->loaded = true;
+
+	// Fire change callbacks once every parameter is up to date. The first
+	// load fires all of them, so derived data is built from defaults too
+	if (first_load) {
+		for (auto ent : this->paramlist) {
+			(ent.second)->fireOnChange();
+		}
+	}
+	else {
+		for (auto &id : this->changed) {
+			this->paramlist[id]->fireOnChange();
+		}
+	}
+}
+
+/*
+ * onChange: adds a callback to a registered parameter, fired after each
+ *		reload which changes it. If the config file has already been
+ *		evaluated, the callback is also fired right away
+ */
+void LEJITReader::onChange(std::string id, std::function<void()> on_change)
+{
+	auto it = this->paramlist.find(id);
+	if (it == this->paramlist.end()) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling onChange\n"));
+	}
+
+	it->second->addOnChange(on_change);
+	if (this->loaded) {
+		on_change();
+	}
+}
+
+/*
+ * setPure: declares a registered function parameter pure, putting a cache of
+ *		entries results in front of its Lua calls. Throws an error if it is
+ *		not a function of scalar arguments
+ */
+void LEJITReader::setPure(std::string id, size_t entries)
+{
+	auto it = this->paramlist.find(id);
+	if (it == this->paramlist.end()) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling setPure\n"));
+	}
+
+	it->second->setPure(entries);
+}
+
+/*
+ * tabulateParam: serves calls to a registered function parameter from a table
+ *		sampled over the domain in spec
+ */
+void LEJITReader::tabulateParam(std::string id, const LuaTableSpec &spec)
+{
+	auto it = this->paramlist.find(id);
+	if (it == this->paramlist.end()) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling tabulateParam\n"));
+	}
+
+	it->second->setTabulated(spec);
+}
+
+/*
+ * tabulateParam: serves calls to a registered d>d function parameter from a
+ *		table of nx samples over [x0, x1]. Throws an error if it is not a d>d
+ *		function
+ */
+void LEJITReader::tabulateParam(std::string id, double x0, double x1, size_t nx, double tolerance)
+{
+	LuaTableSpec spec = { 1, { x0, 0 }, { x1, 0 }, { nx, 1 }, tolerance };
+	this->tabulateParam(id, spec);
+}
+
+/*
+ * tabulateParam: version for dd>d function parameters, sampled on an nx by ny
+ *		grid over [x0, x1] by [y0, y1]
+ */
+void LEJITReader::tabulateParam(std::string id, double x0, double x1, size_t nx, double y0, double y1, size_t ny, double tolerance)
+{
+	LuaTableSpec spec = { 2, { x0, y0 }, { x1, y1 }, { nx, ny }, tolerance };
+	this->tabulateParam(id, spec);
+}
+
+/*
+ * setNative: compiles a registered function parameter to C each time it is
+ *		bound, or goes back to calling Lua. Throws an error if it is not a
+ *		function
+ */
+void LEJITReader::setNative(std::string id, bool native)
+{
+	auto it = this->paramlist.find(id);
+	if (it == this->paramlist.end()) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling setNative\n"));
+	}
+
+	it->second->setNative(native ? this->native : nullptr);
+}
+
+/*
+ * setNativeCompiler: sets the command native function parameters are
+ *		compiled with, followed by -o and the names of the library and the C
+ *		file. Applies from the next time they are bound
+ */
+void LEJITReader::setNativeCompiler(std::string command)
+{
+	this->native->setCommand(command);
+}
+
+/*
+ * refreshAll: evaluates the config file once and writes each bound
+ *		parameter into its variable. Bound parameters missing from the config
+ *		file keep the value their variable holds, and ones of the wrong type
+ *		are reported like in readParam
+ */
+void LEJITReader::refreshAll()
+{
+	this->reload();
+
+	for (auto &ent : this->bindings) {
+		Param *p = this->paramlist[ent.first];
+		if (p->hasValue()) {
+			ent.second();
+		}
+		else if (!p->getError().empty()) {
+			this->checkSnapshot(p);
+		}
+	}
+}
+
+/*
+ * reloadIfChanged: reloads the config file if it has not been evaluated yet
+ *		or changed since. Returns true if it was reloaded
+ */
+bool LEJITReader::reloadIfChanged()
+{
+	if (this->loaded && !this->configChanged()) {
+		return false;
+	}
+
+	this->reload();
+	return true;
+}
+
+/*
+ * configChanged: returns true if the config file changed since the last
+ *		call. Only stats the file unless its modification time, size or inode
+ *		changed, in which case its contents are hashed to make sure. A file
+ *		modified in the same second its contents were last hashed is always
+ *		hashed again, since a file system keeping whole seconds wouldn't show
+ *		a second write within that second. A missing file counts as
+ *		unchanged, so the last snapshot is kept
+ */
+bool LEJITReader::configChanged()
+{
+	struct stat st;
+	if (stat(this->filename.c_str(), &st) != 0) {
+		return false;
+	}
+
+	uint64_t mtime = lua_mtime(st);
+	bool racy = st.st_mtime >= this->config_hashed;
+	if (!racy && mtime == this->config_mtime && st.st_size == this->config_size && st.st_ino == this->config_ino) {
+		return false;
+	}
+	this->config_mtime = mtime;
+	this->config_size = st.st_size;
+	this->config_ino = st.st_ino;
+	this->config_hashed = time(nullptr);
+
+	std::ifstream file(this->filename, std::ios::binary);
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	uint64_t hash = lua_hashstring(contents);
+
+	if (hash == this->config_hash) {
+		return false;
+	}
+	this->config_hash = hash;
+	return true;
+}
+
+/*
+ * setBytecodeCache: sets the directory config file bytecode is cached in,
+ *		created on the first cache miss. An empty string disables the cache
+ */
+void LEJITReader::setBytecodeCache(std::string cache_dir)
+{
+	this->cache_dir = cache_dir;
+	this->native->setDirectory(cache_dir);
+}
+
+/*
+ * enableSharedConfig: shares evaluated config files between the processes on
+ *		the node. Takes effect on the next load
+ */
+void LEJITReader::enableSharedConfig(std::string prefix, double timeout)
+{
+	if (prefix.empty() || prefix[0] != '/') {
+		prefix = "/" + prefix;
+	}
+	this->shared_prefix = prefix;
+	this->shared_timeout = timeout;
+}
+
+/*
+ * removeSharedConfig: removes the shared memory objects the current config
+ *		file was published in, if any
+ */
+void LEJITReader::removeSharedConfig()
+{
+	if (!this->shared_name.empty()) {
+		LuaSharedConfig::remove(this->shared_name);
+	}
+}
+
+/*
+ * reloadShared: loads the snapshot from the shared memory objects named after
+ *		the config file's path and contents. The first process to get there
+ *		evaluates the config file and publishes the packed value of each
+ *		parameter, or that it needs a Lua state, with the bytecode, and
+ *		removes the objects of the contents it loaded before. Others
+ *		unpack every parameter they can, and run the bytecode only for
+ *		function parameters. Returns false if the caller has to evaluate the
+ *		config file itself
+ */
+bool LEJITReader::reloadShared()
+{
+	if (!this->config_hash) {
+		return false;
+	}
+
+	// Name the objects after the config file's absolute path and contents,
+	// and the name it was given, which the bytecode records as its chunkname
+	char *path = realpath(this->filename.c_str(), nullptr);
+	uint64_t hash = lua_hashstring(path ? std::string(path) : this->filename, this->config_hash);
+	hash = lua_hashstring("@" + this->filename, hash);
+	free(path);
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+	std::string previous = this->shared_name;
+	this->shared_name = this->shared_prefix + hex;
+
+	LuaSharedConfig shared(this->shared_name);
+
+	// Publish one entry per parameter: its identifier, type, whether it has a
+	// value (1), has none (0) or needs a Lua state (2), and its packed value
+	if (shared.isOwner()) {
+		// The config file changed since the last load, so nobody needs the
+		// previous generation any more
+		if (!previous.empty() && previous != this->shared_name) {
+			LuaSharedConfig::remove(previous);
+		}
+
+		std::string bytecode = this->evaluateConfig(true);
+		std::string values;
+		for (auto ent : this->paramlist) {
+			if ((ent.second)->snapshot(this->L)) {
+				this->changed.push_back(ent.first);
+			}
+
+			std::string packed;
+			uint8_t kind = (ent.second)->pack(packed) ? (ent.second)->hasValue() : 2;
+			lua_packvalue(values, ent.first);
+			lua_packvalue(values, std::string((ent.second)->getType().name()));
+			lua_packvalue(values, kind);
+			lua_packvalue(values, packed);
+		}
+
+		if (!shared.publish(bytecode, values)) {
+			printf("Unable to publish config file to shared memory %s\n", this->shared_name.c_str());
+		}
+		return true;
+	}
+
+	if (!shared.attach(this->shared_timeout)) {
+		return false;
+	}
+
+	// Index the published entries, and check that every parameter of this
+	// process is among them with the same type
+	struct Entry { std::string type; uint8_t kind; const char *data; size_t size; };
+	std::map<std::string, Entry> entries;
+	const char *data = shared.getValues();
+	const char *end = data + shared.getValuesSize();
+	while (data < end) {
+		std::string id;
+		Entry entry;
+		uint64_t size;
+		if (!lua_unpackvalue(data, end, id) || !lua_unpackvalue(data, end, entry.type) || !lua_unpackvalue(data, end, entry.kind)
+			|| !lua_unpackvalue(data, end, size) || size > (uint64_t) (end - data)) {
+			return false;
+		}
+		entry.data = data;
+		entry.size = size;
+		data += size;
+		entries[id] = entry;
+	}
+
+	for (auto ent : this->paramlist) {
+		auto it = entries.find(ent.first);
+		if (it == entries.end() || it->second.type != (ent.second)->getType().name()) {
+			return false;
+		}
+	}
+
+	// Unpack the values, leaving parameters which need a Lua state for later
+	std::vector<std::string> lua_params;
+	for (auto ent : this->paramlist) {
+		Entry &entry = entries[ent.first];
+		bool changed = false;
+		if (entry.kind == 2) {
+			lua_params.push_back(ent.first);
+			continue;
+		}
+		else if (entry.kind == 0) {
+			changed = (ent.second)->clearValue();
+		}
+		else if (!(ent.second)->unpack(entry.data, entry.size, changed)) {
+			return false;
+		}
+
+		if (changed) {
+			this->changed.push_back(ent.first);
+		}
+	}
+
+	// Run the published bytecode for function parameters
+	if (!lua_params.empty()) {
+		std::string chunkname = "@" + this->filename;
+		if (luaL_loadbuffer(this->L, shared.getBytecode(), shared.getBytecodeSize(), chunkname.c_str())) {
+			lua_error(this->L, "error in shared config file: %s\n", lua_tostring(this->L, -1));
+		}
+		if (this->pool) {
+			this->pool->setBytecode(chunkname, std::string(shared.getBytecode(), shared.getBytecodeSize()));
+		}
+		if (lua_pcall(this->L, 0, 0, 0)) {
+			lua_error(this->L, "error in config file: %s\n", lua_tostring(this->L, -1));
+		}
+
+		for (auto &id : lua_params) {
+			if (this->paramlist[id]->snapshot(this->L)) {
+				this->changed.push_back(id);
+			}
+		}
+	}
+
+	this->shared_loaded = true;
+	return true;
+}
+
+/*
+ * enableThreads: makes function parameters callable from several threads at
+ *		once. Each calling thread gets its own Lua state, created lazily and
+ *		reused once the thread exits. A loaded config is reloaded to rebind
+ *		its functions to the pool, so handles from getMostRecentFunc,
+ *		getMostRecentBatchFunc and getFuncParam switch over at once. Copies
+ *		returned by readParam and readBatchParam before the call still use
+ *		the reader's own state; read them again to get thread safe versions
+ */
+void LEJITReader::enableThreads()
+{
+	if (this->pool) {
+		return;
+	}
+
+	this->pool = std::make_shared<LuaStatePool>();
+	for (auto ent : this->paramlist) {
+		(ent.second)->setStatePool(this->pool);
+	}
+
+	// Rebind function parameters to the pool
+	if (this->loaded) {
+		this->reload();
+	}
+}
+
+/*
+ * setParallelism: sets the number of threads and the maximum number of
+ *		elements per chunk used by parallelMap and parallelReduce
+ */
+void LEJITReader::setParallelism(int num_threads, int grain)
+{
+	this->num_threads = (num_threads > 0) ? num_threads : parallel_default_threads();
+	this->grain = grain;
+}
+
+/*
+ * isLuaIdentifier: returns true if id is a valid Lua identifier and throws an
+ *		error if not
+ */
+bool LEJITReader::isLuaIdentifier(std::string id)
+{
+	std::regex rgx("[A-Za-z_][0-9A-Za-z_]*");
+	if (std::regex_match(id, rgx)) {
+
+		// Check if it is a reserved word
+		std::regex reserved_words(LUA_RESERVED_WORDS);
+		if (!std::regex_match(id, reserved_words)) {
+			return true;
+		}
+	}
+
+	throw std::invalid_argument(std::string("Parameter name '") + std::string(id.c_str())
+		+ std::string("' is not a valid Lua identifier."));
+}
+
+/*
+ * this->isRegistered: returns the registered Param if a parameter has been registered with type type.
+ * 		otherwise returns null. If the parameter has been registered with a
+ *		different type, throws an error.
+ */
+Param * LEJITReader::isRegistered(std::string id, std::type_index type)
+{
+	Param *p = nullptr;
+	try {
+		p = this->paramlist.at(id);
+	}
+	catch (std::out_of_range& e) {
+		return p;
+	}
+
+	if (p->getType() == type) {
+		return p;
+	}
+	else {
+		throw std::invalid_argument(std::string("Parameter name '") + std::string(id.c_str())
+			+ std::string("' is already registerd with a different type. Choose another identifier."));
+	}
+}
+
+/*
+ * this->checkRegistered: same as this->isRegistered but throws an error if the parameter is not found
+ */
+Param * LEJITReader::checkRegistered(std::string id, std::type_index type)
+{
+	Param *p = this->isRegistered(id, type);
+	if (p) {
+		return p;
+	}
+	else {
+		// If param not found
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling readParam\n"));
+	}
+}
+
+/*
+ * addParam: adds a newly registered parameter to the parameter list. If the
+ *		config file has already been evaluated, the parameter is added to the
+ *		existing snapshot
+ */
+void LEJITReader::addParam(Param *p)
+{
+	this->paramlist[p->getId()] = p;
+
+	if (this->pool) {
+		p->setStatePool(this->pool);
+	}
+
+	std::shared_ptr<LuaStats> stats = p->getStats();
+	if (stats) {
+		stats->setTiming(this->stats_timing);
+	}
+
+	if (this->loaded) {
+		p->snapshot(this->L);
+	}
+}
+
+/*
+ * checkSnapshot: same as checkRegistered, but also evaluates the config file
+ *		if there is no snapshot yet and throws an error if the parameter is
+ *		missing from it, or was left out of it for having the wrong type
+ */
+Param * LEJITReader::checkSnapshot(std::string id, std::type_index type)
+{
+	return this->checkSnapshot(this->checkRegistered(id, type));
+}
+Param * LEJITReader::checkSnapshot(Param *p)
+{
+	if (!this->loaded) {
+		this->reload();
+	}
+
+	if (!p->hasValue() && !p->getError().empty()) {
+		lua_error(this->L, "parameter '%s' in config file %s\n", p->getId().c_str(), p->getError().c_str());
+	}
+	else if (!p->hasValue()) {
+		lua_error(this->L, "parameter '%s' is missing from config file\n", p->getId().c_str());
+	}
+
+	return p;
+}
+
+/*
+ * checkBatchRegistered: returns the registered function parameter whose
+ *		batched form has argument types bargs. Throws an error if there is no
+ *		such parameter
+ */
+template <typename ...bargs> BatchParam<bargs...> * LEJITReader::checkBatchRegistered(std::string id)
+{
+	auto ent = this->paramlist.find(id);
+	if (ent == this->paramlist.end()) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling readBatchParam\n"));
+	}
+
+	BatchParam<bargs...> *p = dynamic_cast<BatchParam<bargs...>*>(ent->second);
+	if (!p) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not a function parameter with a batched form of this type\n"));
+	}
+
+	return p;
+}
+
+/*
+ * checkLength: throws an error if an array parameter in the config file is
+ *		shorter than the array it is being read into
+ */
+void LEJITReader::checkLength(std::string id, size_t length, size_t expected)
+{
+	if (length < expected) {
+		lua_error(this->L, "parameter '%s' in config file has length %zu, expected %zu\n", id.c_str(), length, expected);
+	}
+}
+
+/*
+ * convert1DArray: helper function to convert 1D c-style array types to std::vectors
+ * 		arr: array to convert
+ */
+template<typename T, size_t size> std::vector<T> LEJITReader::convert1DArray(T (&arr)[size])
+{
+	// Create and populate new std::vector
+	std::vector<T> v(arr, arr + size);
+	return v;
+}
+
+/*
+ * convert2DArray: helper function to convert 2D c-style array types to std::vectors
+ * 		arr: array to convert
+ */
+template<typename T, size_t rows, size_t cols> std::vector<std::vector<T>> LEJITReader::convert2DArray(T (&arr)[rows][cols])
+{
+	// Create and populate new std::vector
+	std::vector<std::vector<T>> v;
+	for (int i = 0; i < rows; i++) {
+		std::vector<T> vi = convert1DArray(*(arr + i));
+		v.push_back(vi);
+	}
+	return v;
+}
+
+/*
+ * convert3DArray: helper function to convert 3D c-style array types to std::vectors
+ * 		arr: array to convert
+ */
+template<typename T, size_t rows, size_t cols, size_t depth> std::vector<std::vector<std::vector<T>>> LEJITReader::convert3DArray(T (&arr)[rows][cols][depth])
+{
+	// Create and populate new std::vector
+	std::vector<std::vector<std::vector<T>>> v;
+	for (int i = 0; i < rows; i++) {
+		std::vector<std::vector<T>> vi = convert2DArray(*(arr + i));
+		v.push_back(vi);
+	}
+	return v;
+}
+
+/*
+ * registerParam: template version to handle all non-array, non-function
+ *		supported types
+ *		Throws an error if the parameter name is an invalid Lua identifier
+ *		or if it has already been registered as a different type. If it has
+ *		already been registered as the same type, does nothing.
+ *
+ *		id: name to give parameter in Lua config file
+ *		def_val: default value to assign the parameter in the Lua config file
+ *			if the parameter is a function, it is not assigned def_val in the
+ *			Lua config file, but appears as an empty function declaration
+ *			(may be changed in the future)
+ */
+template<typename T> void LEJITReader::registerParam(std::string id, T def_val)
+{
+	if (isLuaIdentifier(id)) {
+		if (this->isRegistered(id, type(T))) {
+			return;
+		}
+		else {
+			// If no match is found, create a new Param 
+			this->addParam(new TypedParam<T>(id, def_val));
+		}
+	}
+}
+
+/*
+ * registerParam: template version with optional docstring
+ *		doc: string which appears as a doc comment accompanying the parameter
+ *			in the Lua config file
+ */
+template<typename T> void LEJITReader::registerParam(std::string id, T def_val, std::string doc)
+{
+	if (isLuaIdentifier(id)) {
+		if (this->isRegistered(id, type(T))) {
+			return;
+		}
+		else {
+			// If no match is found, create a new Param 
+			this->addParam(new TypedParam<T>(id, def_val, doc));
+		}
+	}
+}
+
+/*
+ * registerParam: version with change callback
+ */
+template<typename T> void LEJITReader::registerParam(std::string id, T def_val, std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
+/*
+ * registerParam: C++ std::function version
+ */
+template<typename ...args> void LEJITReader::registerParam(std::string id, std::function<void(args...)> def_val)
+{
+	if (isLuaIdentifier(id)) {
+		if (this->isRegistered(id, type(std::function<void(args...)>))) {
+			return;
+		}
+		else {
+			// If no match is found, create a new Param 
+			this->addParam(new TypedParam<std::function<void(args...)>>(this->owner, id, def_val));
+		}
+	}
+}
+
+/*
+ * registerParam: C++ std::function version with optional docstring
+ */
+template<typename ...args> void LEJITReader::registerParam(std::string id, std::function<void(args...)> def_val, std::string doc)
+{
+	if (isLuaIdentifier(id)) {
+		if (this->isRegistered(id, type(std::function<void(args...)>))) {
+			return;
+		}
+		else {
+			// If no match is found, create a new Param 
+			this->addParam(new TypedParam<std::function<void(args...)>>(this->owner, id, def_val, doc));	
+		}
+	}
+}
+
+/*
+ * registerParam: C++ std::function version with optional signature string
+ */
+template<typename ...args> void LEJITReader::registerParam(std::string id, std::string signature, std::function<void(args...)> def_val)
+{
+	if (isLuaIdentifier(id)) {
 		if (this->isRegistered(id, type(std::function<void(args...)>))) {
 			return;
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::function<void(args...)>>(this->L, id, signature, def_val));
+			this->addParam(new TypedParam<std::function<void(args...)>>(this->owner, id, signature, def_val));
 		}
 	}
 }
@@ -702,11 +1877,22 @@ template<typename ...args> void LEJITReader::registerParam(std::string id, std::
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::function<void(args...)>>(this->L, id, signature, def_val, doc));	
+			this->addParam(new TypedParam<std::function<void(args...)>>(this->owner, id, signature, def_val, doc));	
 		}
 	}
 }
 
+/*
+ * registerParam: C++ std::function version with change callback
+ */
+template<typename ...args> void LEJITReader::registerParam(std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, signature, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
 
 /*
  * registerParam: version for 1D C-style arrays
@@ -721,7 +1907,7 @@ template<typename T, size_t size> void LEJITReader::registerParam(std::string id
 		else {
 			// If no match is found, create a new Param 
 			std::vector<T> v = convert1DArray(def_val);
-			this->paramlist[id] = (new TypedParam<std::vector<T>>(id, v));
+			this->addParam(new TypedParam<std::vector<T>>(id, v));
 		}
 	}
 }
@@ -737,12 +1923,23 @@ template<typename T, size_t size> void LEJITReader::registerParam(std::string id
 		}
 		else {
 			// If no match is found, create a new Param 
-			std::vector<T> v = convert1DArray(def_val, size);
-			this->paramlist[id] = (new TypedParam<std::vector<T>>(id, v, doc));
+			std::vector<T> v = convert1DArray(def_val);
+			this->addParam(new TypedParam<std::vector<T>>(id, v, doc));
 		}
 	}
 }
 
+/*
+ * registerParam: 1D C-style array version with change callback
+ */
+template<typename T, size_t size> void LEJITReader::registerParam(std::string id, T (&def_val)[size], std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
 /*
  * registerParam: version for 2D C-style arrays
  *		rows, cols: dimensions of the array
@@ -756,7 +1953,7 @@ template<typename T, size_t rows, size_t cols> void LEJITReader::registerParam(s
 		else {
 			// If no match is found, create a new Param 
 			std::vector<std::vector<T>> v = convert2DArray(def_val);
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<T>>>(id, v));
+			this->addParam(new TypedParam<std::vector<std::vector<T>>>(id, v));
 		}
 	}
 }
@@ -773,11 +1970,22 @@ template<typename T, size_t rows, size_t cols> void LEJITReader::registerParam(s
 		else {
 			// If no match is found, create a new Param 
 			std::vector<std::vector<T>> v = convert2DArray(def_val);
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<T>>>(id, v, doc));
+			this->addParam(new TypedParam<std::vector<std::vector<T>>>(id, v, doc));
 		}
 	}
 }
 
+/*
+ * registerParam: 2D C-style array version with change callback
+ */
+template<typename T, size_t rows, size_t cols> void LEJITReader::registerParam(std::string id, T (&def_val)[rows][cols], std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
  /*
  * registerParam: version for 3D C-style arrays
  *		rows, cols, depth: dimensions of the array
@@ -791,7 +1999,7 @@ template<typename T, size_t rows, size_t cols, size_t depth> void LEJITReader::r
 		else {
 			// If no match is found, create a new Param 
 			std::vector<std::vector<std::vector<T>>> v = convert3DArray(def_val);
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, v));
+			this->addParam(new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, v));
 		}
 	}
 }
@@ -808,11 +2016,22 @@ template<typename T, size_t rows, size_t cols, size_t depth> void LEJITReader::r
 		else {
 			// If no match is found, create a new Param 
 			std::vector<std::vector<std::vector<T>>> v = convert3DArray(def_val);
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, v, doc));
+			this->addParam(new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, v, doc));
 		}
 	}
 }
 
+/*
+ * registerParam: 3D C-style array version with change callback
+ */
+template<typename T, size_t rows, size_t cols, size_t depth> void LEJITReader::registerParam(std::string id, T (&def_val)[rows][cols][depth], std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
 /*
  * registerParam: 1D C++ vector version
  */
@@ -824,7 +2043,7 @@ template<typename T> void LEJITReader::registerParam(std::string id, std::vector
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::vector<T>>(id, def_val));
+			this->addParam(new TypedParam<std::vector<T>>(id, def_val));
 		}
 	}
 }
@@ -840,11 +2059,22 @@ template<typename T> void LEJITReader::registerParam(std::string id, std::vector
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::vector<T>>(id, def_val, doc));
+			this->addParam(new TypedParam<std::vector<T>>(id, def_val, doc));
 		}
 	}
 }
 
+/*
+ * registerParam: 1D C++ vector version with change callback
+ */
+template<typename T> void LEJITReader::registerParam(std::string id, std::vector<T> def_val, std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
 /*
  * registerParam: 2D C++ vector version
  */
@@ -856,7 +2086,7 @@ template<typename T> void LEJITReader::registerParam(std::string id, std::vector
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<T>>>(id, def_val));
+			this->addParam(new TypedParam<std::vector<std::vector<T>>>(id, def_val));
 		}
 	}
 }
@@ -872,11 +2102,22 @@ template<typename T> void LEJITReader::registerParam(std::string id, std::vector
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<T>>>(id, def_val, doc));
+			this->addParam(new TypedParam<std::vector<std::vector<T>>>(id, def_val, doc));
 		}
 	}
 }
 
+/*
+ * registerParam: 2D C++ vector version with change callback
+ */
+template<typename T> void LEJITReader::registerParam(std::string id, std::vector<std::vector<T>> def_val, std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
 /*
  * registerParam: 3D C++ vector version
  */
@@ -888,7 +2129,7 @@ template<typename T> void LEJITReader::registerParam(std::string id, std::vector
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, def_val));
+			this->addParam(new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, def_val));
 		}
 	}
 }
@@ -904,32 +2145,95 @@ template<typename T> void LEJITReader::registerParam(std::string id, std::vector
 		}
 		else {
 			// If no match is found, create a new Param 
-			this->paramlist[id] = (new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, def_val, doc));
+			this->addParam(new TypedParam<std::vector<std::vector<std::vector<T>>>>(id, def_val, doc));
 		}
 	}
 } 
 
 /*
- * readParam: reads the named parameter out of the config file. Throws an
- *		error if the config file is unrunable of if the supplied value is
- *		absent or the wrong type. Templated to handle all non-function,
- *		non-array allowed types
+ * registerParam: 3D C++ vector version with change callback
+ */
+template<typename T> void LEJITReader::registerParam(std::string id, std::vector<std::vector<std::vector<T>>> def_val, std::string doc, std::function<void()> on_change)
+{
+	this->registerParam(id, def_val, doc);
+	if (isLuaIdentifier(id)) {
+		this->onChange(id, on_change);
+	}
+}
+
+/*
+ * bindParam: registers a parameter whose default value is the current
+ *		contents of var, and binds var to it so refreshAll writes the value
+ *		in the config file into it. Works for every type readParam can read
+ *		into by reference
+ */
+template<typename T> void LEJITReader::bindParam(std::string id, T &var)
+{
+	this->bindParam(id, var, "");
+}
+
+/*
+ * bindParam: version with docstring
+ */
+template<typename T> void LEJITReader::bindParam(std::string id, T &var, std::string doc)
+{
+	if (isLuaIdentifier(id)) {
+		this->registerParam(id, var, doc);
+		this->bindings[id] = [this, id, &var]() {
+			this->readParam(id, var);
+		};
+	}
+}
+
+/*
+ * bindParam: C++ std::function version with signature string
+ */
+template<typename ...args> void LEJITReader::bindParam(std::string id, std::string signature, std::function<void(args...)> &var, std::string doc)
+{
+	if (isLuaIdentifier(id)) {
+		this->registerParam(id, signature, var, doc);
+		this->bindings[id] = [this, id, &var]() {
+			this->readParam(id, var);
+		};
+	}
+}
+
+/*
+ * bindParam: version for a 1D array behind a pointer
+ */
+template<typename T> void LEJITReader::bindParam(std::string id, T *ptr, size_t size)
+{
+	this->bindParam(id, ptr, size, "");
+}
+
+/*
+ * bindParam: version for a 1D array behind a pointer with docstring
+ */
+template<typename T> void LEJITReader::bindParam(std::string id, T *ptr, size_t size, std::string doc)
+{
+	if (isLuaIdentifier(id)) {
+		this->registerParam(id, std::vector<T>(ptr, ptr + size), doc);
+		this->bindings[id] = [this, id, ptr, size]() {
+			T *dest = ptr;
+			this->readParam(id, dest, size);
+		};
+	}
+}
+
+/*
+ * readParam: reads the named parameter out of the config file snapshot. The
+ *		config file is evaluated on the first call and then only again on
+ *		reload(). Throws an error if the config file is unrunable of if the
+ *		supplied value is absent or the wrong type. Templated to handle all
+ *		non-function, non-array allowed types
  *
  *		id: identifier of parameter to fetch
  *		ptr: place to store fetched parameter value
  */
 template<typename T> void LEJITReader::readParam(std::string id, T &ptr)
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(this->L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
-
-	if (this->checkRegistered(id, type(T))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
-	}
+	TypedParam<T> *p = (TypedParam<T>*) this->checkSnapshot(id, type(T));
+	ptr = p->getValue();
 }
 
 /*
@@ -937,13 +2241,8 @@ template<typename T> void LEJITReader::readParam(std::string id, T &ptr)
  */
 template<typename ...args> void LEJITReader::readParam(std::string id, std::function<void(args...)> &ptr)
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
-
-	Param *p = this->checkRegistered(id, type(std::function<void(args...)>));
-	ptr = ((TypedParam<std::function<void(args...)>>*)p)->getLuaFunc();
+	Param *p = this->checkSnapshot(id, type(std::function<void(args...)>));
+	ptr = ((TypedParam<std::function<void(args...)>>*)p)->getMostRecent();
 }
 
 /* 
@@ -951,16 +2250,11 @@ template<typename ...args> void LEJITReader::readParam(std::string id, std::func
  */
 template<typename T> void LEJITReader::readParam(std::string id, T *(&ptr), size_t size)
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
+	TypedParam<std::vector<T>> *p = (TypedParam<std::vector<T>>*) this->checkSnapshot(id, type(std::vector<T>));
+	const std::vector<T> &val = p->getValue();
 
-	if (this->checkRegistered(id, type(std::vector<T>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr, size);
-	}
+	this->checkLength(id, val.size(), size);
+	std::copy(val.begin(), val.begin() + size, ptr);
 }
 
 /*
@@ -968,16 +2262,11 @@ template<typename T> void LEJITReader::readParam(std::string id, T *(&ptr), size
  */ 
 template<typename T, size_t size> void LEJITReader::readParam(std::string id, T (&ptr)[size])
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
+	TypedParam<std::vector<T>> *p = (TypedParam<std::vector<T>>*) this->checkSnapshot(id, type(std::vector<T>));
+	const std::vector<T> &val = p->getValue();
 
-	if (this->checkRegistered(id, type(std::vector<T>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
-	}
+	this->checkLength(id, val.size(), size);
+	std::copy(val.begin(), val.begin() + size, ptr);
 }
 
 /*
@@ -985,32 +2274,23 @@ template<typename T, size_t size> void LEJITReader::readParam(std::string id, T
  */
 template<typename T> void LEJITReader::readParam(std::string id, std::vector<T> (&ptr))
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
-
-	if (this->checkRegistered(id, type(std::vector<T>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
-	}
+	TypedParam<std::vector<T>> *p = (TypedParam<std::vector<T>>*) this->checkSnapshot(id, type(std::vector<T>));
+	ptr = p->getValue();
 }
 
 /* 
- * readParam: 2D c-style array version, reading into a pointer
+ * readParam: 2D c-style array version, reading into an array of row pointers
+ *		rows: number of rows to read
  */
 template<typename T, size_t arrdim> void LEJITReader::readParam(std::string id, T *(&ptr)[arrdim], size_t rows)
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
+	TypedParam<std::vector<std::vector<T>>> *p = (TypedParam<std::vector<std::vector<T>>>*) this->checkSnapshot(id, type(std::vector<std::vector<T>>));
+	const std::vector<std::vector<T>> &val = p->getValue();
 
-	if (this->checkRegistered(id, type(std::vector<std::vector<T>>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr, rows);
+	this->checkLength(id, arrdim, rows);
+	this->checkLength(id, val.size(), rows);
+	for (size_t i = 0; i < rows; i++) {
+		std::copy(val[i].begin(), val[i].end(), ptr[i]);
 	}
 }
 
@@ -1019,15 +2299,13 @@ template<typename T, size_t arrdim> void LEJITReader::readParam(std::string id,
  */
 template<typename T, size_t rows, size_t cols> void LEJITReader::readParam(std::string id, T (&ptr)[rows][cols])
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
+	TypedParam<std::vector<std::vector<T>>> *p = (TypedParam<std::vector<std::vector<T>>>*) this->checkSnapshot(id, type(std::vector<std::vector<T>>));
+	const std::vector<std::vector<T>> &val = p->getValue();
 
-	if (this->checkRegistered(id, type(std::vector<std::vector<T>>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
+	this->checkLength(id, val.size(), rows);
+	for (size_t i = 0; i < rows; i++) {
+		this->checkLength(id, val[i].size(), cols);
+		std::copy(val[i].begin(), val[i].begin() + cols, ptr[i]);
 	}
 }
 
@@ -1036,32 +2314,26 @@ template<typename T, size_t rows, size_t cols> void LEJITReader::readParam(std::
  */
 template<typename T> void LEJITReader::readParam(std::string id, std::vector<std::vector<T>> (&ptr))
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
-
-	if (this->checkRegistered(id, type(std::vector<std::vector<T>>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
-	}
+	TypedParam<std::vector<std::vector<T>>> *p = (TypedParam<std::vector<std::vector<T>>>*) this->checkSnapshot(id, type(std::vector<std::vector<T>>));
+	ptr = p->getValue();
 }
 
 /* 
- * readParam: 3D c-style array version, reading into a pointer
+ * readParam: 3D c-style array version, reading into a 2D array of row pointers
+ *		rows: number of rows to read
  */
 template<typename T, size_t arrdim0, size_t arrdim1> void LEJITReader::readParam(std::string id, T *(&ptr)[arrdim0][arrdim1], size_t rows)
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
-	}
-
-	if (this->checkRegistered(id, type(std::vector<std::vector<std::vector<T>>>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr, rows);
+	TypedParam<std::vector<std::vector<std::vector<T>>>> *p = (TypedParam<std::vector<std::vector<std::vector<T>>>>*) this->checkSnapshot(id, type(std::vector<std::vector<std::vector<T>>>));
+	const std::vector<std::vector<std::vector<T>>> &val = p->getValue();
+
+	this->checkLength(id, arrdim0, rows);
+	this->checkLength(id, val.size(), rows);
+	for (size_t i = 0; i < rows; i++) {
+		this->checkLength(id, val[i].size(), arrdim1);
+		for (size_t j = 0; j < arrdim1; j++) {
+			std::copy(val[i][j].begin(), val[i][j].end(), ptr[i][j]);
+		}
 	}
 }
 
@@ -1070,34 +2342,196 @@ template<typename T, size_t arrdim0, size_t arrdim1> void LEJITReader::readParam
  */ 
 template<typename T, size_t rows, size_t cols, size_t depth> void LEJITReader::readParam(std::string id, T (&ptr)[rows][cols][depth])
 {
+	TypedParam<std::vector<std::vector<std::vector<T>>>> *p = (TypedParam<std::vector<std::vector<std::vector<T>>>>*) this->checkSnapshot(id, type(std::vector<std::vector<std::vector<T>>>));
+	const std::vector<std::vector<std::vector<T>>> &val = p->getValue();
+
+	this->checkLength(id, val.size(), rows);
+	for (size_t i = 0; i < rows; i++) {
+		this->checkLength(id, val[i].size(), cols);
+		for (size_t j = 0; j < cols; j++) {
+			this->checkLength(id, val[i][j].size(), depth);
+			std::copy(val[i][j].begin(), val[i][j].begin() + depth, ptr[i][j]);
+		}
+	}
+}
+
+/*
+ * readParam: 3D array version, reading into a C++ vector
+ */
+template<typename T> void LEJITReader::readParam(std::string id, std::vector<std::vector<std::vector<T>>> (&ptr))
+{
+	TypedParam<std::vector<std::vector<std::vector<T>>>> *p = (TypedParam<std::vector<std::vector<std::vector<T>>>>*) this->checkSnapshot(id, type(std::vector<std::vector<std::vector<T>>>));
+	ptr = p->getValue();
+}
+
+/*
+ * readParam: flat array version, reading into memory viewed by an NDView.
+ *		Throws an error if the shape of the view differs from that of the
+ *		value in the config file
+ */
+template<typename T> void LEJITReader::readParam(std::string id, NDView<T> view)
+{
+	typedef typename std::remove_const<T>::type U;
+	TypedParam<NDArray<U>> *p = (TypedParam<NDArray<U>>*) this->checkSnapshot(id, type(NDArray<U>));
+	NDView<const U> val = p->getView();
+
+	this->checkLength(id, val.rank(), view.rank());
+	for (size_t d = 0; d < view.rank(); d++) {
+		this->checkLength(id, val.extent(d), view.extent(d));
+	}
+	std::copy(val.data(), val.data() + val.size(), view.data());
+}
+
+/*
+ * lejit_readfrozen: frozen version of readParam for scalars, and for flat
+ *		arrays read into an NDArray
+ */
+template<typename V, typename T> void lejit_readfrozen(const char *id, const V &value, T &ptr)
+{
+	static_assert(!std::is_array<T>::value, "frozen parameter doesn't have the rank of the array it is read into");
+	ptr = value;
+}
 
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
+/*
+ * lejit_readfrozen: frozen version of readParam for arrays of any rank read
+ *		into nested C++ vectors
+ */
+template<typename V, size_t n, typename T> void lejit_readfrozen(const char *id, const V (&value)[n], std::vector<T> &ptr)
+{
+	// Elements are read through a temporary, as vector<bool> has no element references
+	ptr.clear();
+	ptr.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		T elem;
+		lejit_readfrozen(id, value[i], elem);
+		ptr.push_back(std::move(elem));
 	}
+}
 
-	if (this->checkRegistered(id, type(std::vector<std::vector<std::vector<T>>>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
+/*
+ * lejit_readfrozen: frozen version of readParam for 1D arrays read into a
+ *		pointer. Throws an error if the array is shorter than size
+ */
+template<typename V, size_t n, typename T> void lejit_readfrozen(const char *id, const V (&value)[n], T *(&ptr), size_t size)
+{
+	if (n < size) {
+		throw std::invalid_argument(std::string("Parameter '") + id + "' has length " + std::to_string(n)
+		+ " in the frozen config, expected " + std::to_string(size) + "\n");
 	}
+	std::copy(value, value + size, ptr);
 }
 
 /*
- * readParam: 3D array version, reading into a C++ vector
+ * lejit_readfrozen: frozen version of readParam for 1D arrays read into a
+ *		C-style array, which can't be longer than the frozen one
  */
-template<typename T> void LEJITReader::readParam(std::string id, std::vector<std::vector<std::vector<T>>> (&ptr))
+template<typename V, size_t n, typename T, size_t size> void lejit_readfrozen(const char *id, const V (&value)[n], T (&ptr)[size])
+{
+	static_assert(n >= size, "frozen parameter is shorter than the array it is read into");
+	std::copy(value, value + size, ptr);
+}
+
+/*
+ * lejit_readfrozen: frozen version of readParam for 2D arrays read into an
+ *		array of row pointers
+ *		rows: number of rows to read
+ */
+template<typename V, size_t n, size_t c, typename T, size_t arrdim> void lejit_readfrozen(const char *id, const V (&value)[n][c], T *(&ptr)[arrdim], size_t rows)
+{
+	if (n < rows || arrdim < rows) {
+		throw std::invalid_argument(std::string("Parameter '") + id + "' has " + std::to_string(n)
+		+ " rows in the frozen config, expected " + std::to_string(rows) + "\n");
+	}
+	for (size_t i = 0; i < rows; i++) {
+		std::copy(value[i], value[i] + c, ptr[i]);
+	}
+}
+
+/*
+ * lejit_readfrozen: frozen version of readParam for 2D arrays read into a
+ *		C-style array
+ */
+template<typename V, size_t n, size_t c, typename T, size_t rows, size_t cols> void lejit_readfrozen(const char *id, const V (&value)[n][c], T (&ptr)[rows][cols])
+{
+	static_assert(n >= rows && c >= cols, "frozen parameter is smaller than the array it is read into");
+	for (size_t i = 0; i < rows; i++) {
+		std::copy(value[i], value[i] + cols, ptr[i]);
+	}
+}
+
+/*
+ * lejit_readfrozen: frozen version of readParam for 3D arrays read into a 2D
+ *		array of row pointers
+ *		rows: number of rows to read
+ */
+template<typename V, size_t n, size_t c, size_t d, typename T, size_t arrdim0, size_t arrdim1> void lejit_readfrozen(const char *id, const V (&value)[n][c][d], T *(&ptr)[arrdim0][arrdim1], size_t rows)
+{
+	static_assert(c >= arrdim1, "frozen parameter is smaller than the array it is read into");
+	if (n < rows || arrdim0 < rows) {
+		throw std::invalid_argument(std::string("Parameter '") + id + "' has " + std::to_string(n)
+		+ " rows in the frozen config, expected " + std::to_string(rows) + "\n");
+	}
+	for (size_t i = 0; i < rows; i++) {
+		for (size_t j = 0; j < arrdim1; j++) {
+			std::copy(value[i][j], value[i][j] + d, ptr[i][j]);
+		}
+	}
+}
+
+/*
+ * lejit_readfrozen: frozen version of readParam for 3D arrays read into a
+ *		C-style array
+ */
+template<typename V, size_t n, size_t c, size_t d, typename T, size_t rows, size_t cols, size_t depth> void lejit_readfrozen(const char *id, const V (&value)[n][c][d], T (&ptr)[rows][cols][depth])
 {
-	// Try to load the config file
-	if (luaL_loadfile(this->L, this->filename.c_str()) || lua_pcall(this->L, 0, 0, 0)) {
-		lua_error(L, "error in config file: %s\n", lua_tostring(this->L, -1));
+	static_assert(n >= rows && c >= cols && d >= depth, "frozen parameter is smaller than the array it is read into");
+	for (size_t i = 0; i < rows; i++) {
+		for (size_t j = 0; j < cols; j++) {
+			std::copy(value[i][j], value[i][j] + depth, ptr[i][j]);
+		}
 	}
+}
 
-	if (this->checkRegistered(id, type(std::vector<std::vector<std::vector<T>>>))) {
-		// Gets parameter value
-		lua_getglobal(this->L, id.c_str());
-		lua_gettopvalue(this->L, ptr);
+/*
+ * lejit_readfrozen: frozen version of readParam for flat arrays read into
+ *		memory viewed by an NDView. Throws an error if the shape of the view
+ *		differs from that of the frozen array
+ */
+template<typename V, typename T> void lejit_readfrozen(const char *id, const V &value, NDView<T> view)
+{
+	typedef typename std::remove_all_extents<V>::type U;
+	std::vector<size_t> shape;
+	nd_shape<V>(shape);
+	if (shape != view.getShape()) {
+		throw std::invalid_argument(std::string("Parameter '") + id + "' in the frozen config doesn't have the shape of the view it is read into\n");
 	}
+
+	const U *first = reinterpret_cast<const U *>(&value);
+	std::copy(first, first + nd_size(shape), view.data());
+}
+
+/*
+ * getArrayView: gets a view of the snapshotted value of a flat array
+ *		parameter. Values mapped from sidecar files are not copied
+ */
+template<typename T> NDView<const T> LEJITReader::getArrayView(std::string id)
+{
+	TypedParam<NDArray<T>> *p = (TypedParam<NDArray<T>>*) this->checkSnapshot(id, type(NDArray<T>));
+	return p->getView();
+}
+
+/*
+ * readBatchParam: reads the batched form of a function parameter out of the
+ *		config file snapshot. The parameter must be registered as a function of
+ *		scalar arguments, e.g. "ddd>d" with type void(double, double, double,
+ *		double*) is read with type void(int, double*, double*, double*, double*)
+ */
+template<typename ...bargs> void LEJITReader::readBatchParam(std::string id, std::function<void(int, bargs...)> &ptr)
+{
+	BatchParam<bargs...> *p = this->checkBatchRegistered<bargs...>(id);
+	this->checkSnapshot(p);
+	p->getLuaBatchFunc();
+	ptr = p->getMostRecentBatch();
 }
 
 /*
@@ -1109,11 +2543,226 @@ template<typename ...args> void LEJITReader::getMostRecentFunc(std::string id, s
 	ptr = ((TypedParam<std::function<void(args...)>>*)p)->getMostRecent();
 }
 
+/*
+ * getFuncParam: Gets a registered function parameter. Calling through it
+ *		always uses the most recently read version of the function
+ */
+template<typename ...args> TypedParam<std::function<void(args...)>> * LEJITReader::getFuncParam(std::string id)
+{
+	return (TypedParam<std::function<void(args...)>>*) this->checkRegistered(id, type(std::function<void(args...)>));
+}
+
+/*
+ * getMostRecentBatchFunc: Gets the most recently read batched form of a function parameter
+ */
+template<typename ...bargs> void LEJITReader::getMostRecentBatchFunc(std::string id, std::function<void(int, bargs...)> &ptr)
+{
+	ptr = this->checkBatchRegistered<bargs...>(id)->getMostRecentBatch();
+}
+
+/*
+ * parallelMap: calls a function parameter with scalar arguments on each of the
+ *		n elements of its argument arrays. Chunks of elements are spread
+ *		across threads, and each thread runs the batched form of the function
+ *		on them in its own Lua state, e.g. "dd>d" with type void(double,
+ *		double, double*) is mapped with parallelMap(id, n, double*, double*,
+ *		double*)
+ */
+template<typename ...bargs> void LEJITReader::parallelMap(std::string id, int n, bargs... a)
+{
+	BatchParam<bargs...> *p = this->checkBatchRegistered<bargs...>(id);
+	this->enableThreads();
+	this->checkSnapshot(p);
+
+	std::function<void(int, bargs...)> func = p->getLuaBatchFunc();
+	parallel_for(n, this->grain, this->num_threads, [&](int thread, int begin, int end) {
+		func(end - begin, (a + begin)...);
+	});
+}
+
+/*
+ * parallelReduce: calls a function parameter of type void(int, T*), e.g.
+ *		"i>d", on each index in [0, n) and combines the results. Each thread
+ *		combines the results of its own chunks, then the partial results are
+ *		combined with init on the calling thread
+ *
+ *		init: starting value of the reduction
+ *		combine: callable taking two T and returning their combination
+ */
+template<typename T, typename F> T LEJITReader::parallelReduce(std::string id, int n, T init, F combine)
+{
+	BatchParam<int*, T*> *p = this->checkBatchRegistered<int*, T*>(id);
+	this->enableThreads();
+	this->checkSnapshot(p);
+
+	std::function<void(int, int*, T*)> func = p->getLuaBatchFunc();
+
+	// Index and result buffers and partial result of each thread
+	int num_threads = this->num_threads;
+	std::vector<std::vector<int>> indices(num_threads);
+	std::vector<std::vector<T>> results(num_threads);
+	std::vector<T> partial(num_threads, init);
+	std::vector<char> has_partial(num_threads, 0);
+
+	parallel_for(n, this->grain, num_threads, [&](int thread, int begin, int end) {
+		std::vector<int> &index = indices[thread];
+		std::vector<T> &result = results[thread];
+		index.resize(end - begin);
+		result.resize(end - begin);
+		for (int i = begin; i < end; i++) {
+			index[i - begin] = i;
+		}
+
+		func(end - begin, index.data(), result.data());
+
+		for (int i = 0; i < end - begin; i++) {
+			if (has_partial[thread]) {
+				partial[thread] = combine(partial[thread], result[i]);
+			}
+			else {
+				partial[thread] = result[i];
+				has_partial[thread] = 1;
+			}
+		}
+	});
+
+	T ret = init;
+	for (int t = 0; t < num_threads; t++) {
+		if (has_partial[t]) {
+			ret = combine(ret, partial[t]);
+		}
+	}
+	return ret;
+}
+
+/*
+ * getStats: gets the call statistics of a function parameter. All values
+ *		are 0 if statistics are disabled
+ */
+LuaStatsValues LEJITReader::getStats(std::string id)
+{
+	auto ent = this->paramlist.find(id);
+	if (ent == this->paramlist.end()) {
+		throw std::invalid_argument(std::string("Parameter '") + id
+		+ std::string("' is not registered. Register parameter before calling getStats\n"));
+	}
+
+	LuaStatsValues values = {};
+	std::shared_ptr<LuaStats> stats = (ent->second)->getStats();
+	if (stats) {
+		values = stats->get();
+	}
+	return values;
+}
+
+/*
+ * getAllStats: gets the call statistics of all function parameters, by
+ *		identifier
+ */
+std::map<std::string, LuaStatsValues> LEJITReader::getAllStats()
+{
+	std::map<std::string, LuaStatsValues> ret;
+	for (auto ent : this->paramlist) {
+		std::shared_ptr<LuaStats> stats = (ent.second)->getStats();
+		if (stats) {
+			ret[ent.first] = stats->get();
+		}
+	}
+	return ret;
+}
+
+/*
+ * clearStats: sets the call statistics of all function parameters back to 0
+ */
+void LEJITReader::clearStats()
+{
+	for (auto ent : this->paramlist) {
+		std::shared_ptr<LuaStats> stats = (ent.second)->getStats();
+		if (stats) {
+			stats->clear();
+		}
+	}
+}
+
+/*
+ * setStatsTiming: times calls to all function parameters, including those
+ *		registered later, as well as counting them
+ */
+void LEJITReader::setStatsTiming(bool timing)
+{
+	this->stats_timing = timing;
+	for (auto ent : this->paramlist) {
+		std::shared_ptr<LuaStats> stats = (ent.second)->getStats();
+		if (stats) {
+			stats->setTiming(timing);
+		}
+	}
+}
+
+/*
+ * getStatsJSON: returns the call statistics of all function parameters as a
+ *		JSON object keyed by identifier, with times in seconds
+ */
+std::string LEJITReader::getStatsJSON()
+{
+	std::string ret = "{";
+	bool first = true;
+	char buf[512];
+
+	for (auto ent : this->getAllStats()) {
+		LuaStatsValues &v = ent.second;
+		snprintf(buf, sizeof(buf), "%s\n  \"%s\": {\"calls\": %llu, \"errors\": %llu, \"timed_calls\": %llu, \"total_s\": %.9g, "
+			"\"max_s\": %.9g, \"memo_hits\": %llu, \"memo_misses\": %llu}",
+			first ? "" : ",", ent.first.c_str(), (unsigned long long) v.calls, (unsigned long long) v.errors,
+			(unsigned long long) v.timed_calls, v.total_ns * 1e-9, v.max_ns * 1e-9,
+			(unsigned long long) v.memo_hits, (unsigned long long) v.memo_misses);
+		ret += buf;
+		first = false;
+	}
+
+	ret += "\n}\n";
+	return ret;
+}
+
+/*
+ * writeStatsFile: writes getStatsJSON to a file, returns false if the file
+ *		can't be opened
+ */
+bool LEJITReader::writeStatsFile(std::string filename)
+{
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		printf("Unable to open file\n");
+		return false;
+	}
+
+	file << this->getStatsJSON();
+	file.close();
+	return true;
+}
+
+/*
+ * writeStatsAtExit: writes the call statistics to filename when the program
+ *		exits, unless the reader has been deleted by then
+ */
+void LEJITReader::writeStatsAtExit(std::string filename)
+{
+	static bool registered = false;
+	std::map<LEJITReader*, std::string> &readers = statsAtExit();
+	if (!registered) {
+		atexit(writeStatsAtExitHandler);
+		registered = true;
+	}
+
+	readers[this] = filename;
+}
+
 /*
  * writeConfigFile: writes a Lua configuration file with all stored parameters
  *		as global variables set to their default values, which can be modified 
  * 		by a user and read with getParam. If file already exists, does not 
- * 		modify it and returns 0.
+ * 		modify it and returns 0. Parameters are formatted straight into the
+ *		file, with numbers written so they read back exactly
  */
 bool LEJITReader::writeConfigFile()
 {
@@ -1144,18 +2793,82 @@ bool LEJITReader::writeConfigFile()
 			file << "local th = require 'torch'\n\n";
 		}
 		
-		// Write each parameter
+		// Write each parameter, large arrays going to sidecar files
 		for (auto ent : this->paramlist) {
-			file << (ent.second)->getLuaString();
+			if (this->sidecar_threshold) {
+				(ent.second)->writeSidecar(this->dir, this->sidecar_threshold);
+			}
+			(ent.second)->writeLua(file);
 			file << "\n";
 		}
 
-		// Close file
+		// Close file, checking that every write made it to disk
 		file.close();
+		if (!file) {
+			printf("Unable to write file\n");
+			return false;
+		}
 		return true;
 	}
 	else {
 		printf("Unable to open file\n");
 		return false;
 	}
+}
+
+/*
+ * writeFrozenHeader: writes the snapshotted value of each parameter which can
+ *		be a C++ constant to a header, in namespace lejit_frozen. Parameters
+ *		which can't, such as functions, or which are missing from the config
+ *		file, are listed in comments. The header is written to a temporary
+ *		file first, so a build never includes a partly written one
+ */
+bool LEJITReader::writeFrozenHeader(std::string filename)
+{
+	if (!this->loaded) {
+		this->reload();
+	}
+
+	std::string tmp = filename + ".tmp";
+	std::ofstream file(tmp);
+	if (!file.is_open()) {
+		printf("Unable to open file\n");
+		return false;
+	}
+
+	file << "/*\n";
+	file << " * Parameters of " << this->filename << " frozen by LEJITReader::writeFrozenHeader.\n";
+	file << " * Build with -DLEJIT_FROZEN to read them from here instead of the config file.\n";
+	file << " */\n\n";
+	file << "#ifndef LEJIT_FROZEN_CONFIG\n";
+	file << "#define LEJIT_FROZEN_CONFIG\n\n";
+	file << "#include <limits>\n\n";
+	file << "namespace lejit_frozen {\n\n";
+
+	for (auto ent : this->paramlist) {
+		if (!(ent.second)->hasValue() && !(ent.second)->getError().empty()) {
+			file << "// " << ent.first << " " << (ent.second)->getError() << " in the config file\n\n";
+		}
+		else if (!(ent.second)->hasValue()) {
+			file << "// " << ent.first << " is missing from the config file\n\n";
+		}
+		else if (!(ent.second)->writeFrozen(file)) {
+			file << "// " << ent.first << " can't be frozen and is read from the config file\n\n";
+		}
+		else {
+			file << "\n";
+		}
+	}
+
+	file << "}\n\n";
+	file << "#endif\n";
+
+	// Close file, checking that every write made it to disk
+	file.close();
+	if (!file || rename(tmp.c_str(), filename.c_str()) != 0) {
+		printf("Unable to write file\n");
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
 }
\ No newline at end of file
@@ -37,6 +37,15 @@ void lua_error(lua_State *L, std::string fmt, ...)
 	exit(EXIT_FAILURE);
 }
 
+/*
+ * lua_newshared: creates a Lua state owned by the returned pointer and every
+ *		copy of it. The state is closed once the last copy is released
+ */
+std::shared_ptr<lua_State> lua_newshared()
+{
+	return std::shared_ptr<lua_State>(luaL_newstate(), lua_close);
+}
+
 /*
  * lua_gettopvalue: fetches the value on the top of the lua stack and pops it
  * from the stack
@@ -65,162 +74,334 @@ void lua_gettopvalue(lua_State *L, std::string &ptr)
 	lua_pop(L, 1);
 }
 
-template<typename T> void lua_gettopvalue(lua_State *L, T *ptr, size_t size)
+/*
+ * lua_rawtoelement: converts the array element on the top of the lua stack
+ *		without popping it
+ */
+inline void lua_rawtoelement(lua_State *L, int &ptr)
 {
-	printf("In gettopvalue\n");
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
+	if (!lua_isnumber(L, -1)) {
+		lua_error(L, "expected array element to be a number\n");
 	}
+	ptr = (int) lua_tointeger(L, -1);
+}
 
-	for (int i = 0; i < size; i++) {
-		// Get indexed table value
-		lua_pushinteger(L, i + 1); 
-		lua_gettable(L, -2);
-		T val;
-		lua_gettopvalue(L, val);
-		ptr[i] = val;
+inline void lua_rawtoelement(lua_State *L, double &ptr)
+{
+	if (!lua_isnumber(L, -1)) {
+		lua_error(L, "expected array element to be a number\n");
 	}
+	ptr = lua_tonumber(L, -1);
+}
 
-	lua_pop(L, 1);
-	printf("Returning from gettopvalue\n");
+inline void lua_rawtoelement(lua_State *L, bool &ptr)
+{
+	if (!lua_isnumber(L, -1)) {
+		lua_error(L, "expected array element to be a number\n");
+	}
+	ptr = lua_tonumber(L, -1);
 }
 
-template<typename T, size_t size> void lua_gettopvalue(lua_State *L, T (&ptr)[size])
+inline void lua_rawtoelement(lua_State *L, std::string &ptr)
+{
+	if (!lua_isstring(L, -1)) {
+		lua_error(L, "expected array element to be a string\n");
+	}
+	size_t len;
+	const char *str = lua_tolstring(L, -1, &len);
+	ptr.assign(str, len);
+}
+
+/*
+ * lua_rawtablelen: checks that the value at index is a table and returns its
+ *		length. If min is given, the table must have at least min elements,
+ *		or exactly min elements if exact is set
+ */
+inline size_t lua_rawtablelen(lua_State *L, int index, size_t min = 0, bool exact = false)
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
+	if (!lua_istable(L, index)) {
 		lua_error(L, "expected parameter value to be a lua table\n");
 	}
 
-	for (int i = 0; i < size; i++) {
-		// Get indexed table value
-		lua_pushinteger(L, i + 1); 
-		lua_gettable(L, -2);
-		T val;
-		lua_gettopvalue(L, val);
-		ptr[i] = val;
+	size_t len = lua_objlen(L, index);
+	if (len < min) {
+		lua_error(L, "expected lua table of at least %d elements, got %d\n", (int) min, (int) len);
 	}
+	if (exact && len != min) {
+		lua_error(L, "expected lua table of %d elements, got %d\n", (int) min, (int) len);
+	}
+	return len;
+}
 
-	lua_pop(L, 1);
+/*
+ * lua_rawtoarray: copies the first size elements of the table at index into
+ *		dst. Uses raw accesses, which skip metamethods and don't push keys,
+ *		and checks the table length once up front. dst is anything indexable,
+ *		e.g. a pointer or vector iterator
+ */
+template<typename T, typename Out> void lua_rawtoarray(lua_State *L, int index, Out dst, size_t size, bool exact)
+{
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
+	}
+	lua_rawtablelen(L, index, size, exact);
+
+	T val;
+	for (size_t i = 0; i < size; i++) {
+		lua_rawgeti(L, index, (int) i + 1);
+		lua_rawtoelement(L, val);
+		dst[i] = val;
+		lua_pop(L, 1);
+	}
 }
 
-template<typename T> void lua_gettopvalue(lua_State *L, std::vector<T> (&ptr))
+/*
+ * lua_rawtoarray: version for nested tables of ndims dimensions, copied into
+ *		the contiguous row major array dst of dimensions dims
+ */
+template<typename T> void lua_rawtoarray(lua_State *L, int index, T *dst, const size_t *dims, int ndims, bool exact)
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
+	if (ndims == 1) {
+		lua_rawtoarray<T>(L, index, dst, dims[0], exact);
+		return;
 	}
 
-	size_t size = ptr.size();
-	for (int i = 0; i < size; i++) {
-		// Get indexed table value
-		lua_pushinteger(L, i + 1); 
-		lua_gettable(L, -2);
-		T val;
-		lua_gettopvalue(L, val);
-		ptr[i] = val;
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
 	}
+	lua_rawtablelen(L, index, dims[0], exact);
 
-	lua_pop(L, 1);
+	size_t stride = 1;
+	for (int d = 1; d < ndims; d++) {
+		stride *= dims[d];
+	}
+
+	for (size_t i = 0; i < dims[0]; i++) {
+		lua_rawgeti(L, index, (int) i + 1);
+		lua_rawtoarray(L, -1, dst + i * stride, dims + 1, ndims - 1, exact);
+		lua_pop(L, 1);
+	}
 }
 
-template <typename T, size_t cols> void lua_gettopvalue(lua_State *L, T (&ptr)[cols], size_t rows)
+/*
+ * lua_rawtovector: resizes ptr to the length of the table at index and
+ *		copies the table into it
+ */
+template<typename T> void lua_rawtovector(lua_State *L, int index, std::vector<T> &ptr)
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
+	ptr.resize(lua_rawtablelen(L, index));
+	lua_rawtoarray<T>(L, index, ptr.begin(), ptr.size());
+}
+
+template<typename T> void lua_rawtovector(lua_State *L, int index, std::vector<std::vector<T>> &ptr)
+{
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
 	}
+	ptr.resize(lua_rawtablelen(L, index));
 
-	for (int i = 0; i < rows; i++) {
-		lua_pushinteger(L, i + 1);
-		lua_gettable(L, -2);
-		lua_gettopvalue(L, *(ptr + i));
+	for (size_t i = 0; i < ptr.size(); i++) {
+		lua_rawgeti(L, index, (int) i + 1);
+		lua_rawtovector(L, -1, ptr[i]);
+		lua_pop(L, 1);
 	}
+}
 
+/*
+ * lua_gettopvalue: array versions. Pop the table on the top of the lua stack
+ *		after copying it
+ */
+template<typename T> void lua_gettopvalue(lua_State *L, T *ptr, size_t size)
+{
+	lua_rawtoarray<T>(L, -1, ptr, size);
 	lua_pop(L, 1);
 }
 
-template<typename T, size_t rows, size_t cols> void lua_gettopvalue(lua_State *L, T (&ptr)[rows][cols])
+template<typename T, size_t size> void lua_gettopvalue(lua_State *L, T (&ptr)[size])
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
-	}
+	lua_rawtoarray<T>(L, -1, ptr, size);
+	lua_pop(L, 1);
+}
 
-	for (int i = 0; i < rows; i++) {
-		lua_pushinteger(L, i + 1);
-		lua_gettable(L, -2);
-		lua_gettopvalue(L, *(ptr + i));
-	}
+template<typename T> void lua_gettopvalue(lua_State *L, std::vector<T> (&ptr))
+{
+	lua_rawtovector(L, -1, ptr);
+	lua_pop(L, 1);
+}
+
+template <typename T, size_t cols> void lua_gettopvalue(lua_State *L, T (&ptr)[cols], size_t rows)
+{
+	// ptr is the first of rows contiguous rows
+	size_t dims[] = { rows, cols };
+	lua_rawtoarray(L, -1, &ptr[0], dims, 2);
+	lua_pop(L, 1);
+}
 
+template<typename T, size_t rows, size_t cols> void lua_gettopvalue(lua_State *L, T (&ptr)[rows][cols])
+{
+	size_t dims[] = { rows, cols };
+	lua_rawtoarray(L, -1, &ptr[0][0], dims, 2);
 	lua_pop(L, 1);
 }
 
 template<typename T> void lua_gettopvalue(lua_State *L, std::vector<std::vector<T>> (&ptr))
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
-	}
+	lua_rawtovector(L, -1, ptr);
+	lua_pop(L, 1);
+}
 
-	size_t size = ptr.size();
-	for (int i = 0; i < size; i++) {
-		lua_pushinteger(L, i + 1);
-		lua_gettable(L, -2);
-		lua_gettopvalue(L, *(ptr + i));	
-	}
+template <typename T, size_t cols, size_t depth> void lua_gettopvalue(lua_State *L, T (&ptr)[cols][depth], size_t rows)
+{
+	size_t dims[] = { rows, cols, depth };
+	lua_rawtoarray(L, -1, &ptr[0][0], dims, 3);
+	lua_pop(L, 1);
+}
 
+template<typename T, size_t rows, size_t cols, size_t depth> void lua_gettopvalue(lua_State *L, T (&ptr)[rows][cols][depth])
+{
+	size_t dims[] = { rows, cols, depth };
+	lua_rawtoarray(L, -1, &ptr[0][0][0], dims, 3);
 	lua_pop(L, 1);
 }
 
-template <typename T, size_t cols, size_t depth> void lua_gettopvalue(lua_State *L, T (&ptr)[cols][depth], size_t rows)
+template<typename T> void lua_gettopvalue(lua_State *L, std::vector<std::vector<std::vector<T>>> (&ptr))
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
-	}
+	lua_rawtovector(L, -1, ptr);
+	lua_pop(L, 1);
+}
 
-	for (int i = 0; i < rows; i++) {
-		lua_pushinteger(L, i + 1);
-		lua_gettable(L, -2);
-		lua_gettopvalue(L, *(ptr + i));
+/*
+ * lua_gettopvalue: version for flat arrays of any rank. The rank and shape
+ *		are taken from the first element along each dimension, then the
+ *		nested tables are copied into the array in one pass. Every table
+ *		must have exactly the length of its dimension, so ragged tables are
+ *		an error instead of being truncated
+ */
+template<typename T> void lua_gettopvalue(lua_State *L, NDArray<T> (&ptr))
+{
+	int top = lua_gettop(L);
+
+	std::vector<size_t> shape;
+	shape.push_back(lua_rawtablelen(L, top));
+	lua_rawgeti(L, top, 1);
+	while (lua_istable(L, -1)) {
+		shape.push_back(lua_objlen(L, -1));
+		lua_rawgeti(L, -1, 1);
 	}
+	lua_settop(L, top);
 
+	ptr.reshape(shape);
+	lua_rawtoarray(L, top, ptr.data(), shape.data(), (int) shape.size(), true);
 	lua_pop(L, 1);
 }
 
-template<typename T, size_t rows, size_t cols, size_t depth> void lua_gettopvalue(lua_State *L, T (&ptr)[rows][cols][depth])
+template <typename T> bool lua_getglobalvalue(lua_State *L, std::string name, T &ptr)
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
+	lua_getglobal(L, name.c_str());
+
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return false;
 	}
 
-	for (int i = 0; i < rows; i++) {
-		lua_pushinteger(L, i + 1);
-		lua_gettable(L, -2);
-		lua_gettopvalue(L, *(ptr + i));
+	lua_gettopvalue(L, ptr);
+	return true;
+}
+
+/*
+ * lua_isvalue: versions for each type lua_gettopvalue reads. Numbers may be
+ *		given as numeric strings, and strings as numbers, as the
+ *		conversions accept both
+ */
+bool lua_isvalue(lua_State *L, int index, const int *)
+{
+	return lua_isnumber(L, index);
+}
+
+bool lua_isvalue(lua_State *L, int index, const double *)
+{
+	return lua_isnumber(L, index);
+}
+
+bool lua_isvalue(lua_State *L, int index, const bool *)
+{
+	return lua_isnumber(L, index);
+}
+
+bool lua_isvalue(lua_State *L, int index, const std::string *)
+{
+	return lua_isstring(L, index);
+}
+
+/*
+ * lua_isvalue: version for vectors, nested to any depth. Every element of the
+ *		table must be readable
+ */
+template <typename T> bool lua_isvalue(lua_State *L, int index, const std::vector<T> *)
+{
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
+	}
+	if (!lua_istable(L, index)) {
+		return false;
 	}
 
-	lua_pop(L, 1);
+	size_t len = lua_objlen(L, index);
+	bool ok = true;
+	for (size_t i = 0; ok && i < len; i++) {
+		lua_rawgeti(L, index, (int) i + 1);
+		ok = lua_isvalue(L, -1, (const T *) nullptr);
+		lua_pop(L, 1);
+	}
+	return ok;
 }
 
-template<typename T> void lua_gettopvalue(lua_State *L, std::vector<std::vector<std::vector<T>>> (&ptr))
+/*
+ * lua_isarrayvalue: checks that the table at index holds nested tables of
+ *		exactly the ndims dimensions dims, with readable elements
+ */
+template <typename T> bool lua_isarrayvalue(lua_State *L, int index, const size_t *dims, int ndims)
 {
-	// Check if stack value is a table
-	if (!lua_istable(L, -1)) {
-		lua_error(L, "expected parameter value to be a lua table\n");
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
+	}
+	if (!lua_istable(L, index) || lua_objlen(L, index) != dims[0]) {
+		return false;
 	}
 
-	size_t size = ptr.size();
-	for (int i = 0; i < size; i++) {
-		lua_pushinteger(L, i + 1);
-		lua_gettable(L, -2);
-		lua_gettopvalue(L, *(ptr + i));
+	bool ok = true;
+	for (size_t i = 0; ok && i < dims[0]; i++) {
+		lua_rawgeti(L, index, (int) i + 1);
+		ok = (ndims == 1) ? lua_isvalue(L, -1, (const T *) nullptr) : lua_isarrayvalue<T>(L, -1, dims + 1, ndims - 1);
+		lua_pop(L, 1);
 	}
+	return ok;
+}
 
-	lua_pop(L, 1);
+/*
+ * lua_isvalue: version for flat arrays of any rank. The shape is found the
+ *		same way lua_gettopvalue finds it, and the tables must be rectangular
+ */
+template <typename T> bool lua_isvalue(lua_State *L, int index, const NDArray<T> *)
+{
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
+	}
+	if (!lua_istable(L, index)) {
+		return false;
+	}
+
+	int top = lua_gettop(L);
+	std::vector<size_t> shape;
+	shape.push_back(lua_objlen(L, index));
+	lua_rawgeti(L, index, 1);
+	while (lua_istable(L, -1)) {
+		shape.push_back(lua_objlen(L, -1));
+		lua_rawgeti(L, -1, 1);
+	}
+	lua_settop(L, top);
+
+	return lua_isarrayvalue<T>(L, index, shape.data(), (int) shape.size());
 }
 
 void lua_pushtableindex(lua_State *L, int index, int value)
@@ -535,3 +716,2267 @@ void lua_callfunc(lua_State *L, std::string func_name, std::string signature, ..
 
 	va_end(v1);
 }
+
+
+/*
+ * lua_parsesignature: parses a signature string (see lua_callfunc) into one
+ *		kind character per argument and returns the number of inparams.
+ *		Digits following an array type are ignored.
+ *
+ *		kinds: output buffer with room for num_args characters
+ *		num_args: number of arguments the signature is expected to describe
+ */
+int lua_parsesignature(lua_State *L, std::string signature, char *kinds, size_t num_args)
+{
+	const char *sig = signature.c_str();
+	int num_in = -1;
+	size_t n = 0;
+
+	while (*sig) {
+		if (n >= num_args && *sig != '>' && !isdigit(*sig)) {
+			lua_error(L, "signature '%s' has more than %zu arguments\n", signature.c_str(), num_args);
+		}
+
+		switch (*sig++) {
+			case 'i':
+			case 'd':
+			case 'b':
+				kinds[n++] = *(sig - 1);
+				break;
+
+			case 'a':	// C-style array
+			case 'c': {	// C-style array passed as FFI cdata
+				switch (*sig++) {
+					case 'i':
+					case 'd':
+					case 'b':
+						kinds[n++] = *(sig - 2);
+						break;
+					default:
+						lua_error(L, "invalid argument type: (%c%c)\n", *(sig - 2), *(sig - 1));
+				}
+
+				// Skip array dimensions
+				while (isdigit(*sig)) {
+					sig++;
+				}
+				break;
+			}
+
+			case '>': {	// end of inparams
+				num_in = n;
+				break;
+			}
+			default:
+				lua_error(L, "invalid argument type: (%c)\n", *(sig - 1));
+		}
+
+		// Lua writes to cdata arrays in place, so they can't be outparams
+		if (num_in >= 0 && n > (size_t) num_in && kinds[n - 1] == 'c') {
+			lua_error(L, "cdata array in signature '%s' must be an inparam\n", signature.c_str());
+		}
+	}
+
+	if (n != num_args) {
+		lua_error(L, "signature '%s' does not match function with %zu arguments\n", signature.c_str(), num_args);
+	}
+
+	// No '>' means there are no outparams
+	return (num_in < 0) ? n : num_in;
+}
+
+void lua_pushargument(lua_State *L, int val, char kind)
+{
+	lua_pushinteger(L, val);
+}
+
+void lua_pushargument(lua_State *L, double val, char kind)
+{
+	lua_pushnumber(L, val);
+}
+
+void lua_pushargument(lua_State *L, bool val, char kind)
+{
+	lua_pushboolean(L, val);
+}
+
+template <typename T> void lua_pushargument(lua_State *L, T *val, char kind)
+{
+	if (kind == 'c') {
+		// Converted to an FFI pointer by the wrapper from lua_wrapcdata
+		lua_pushlightuserdata(L, (void *) val);
+	}
+	else {
+		lua_pushcarray(L, val);
+	}
+}
+
+template <typename T> const char * lua_ctypename(T val)
+{
+	return "";
+}
+
+const char * lua_ctypename(int *val)
+{
+	return "int *";
+}
+
+const char * lua_ctypename(double *val)
+{
+	return "double *";
+}
+
+const char * lua_ctypename(bool *val)
+{
+	return "bool *";
+}
+
+/*
+ * lua_wrapcdata: replaces the function on top of the stack with a Lua wrapper
+ *		which casts each cdata array argument from a light userdata to an FFI
+ *		pointer before calling it. Unlike lua_pushcarray this needs no
+ *		allocation per call, and element access in the wrapped function is
+ *		compiled by LuaJIT to native loads and stores. Indices are zero-based
+ *		and there is no bounds checking.
+ *
+ *		kinds: argument kinds from lua_parsesignature
+ *		ctypes: FFI type name of each argument
+ *		num_in: number of inparams
+ */
+void lua_wrapcdata(lua_State *L, const char *kinds, const char **ctypes, int num_in)
+{
+	std::string code = "local ffi = require 'ffi'\nlocal f = ...\n";
+	std::string params = "";
+	std::string call = "";
+
+	for (int i = 0; i < num_in; i++) {
+		std::string arg = "a" + std::to_string(i);
+
+		if (kinds[i] == 'c') {
+			// Parse each FFI type once, outside of the wrapper
+			code += "local t" + std::to_string(i) + " = ffi.typeof('" + ctypes[i] + "')\n";
+			call += "ffi.cast(t" + std::to_string(i) + ", " + arg + ")";
+		}
+		else {
+			call += arg;
+		}
+
+		params += arg;
+		if (i < num_in - 1) {
+			params += ", ";
+			call += ", ";
+		}
+	}
+
+	code += "return function(" + params + ") return f(" + call + ") end\n";
+
+	// Call the generated chunk with the function to get the wrapper
+	if (luaL_loadstring(L, code.c_str())) {
+		lua_error(L, "error creating cdata wrapper: %s\n", lua_tostring(L, -1));
+	}
+	lua_insert(L, -2);
+	if (lua_pcall(L, 1, 1, 0) != 0) {
+		lua_error(L, "error creating cdata wrapper: %s\n", lua_tostring(L, -1));
+	}
+}
+
+/*
+ * lua_wrapbatch: replaces the function on top of the stack with a Lua driver
+ *		which takes an element count followed by one FFI pointer (passed as
+ *		light userdata) per argument, and calls the function once for each
+ *		element. Results are stored in the outparam arrays. Only scalar
+ *		arguments can be batched.
+ *
+ *		kinds: argument kinds from lua_parsesignature
+ *		num_in: number of inparams
+ *		num_args: total number of arguments
+ */
+void lua_wrapbatch(lua_State *L, const char *kinds, int num_in, int num_args)
+{
+	std::string code = "local ffi = require 'ffi'\nlocal f = ...\n";
+	std::string params = "n";
+	std::string casts = "";
+	std::string call = "";
+	std::string results = "";
+
+	for (int i = 0; i < num_args; i++) {
+		std::string t = "t" + std::to_string(i);
+		std::string p = "p" + std::to_string(i);
+		std::string arg = "a" + std::to_string(i);
+
+		switch (kinds[i]) {
+			case 'i':
+				code += "local " + t + " = ffi.typeof('int *')\n";
+				break;
+			case 'd':
+				code += "local " + t + " = ffi.typeof('double *')\n";
+				break;
+			case 'b':
+				code += "local " + t + " = ffi.typeof('bool *')\n";
+				break;
+			default:
+				lua_error(L, "only functions with scalar arguments can be batched\n");
+		}
+
+		params += ", " + arg;
+		casts += "\tlocal " + p + " = ffi.cast(" + t + ", " + arg + ")\n";
+
+		if (i < num_in) {
+			call += (i > 0 ? ", " : "") + p + "[i]";
+		}
+		else {
+			results += (i > num_in ? ", " : "") + std::string("r") + std::to_string(i);
+		}
+	}
+
+	// Loop over the batch, storing results in the outparam arrays
+	code += "return function(" + params + ")\n" + casts;
+	code += "\tfor i = 0, n - 1 do\n";
+	if (num_in < num_args) {
+		code += "\t\tlocal " + results + " = f(" + call + ")\n";
+		for (int i = num_in; i < num_args; i++) {
+			code += "\t\tp" + std::to_string(i) + "[i] = r" + std::to_string(i) + "\n";
+		}
+	}
+	else {
+		code += "\t\tf(" + call + ")\n";
+	}
+	code += "\tend\nend\n";
+
+	// Call the generated chunk with the function to get the driver
+	if (luaL_loadstring(L, code.c_str())) {
+		lua_error(L, "error creating batch driver: %s\n", lua_tostring(L, -1));
+	}
+	lua_insert(L, -2);
+	if (lua_pcall(L, 1, 1, 0) != 0) {
+		lua_error(L, "error creating batch driver: %s\n", lua_tostring(L, -1));
+	}
+}
+
+/*
+ * lua_getresult: fetches the function result at stack index index into an
+ *		outparam. Non-pointer outparams are rejected by LuaFunc on construction
+ */
+template <typename T> void lua_getresult(lua_State *L, int index, T val, char kind)
+{
+	lua_error(L, "outparams must be pointers\n");
+}
+
+template <typename T> void lua_getresult(lua_State *L, int index, T *ptr, char kind)
+{
+	// Copy result to the top of the stack to convert it
+	lua_pushvalue(L, index);
+
+	if (kind == 'a') {
+		// Arrays are returned as tables with no bounds checking
+		lua_gettopvalue(L, ptr, lua_objlen(L, -1));
+	}
+	else if (kind == 'b') {
+		if (!lua_isboolean(L, -1)) {
+			lua_error(L, "return value is not boolean as expected\n");
+		}
+		*ptr = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+	}
+	else {
+		lua_gettopvalue(L, *ptr);
+	}
+}
+
+/*
+ * lua_dumptop: dumps the function on top of the stack to a string of
+ *		bytecode which can be loaded into another Lua state with luaL_loadbuffer
+ */
+static int lua_stringwriter(lua_State *L, const void *p, size_t size, void *ud)
+{
+	((std::string *) ud)->append((const char *) p, size);
+	return 0;
+}
+std::string lua_dumptop(lua_State *L)
+{
+	std::string bytecode;
+	if (lua_dump(L, lua_stringwriter, &bytecode) != 0) {
+		lua_error(L, "error dumping config file bytecode\n");
+	}
+	return bytecode;
+}
+
+/*
+ * lua_hashstring: 64 bit FNV-1a hash of a string. Pass a previous hash to
+ *		continue hashing from it
+ */
+uint64_t lua_hashstring(const std::string &str, uint64_t hash)
+{
+	for (unsigned char c : str) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*
+ * lua_mtime: modification time of a stat result in nanoseconds since the
+ *		epoch, as precise as the file system records it
+ */
+uint64_t lua_mtime(const struct stat &st)
+{
+#ifdef __APPLE__
+	return (uint64_t) st.st_mtimespec.tv_sec * 1000000000ULL + st.st_mtimespec.tv_nsec;
+#else
+	return (uint64_t) st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+}
+
+/*
+ * Lua helper used by lua_fingerprint. Concatenates the bytecode of a function
+ * with its upvalues, recursing into upvalues which are functions. Returns nil
+ * if an upvalue can't be compared by value, e.g. a table
+ */
+#define LUA_FINGERPRINT_CODE \
+	"local function fingerprint(f, seen)\n" \
+	"	local ok, code = pcall(string.dump, f)\n" \
+	"	if not ok then return nil end\n" \
+	"	local parts = { code }\n" \
+	"	local i = 1\n" \
+	"	while true do\n" \
+	"		local name, v = debug.getupvalue(f, i)\n" \
+	"		if not name then break end\n" \
+	"		local t = type(v)\n" \
+	"		if t == 'function' then\n" \
+	"			if not seen[v] then\n" \
+	"				seen[v] = true\n" \
+	"				local sub = fingerprint(v, seen)\n" \
+	"				if not sub then return nil end\n" \
+	"				parts[#parts + 1] = sub\n" \
+	"			end\n" \
+	"		elseif t == 'number' then\n" \
+	"			parts[#parts + 1] = string.format('%.17g', v)\n" \
+	"		elseif t == 'string' or t == 'boolean' or t == 'nil' then\n" \
+	"			parts[#parts + 1] = t .. tostring(v)\n" \
+	"		else\n" \
+	"			return nil\n" \
+	"		end\n" \
+	"		i = i + 1\n" \
+	"	end\n" \
+	"	return table.concat(parts, '\\0')\n" \
+	"end\n" \
+	"return function(f) return fingerprint(f, { [f] = true }) end\n"
+
+/*
+ * lua_fingerprint: hashes the bytecode and upvalues of the Lua function at
+ *		index. Two functions with the same fingerprint behave the same way as
+ *		long as the globals they use are the same. The helper function is
+ *		compiled once per Lua state and kept in the registry
+ *
+ *		returns: the fingerprint, or 0 if the function has upvalues which
+ *			can't be compared or is a C function
+ */
+uint64_t lua_fingerprint(lua_State *L, int index)
+{
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
+	}
+
+	lua_getfield(L, LUA_REGISTRYINDEX, "lejit_fingerprint");
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		if (luaL_loadstring(L, LUA_FINGERPRINT_CODE) || lua_pcall(L, 0, 1, 0)) {
+			lua_error(L, "error creating fingerprint function: %s\n", lua_tostring(L, -1));
+		}
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, "lejit_fingerprint");
+	}
+
+	lua_pushvalue(L, index);
+	if (lua_pcall(L, 1, 1, 0) != 0 || !lua_isstring(L, -1)) {
+		lua_pop(L, 1);
+		return 0;
+	}
+
+	size_t len;
+	const char *str = lua_tolstring(L, -1, &len);
+	uint64_t hash = lua_hashstring(std::string(str, len));
+	lua_pop(L, 1);
+
+	return hash ? hash : 1;
+}
+
+/*
+ * Lua helper used by lua_isstub. Compares the bytecode of a function with
+ * that of an empty one using jit.util, and always returns false if jit.util
+ * isn't available
+ */
+#define LUA_ISEMPTY_CODE \
+	"local ok, util = pcall(require, 'jit.util')\n" \
+	"if not ok then return function(f) return false end end\n" \
+	"local empty = function() end\n" \
+	"local size, ret = util.funcinfo(empty).bytecodes, util.funcbc(empty, 1)\n" \
+	"return function(f)\n" \
+	"	return util.funcinfo(f).bytecodes == size and util.funcbc(f, 1) == ret\n" \
+	"end\n"
+
+/*
+ * lua_isstub: checks if the function at index is still the stub definition
+ *		writeConfigFile wrote for a function parameter. Its bytecode must be
+ *		that of an empty function, and the lines it is defined on must hold
+ *		LEJIT_STUB_COMMENT, so empty functions written by the user aren't
+ *		mistaken for stubs. The helper function is compiled once per Lua
+ *		state and kept in the registry
+ */
+bool lua_isstub(lua_State *L, int index)
+{
+	if (index < 0) {
+		index = lua_gettop(L) + index + 1;
+	}
+	if (!lua_isfunction(L, index) || lua_iscfunction(L, index)) {
+		return false;
+	}
+
+	lua_getfield(L, LUA_REGISTRYINDEX, "lejit_isempty");
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		if (luaL_loadstring(L, LUA_ISEMPTY_CODE) || lua_pcall(L, 0, 1, 0)) {
+			lua_error(L, "error creating stub check function: %s\n", lua_tostring(L, -1));
+		}
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, "lejit_isempty");
+	}
+
+	lua_pushvalue(L, index);
+	bool empty = (lua_pcall(L, 1, 1, 0) == 0 && lua_toboolean(L, -1));
+	lua_pop(L, 1);
+	if (!empty) {
+		return false;
+	}
+
+	lua_Debug ar;
+	lua_pushvalue(L, index);
+	lua_getinfo(L, ">S", &ar);
+
+	std::ifstream file;
+	if (ar.source[0] == '@' && ar.linedefined > 0) {
+		file.open(ar.source + 1);
+	}
+
+	std::string line;
+	for (int n = 1; n <= ar.lastlinedefined && std::getline(file, line); n++) {
+		if (n >= ar.linedefined && line.find(LEJIT_STUB_COMMENT) != std::string::npos) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * lua_loadfilecached: loads a Lua file as a function on top of the stack,
+ *		like luaL_loadfile. The bytecode is cached in cache_dir under a hash
+ *		of the file contents, the LuaJIT version and the file's name and
+ *		absolute path, so the source is only parsed the first time given
+ *		contents are loaded from a file. The name is part of the key because
+ *		the bytecode records it as the chunkname, which the native tier and
+ *		stub detection read the source back from. Bytecode which fails
+ *		to load is treated as a cache miss and replaced. Failing to write the
+ *		cache is not an error.
+ *
+ *		hit: set to true if the bytecode was loaded from the cache
+ *		bytecode: set to the bytecode of the loaded chunk
+ *		returns: 0 on success, or a luaL_loadfile error code with the error
+ *			message on top of the stack
+ */
+int lua_loadfilecached(lua_State *L, std::string filename, std::string cache_dir, bool &hit, std::string &bytecode)
+{
+	hit = false;
+
+	// Fall back to luaL_loadfile for its error message if the file can't be read
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		return luaL_loadfile(L, filename.c_str());
+	}
+	std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	// Key includes the LuaJIT version, since bytecode is not portable between
+	// versions, and the chunkname and absolute path, since identical files
+	// elsewhere must not get bytecode pointing back at this one
+	std::string chunkname = "@" + filename;
+	uint64_t hash = lua_hashstring(source);
+#ifdef LUAJIT_VERSION
+	hash = lua_hashstring(LUAJIT_VERSION, hash);
+#endif
+	hash = lua_hashstring(chunkname, hash);
+	char *path = realpath(filename.c_str(), nullptr);
+	if (path) {
+		hash = lua_hashstring(std::string(path), hash);
+		free(path);
+	}
+	char key[32];
+	snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+	std::string cache_file = cache_dir + "/" + key + ".ljbc";
+
+	// Try the cache
+	std::ifstream cached(cache_file, std::ios::binary);
+	if (cached) {
+		bytecode.assign((std::istreambuf_iterator<char>(cached)), std::istreambuf_iterator<char>());
+		cached.close();
+
+		if (luaL_loadbuffer(L, bytecode.data(), bytecode.size(), chunkname.c_str()) == 0) {
+			hit = true;
+			return 0;
+		}
+		lua_pop(L, 1);
+	}
+
+	// Parse the source and store its bytecode
+	int status = luaL_loadbuffer(L, source.data(), source.size(), chunkname.c_str());
+	if (status) {
+		return status;
+	}
+	bytecode = lua_dumptop(L);
+
+	mkdir(cache_dir.c_str(), 0755);
+	std::string tmp_file = cache_file + ".tmp" + std::to_string((long) getpid());
+	std::ofstream out(tmp_file, std::ios::binary);
+	if (out) {
+		out.write(bytecode.data(), bytecode.size());
+		out.close();
+
+		// Rename is atomic, so readers never see a partially written file
+		if (!out || rename(tmp_file.c_str(), cache_file.c_str()) != 0) {
+			remove(tmp_file.c_str());
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * LuaStats record: adds one call to the counters. Does nothing if statistics
+ *		are disabled
+ */
+void LuaStats::record()
+{
+#ifndef LEJIT_NO_STATS
+	this->calls.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+/*
+ * LuaStats record: adds one timed call to the counters. Does nothing if
+ *		statistics are disabled
+ *
+ *		start: time the call started, before arguments were pushed
+ *		end: time the call returned, after results were fetched
+ */
+void LuaStats::record(uint64_t start, uint64_t end)
+{
+#ifndef LEJIT_NO_STATS
+	uint64_t total = end - start;
+
+	this->calls.fetch_add(1, std::memory_order_relaxed);
+	this->timed_calls.fetch_add(1, std::memory_order_relaxed);
+	this->total_ns.fetch_add(total, std::memory_order_relaxed);
+
+	uint64_t max = this->max_ns.load(std::memory_order_relaxed);
+	while (total > max && !this->max_ns.compare_exchange_weak(max, total, std::memory_order_relaxed));
+#endif
+}
+
+/*
+ * LuaStats recordError: counts a Lua error raised by the function
+ */
+void LuaStats::recordError()
+{
+#ifndef LEJIT_NO_STATS
+	this->errors.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+/*
+ * LuaStats recordMemo: counts a hit or a miss in the result cache of a pure
+ *		function
+ */
+void LuaStats::recordMemo(bool hit)
+{
+#ifndef LEJIT_NO_STATS
+	(hit ? this->memo_hits : this->memo_misses).fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+/*
+ * LuaStats get: reads the current values of all counters
+ */
+LuaStatsValues LuaStats::get() const
+{
+	LuaStatsValues values;
+	values.calls = this->calls.load();
+	values.errors = this->errors.load();
+	values.timed_calls = this->timed_calls.load();
+	values.total_ns = this->total_ns.load();
+	values.max_ns = this->max_ns.load();
+	values.memo_hits = this->memo_hits.load();
+	values.memo_misses = this->memo_misses.load();
+	return values;
+}
+
+/*
+ * LuaStats clear: sets all counters back to 0. Timing stays on or off
+ */
+void LuaStats::clear()
+{
+	this->calls = 0;
+	this->errors = 0;
+	this->timed_calls = 0;
+	this->total_ns = 0;
+	this->max_ns = 0;
+	this->memo_hits = 0;
+	this->memo_misses = 0;
+}
+
+/*
+ * LuaFunc constructor: parses the signature string and checks it against
+ *		the C++ argument types
+ *
+ *		name: name of the function, used for error messages
+ *		func: registry reference to the Lua function
+ *		signature: see lua_callfunc
+ *		stats: statistics to record each call in, or null
+ */
+template <typename ...args> LuaFunc<args...>::LuaFunc(lua_State *L, std::string name, std::shared_ptr<LuaRef> func, std::string signature, std::shared_ptr<LuaStats> stats)
+{
+	this->L = L;
+	this->name = name;
+	this->stats = stats;
+	this->num_in = lua_parsesignature(L, signature, this->kinds, sizeof...(args));
+	this->num_out = sizeof...(args) - this->num_in;
+
+	// Arrays and outparams must be passed as pointers
+	bool is_pointer[] = { false, std::is_pointer<args>::value... };
+	for (size_t i = 0; i < sizeof...(args); i++) {
+		bool is_array = (this->kinds[i] == 'a' || this->kinds[i] == 'c');
+		bool is_in = (int) i < this->num_in;
+		if ((is_array || !is_in) && !is_pointer[i + 1]) {
+			lua_error(L, "argument %d of function '%s' must be a pointer\n", (int) i, name.c_str());
+		}
+		if (!is_array && is_in && is_pointer[i + 1]) {
+			lua_error(L, "argument %d of function '%s' must be an array\n", (int) i, name.c_str());
+		}
+	}
+
+	this->func = func;
+
+	// Wrap function if any arguments are passed as cdata
+	const char *ctypes[] = { "", lua_ctypename((args) 0)... };
+	for (int i = 0; i < this->num_in; i++) {
+		if (this->kinds[i] == 'c') {
+			func->push();
+			lua_wrapcdata(L, this->kinds, ctypes + 1, this->num_in);
+			this->func = std::make_shared<LuaRef>(func->getOwner());
+			break;
+		}
+	}
+}
+
+/*
+ * call: pushes inparams, calls the Lua function and fetches outparams
+ */
+template <typename ...args> template <int ...Is> void LuaFunc<args...>::call(int_sequence<Is...>, args... a) const
+{
+	// The clock is only read if timing is on
+	bool timed = this->stats && this->stats->isTiming();
+	uint64_t start = timed ? LuaStats::now() : 0;
+
+	this->func->push();
+
+	// Make sure there's enough stack space
+	luaL_checkstack(this->L, sizeof...(args), "not enough Lua stack space to hold arguments\n");
+
+	// Push inparams in order
+	int pushed[] = { 0, ((Is < this->num_in) ? (lua_pushargument(this->L, a, this->kinds[Is]), 0) : 0)... };
+	(void) pushed;
+
+	// Call the function
+	if (lua_pcall(this->L, this->num_in, this->num_out, 0) != 0) {
+		if (this->stats) this->stats->recordError();
+		lua_error(this->L, "error calling function '%s': %s\n", this->name.c_str(), lua_tostring(this->L, -1));
+	}
+
+	// Fetch outparams, starting at bottom of stack
+	int fetched[] = { 0, ((Is >= this->num_in) ? (lua_getresult(this->L, Is - this->num_in - this->num_out, a, this->kinds[Is]), 0) : 0)... };
+	(void) fetched;
+
+	lua_pop(this->L, this->num_out);
+
+	if (timed) {
+		this->stats->record(start, LuaStats::now());
+	}
+	else if (this->stats) {
+		this->stats->record();
+	}
+}
+
+/*
+ * LuaBatchFunc constructor: parses the signature string and wraps the Lua
+ *		function in a batch driver
+ *
+ *		name: name of the function, used for error messages
+ *		func: registry reference to the Lua function
+ *		signature: see lua_callfunc. May only contain scalar arguments
+ *		stats: statistics to record each batch in, or null
+ */
+template <typename ...args> LuaBatchFunc<args...>::LuaBatchFunc(lua_State *L, std::string name, std::shared_ptr<LuaRef> func, std::string signature, std::shared_ptr<LuaStats> stats)
+{
+	this->L = L;
+	this->name = name;
+	this->stats = stats;
+
+	char kinds[sizeof...(args) + 1];
+	int num_in = lua_parsesignature(L, signature, kinds, sizeof...(args));
+
+	func->push();
+	lua_wrapbatch(L, kinds, num_in, sizeof...(args));
+	this->func = std::make_shared<LuaRef>(func->getOwner());
+}
+
+/*
+ * operator(): calls the batch driver once with pointers to the argument and
+ *		result arrays
+ *
+ *		n: number of elements in each array
+ */
+template <typename ...args> void LuaBatchFunc<args...>::operator()(int n, typename lua_batcharg<args>::type... a) const
+{
+	// The clock is only read if timing is on
+	bool timed = this->stats && this->stats->isTiming();
+	uint64_t start = timed ? LuaStats::now() : 0;
+
+	this->func->push();
+
+	// Make sure there's enough stack space
+	luaL_checkstack(this->L, sizeof...(args) + 1, "not enough Lua stack space to hold arguments\n");
+
+	lua_pushinteger(this->L, n);
+	int pushed[] = { 0, (lua_pushlightuserdata(this->L, (void *) a), 0)... };
+	(void) pushed;
+
+	if (lua_pcall(this->L, sizeof...(args) + 1, 0, 0) != 0) {
+		if (this->stats) this->stats->recordError();
+		lua_error(this->L, "error calling function '%s': %s\n", this->name.c_str(), lua_tostring(this->L, -1));
+	}
+
+	if (timed) {
+		this->stats->record(start, LuaStats::now());
+	}
+	else if (this->stats) {
+		this->stats->record();
+	}
+}
+
+/*
+ * LuaThreadState constructor: creates a Lua state with the same libraries
+ *		as the one owned by LEJITReader
+ */
+LuaThreadState::LuaThreadState()
+{
+	this->owner = lua_newshared();
+	this->L = this->owner.get();
+	luaL_openlibs(this->L);
+	lua_openarray(this->L);
+	lua_openlejit(this->L);
+	this->version = 0;
+}
+
+/*
+ * LuaThreadState destructor: releases bound functions, and with them the
+ *		last owners of the state, closing it
+ */
+LuaThreadState::~LuaThreadState()
+{
+	this->funcs.clear();
+	this->owner.reset();
+}
+
+/*
+ * LuaStateCache: per thread map from pool id to the state the thread uses.
+ *		Gives the states back to their pools when the thread exits
+ */
+struct LuaStateCache {
+	std::vector<std::pair<std::weak_ptr<LuaStatePool>, LuaThreadState*>> entries;
+
+	~LuaStateCache()
+	{
+		for (auto &ent : this->entries) {
+			std::shared_ptr<LuaStatePool> pool = ent.first.lock();
+			if (pool && ent.second) {
+				pool->release(ent.second);
+			}
+		}
+	}
+};
+
+/*
+ * LuaStatePool constructor
+ */
+LuaStatePool::LuaStatePool() : version(0)
+{
+	static std::atomic<size_t> next_id(0);
+	this->id = next_id++;
+	this->num_slots = 0;
+}
+
+/*
+ * setBytecode: replaces the config file bytecode loaded into each state.
+ *		Must not be called while another thread is calling functions
+ */
+void LuaStatePool::setBytecode(std::string chunkname, std::string bytecode)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->chunkname = chunkname;
+	this->bytecode = bytecode;
+	this->version++;
+}
+
+/*
+ * newSlots: reserves n consecutive function slots in every state
+ */
+int LuaStatePool::newSlots(int n)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	int first = this->num_slots;
+	this->num_slots += n;
+	return first;
+}
+
+/*
+ * local: gets the state of the calling thread, taking one from the pool the
+ *		first time the thread asks. Reloads the state if the bytecode has been
+ *		replaced since it was last used
+ */
+LuaThreadState * LuaStatePool::local()
+{
+	static thread_local LuaStateCache cache;
+
+	if (this->id >= cache.entries.size()) {
+		cache.entries.resize(this->id + 1);
+	}
+
+	auto &ent = cache.entries[this->id];
+	if (!ent.second) {
+		ent.first = this->shared_from_this();
+		ent.second = this->acquire();
+	}
+
+	if (ent.second->version != this->version.load()) {
+		this->load(ent.second);
+	}
+
+	return ent.second;
+}
+
+/*
+ * acquire: takes a state off the free list, or creates a new one
+ */
+LuaThreadState * LuaStatePool::acquire()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (!this->free_states.empty()) {
+		LuaThreadState *state = this->free_states.back();
+		this->free_states.pop_back();
+		return state;
+	}
+
+	this->states.emplace_back(new LuaThreadState());
+	return this->states.back().get();
+}
+
+/*
+ * load: runs the config file bytecode in a state. Functions bound from the
+ *		previous version are dropped and rebound on their next call
+ */
+void LuaStatePool::load(LuaThreadState *state)
+{
+	std::string chunkname, bytecode;
+	unsigned long version;
+	int num_slots;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		chunkname = this->chunkname;
+		bytecode = this->bytecode;
+		version = this->version.load();
+		num_slots = this->num_slots;
+	}
+
+	state->funcs.clear();
+	state->funcs.resize(num_slots);
+
+	if (luaL_loadbuffer(state->L, bytecode.data(), bytecode.size(), chunkname.c_str()) || lua_pcall(state->L, 0, 0, 0)) {
+		lua_error(state->L, "error in config file: %s\n", lua_tostring(state->L, -1));
+	}
+
+	state->version = version;
+}
+
+/*
+ * release: puts a state back on the free list so another thread can use it
+ */
+void LuaStatePool::release(LuaThreadState *state)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->free_states.push_back(state);
+}
+
+/*
+ * size: number of states created so far, one per thread that has called
+ *		a function at the same time as the others
+ */
+size_t LuaStatePool::size()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->states.size();
+}
+
+/*
+ * local: gets the function bound in the calling thread's state, binding it
+ *		the first time it is called from that state
+ */
+template <typename F> const F & LuaThreadFunc<F>::local() const
+{
+	LuaThreadState *state = this->pool->local();
+
+	if (this->slot >= (int) state->funcs.size()) {
+		state->funcs.resize(this->slot + 1);
+	}
+
+	std::shared_ptr<void> &func = state->funcs[this->slot];
+	if (!func) {
+		lua_getglobal(state->L, this->name.c_str());
+		if (!lua_isfunction(state->L, -1)) {
+			lua_error(state->L, "parameter '%s' is missing from config file or has the wrong type\n", this->name.c_str());
+		}
+		func = std::make_shared<F>(state->L, this->name, std::make_shared<LuaRef>(state->owner), this->signature, this->stats);
+	}
+
+	return *static_cast<F*>(func.get());
+}
+
+/*
+ * LuaEpochSlot: per thread pointer to the thread's epoch slot. Frees the
+ *		slot for reuse when the thread exits
+ */
+struct LuaEpochSlot {
+	std::atomic<bool> *in_use = nullptr;
+	void *slot = nullptr;
+
+	~LuaEpochSlot()
+	{
+		if (this->in_use) {
+			this->in_use->store(false);
+		}
+	}
+};
+
+/*
+ * get: gets the process wide epoch. Never destroyed, so slots outlive the
+ *		threads and static objects using them
+ */
+LuaEpoch & LuaEpoch::get()
+{
+	static LuaEpoch *epoch = new LuaEpoch();
+	return *epoch;
+}
+
+/*
+ * slot: gets the slot of the calling thread, taking a free one or creating
+ *		one the first time the thread pins
+ */
+LuaEpoch::Slot * LuaEpoch::slot()
+{
+	static thread_local LuaEpochSlot local;
+
+	if (!local.slot) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		Slot *found = nullptr;
+		for (auto &s : this->slots) {
+			bool expected = false;
+			if (s->in_use.compare_exchange_strong(expected, true)) {
+				found = s.get();
+				break;
+			}
+		}
+
+		if (!found) {
+			this->slots.emplace_back(new Slot());
+			found = this->slots.back().get();
+			found->pinned.store(0);
+			found->in_use.store(true);
+		}
+
+		found->depth = 0;
+		local.slot = found;
+		local.in_use = &found->in_use;
+	}
+
+	return static_cast<Slot*>(local.slot);
+}
+
+/*
+ * pin: pins the calling thread to the current epoch and returns its slot.
+ *		Nested calls stay pinned to the epoch of the outermost one
+ */
+LuaEpoch::Slot * LuaEpoch::pin()
+{
+	Slot *s = this->slot();
+	if (s->depth++ == 0) {
+		// The fence makes the pin visible to oldestPinned before the caller
+		// loads the version it calls
+		s->pinned.store(this->epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	return s;
+}
+
+/*
+ * unpin: ends the outermost call of the thread owning slot s. The release
+ *		store keeps the call's loads of the version before it
+ */
+void LuaEpoch::unpin(Slot *s)
+{
+	if (--s->depth == 0) {
+		s->pinned.store(0, std::memory_order_release);
+	}
+}
+
+/*
+ * advance: moves to a new epoch. Threads which load a version after this
+ *		pin the new epoch, so anything replaced before it can be freed once
+ *		oldestPinned reaches it
+ */
+uint64_t LuaEpoch::advance()
+{
+	return this->epoch.fetch_add(1) + 1;
+}
+
+/*
+ * oldestPinned: gets the earliest epoch a thread is pinned to, or the
+ *		largest epoch if no thread is calling a function
+ */
+uint64_t LuaEpoch::oldestPinned()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	uint64_t oldest = std::numeric_limits<uint64_t>::max();
+	for (auto &s : this->slots) {
+		uint64_t pinned = s->pinned.load();
+		if (pinned && pinned < oldest) {
+			oldest = pinned;
+		}
+	}
+	return oldest;
+}
+
+/*
+ * LuaVersioned destructor: frees every version. No thread may still be
+ *		calling the function
+ */
+template <typename F> LuaVersioned<F>::~LuaVersioned()
+{
+	delete this->current.load();
+	for (auto &ent : this->retired) {
+		delete ent.first;
+	}
+}
+
+/*
+ * publish: makes func the version new calls use. The replaced version is
+ *		retired and freed once the calls using it have returned
+ */
+template <typename F> void LuaVersioned<F>::publish(F func)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	Version *old = this->current.load();
+	this->current.store(new Version { func, old->number + 1 });
+
+	this->retired.emplace_back(old, LuaEpoch::get().advance());
+	this->reclaim();
+}
+
+/*
+ * get: copies the current version out while pinned, so it can't be freed
+ *		during the copy
+ */
+template <typename F> F LuaVersioned<F>::get() const
+{
+	LuaEpochGuard guard;
+	return this->current.load()->func;
+}
+
+/*
+ * reclaim: frees the retired versions which were replaced before the
+ *		earliest epoch any thread is pinned to. Called with mutex held
+ */
+template <typename F> void LuaVersioned<F>::reclaim()
+{
+	uint64_t oldest = LuaEpoch::get().oldestPinned();
+
+	auto keep = this->retired.begin();
+	for (auto &ent : this->retired) {
+		if (ent.second <= oldest) {
+			delete ent.first;
+		}
+		else {
+			*keep++ = ent;
+		}
+	}
+	this->retired.erase(keep, this->retired.end());
+}
+
+/*
+ * lejit_array: implementation of lejit.array(path). Returns a table holding
+ *		the path, marked as a sidecar reference by its metatable
+ */
+static int lejit_array(lua_State *L)
+{
+	const char *path = luaL_checkstring(L, 1);
+
+	lua_newtable(L);
+	lua_pushstring(L, path);
+	lua_setfield(L, -2, "path");
+	luaL_getmetatable(L, LEJIT_ARRAY_META);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+/*
+ * LuaMemo constructor: allocates entries rounded up to a power of 2, all
+ *		empty. Generation 0 is never current, so zeroed entries never match
+ */
+LuaMemo::LuaMemo(size_t entries, size_t num_in, size_t num_out) : num_in(num_in), num_out(num_out), gen(1)
+{
+	this->entries = 1;
+	while (this->entries < entries) {
+		this->entries *= 2;
+	}
+
+	this->stride = 2 + num_in + num_out;
+	this->words.reset(new std::atomic<uint64_t>[this->entries * this->stride]);
+	for (size_t i = 0; i < this->entries * this->stride; i++) {
+		this->words[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+/*
+ * lua_memohash: mixes the argument words into an entry index
+ */
+inline size_t lua_memohash(const uint64_t *in, size_t num_in, size_t entries)
+{
+	uint64_t hash = 0x9e3779b97f4a7c15ULL;
+	for (size_t i = 0; i < num_in; i++) {
+		hash ^= in[i];
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+	}
+	return hash & (entries - 1);
+}
+
+/*
+ * LuaMemo lookup: reads the entry the arguments map to between two reads of
+ *		its sequence number. The entry was consistent if the sequence number
+ *		was even and didn't change
+ */
+bool LuaMemo::lookup(const uint64_t *in, uint64_t *out, uint64_t generation) const
+{
+	const std::atomic<uint64_t> *entry = &this->words[lua_memohash(in, this->num_in, this->entries) * this->stride];
+
+	uint64_t seq = entry[0].load(std::memory_order_acquire);
+	if (seq & 1) {
+		return false;
+	}
+
+	bool match = entry[1].load(std::memory_order_relaxed) == generation;
+	for (size_t i = 0; i < this->num_in; i++) {
+		match = match && entry[2 + i].load(std::memory_order_relaxed) == in[i];
+	}
+	for (size_t i = 0; i < this->num_out; i++) {
+		out[i] = entry[2 + this->num_in + i].load(std::memory_order_relaxed);
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return match && entry[0].load(std::memory_order_relaxed) == seq;
+}
+
+/*
+ * LuaMemo store: makes the sequence number odd while writing the entry. If
+ *		another thread is writing it, the results are not cached
+ */
+void LuaMemo::store(const uint64_t *in, const uint64_t *out, uint64_t generation)
+{
+	std::atomic<uint64_t> *entry = &this->words[lua_memohash(in, this->num_in, this->entries) * this->stride];
+
+	uint64_t seq = entry[0].load(std::memory_order_relaxed);
+	if ((seq & 1) || !entry[0].compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) {
+		return;
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+
+	entry[1].store(generation, std::memory_order_relaxed);
+	for (size_t i = 0; i < this->num_in; i++) {
+		entry[2 + i].store(in[i], std::memory_order_relaxed);
+	}
+	for (size_t i = 0; i < this->num_out; i++) {
+		entry[2 + this->num_in + i].store(out[i], std::memory_order_relaxed);
+	}
+
+	entry[0].store(seq + 2, std::memory_order_release);
+}
+
+/*
+ * LuaMemoFunc constructor: creates a cache of entries entries, with one word
+ *		per inparam and per outparam
+ */
+template <typename ...args> LuaMemoFunc<args...>::LuaMemoFunc(std::function<void(args...)> func, size_t entries, std::shared_ptr<LuaStats> stats) : func(func), stats(stats)
+{
+	size_t num_out = 0;
+	bool is_pointer[] = { false, std::is_pointer<args>::value... };
+	for (bool p : is_pointer) {
+		num_out += p;
+	}
+	this->memo = std::make_shared<LuaMemo>(entries, sizeof...(args) - num_out, num_out);
+}
+
+/*
+ * LuaMemoFunc operator(): returns the cached results for the inparams if
+ *		there are any, otherwise calls the function and caches its results
+ */
+template <typename ...args> void LuaMemoFunc<args...>::operator()(args... a) const
+{
+	// Zeroed, as functions without inparams never write to it
+	uint64_t in[sizeof...(args) + 1] = {}, out[sizeof...(args) + 1];
+	size_t n = 0;
+	int packed[] = { 0, (lua_memoinput(in, n, a), 0)... };
+	(void) packed;
+
+	uint64_t generation = this->memo->generation();
+	bool hit = this->memo->lookup(in, out, generation);
+	if (this->stats) this->stats->recordMemo(hit);
+
+	n = 0;
+	if (hit) {
+		int returned[] = { 0, (lua_memoreturn(a, out, n), 0)... };
+		(void) returned;
+		return;
+	}
+
+	this->func(a...);
+
+	int results[] = { 0, (lua_memoresult(out, n, a), 0)... };
+	(void) results;
+	this->memo->store(in, out, generation);
+}
+
+/*
+ * LuaInterpTable constructor: samples the function at n evenly spaced points
+ *		from lo to hi along each dimension. With a tolerance, the error of the
+ *		interpolation is measured halfway between neighbouring samples
+ */
+LuaInterpTable::LuaInterpTable(const LuaTableSpec &spec, std::function<double(double, double)> sample) : spec(spec), error(0)
+{
+	if (spec.rank == 1) {
+		this->spec.lo[1] = this->spec.hi[1] = 0;
+		this->spec.n[1] = 1;
+	}
+
+	size_t nx = this->spec.n[0], ny = this->spec.n[1];
+	double dx = (this->spec.hi[0] - this->spec.lo[0]) / (nx - 1);
+	double dy = (ny > 1) ? (this->spec.hi[1] - this->spec.lo[1]) / (ny - 1) : 0;
+	this->scale[0] = 1 / dx;
+	this->scale[1] = (ny > 1) ? 1 / dy : 0;
+
+	this->values.resize(nx * ny);
+	for (size_t i = 0; i < nx; i++) {
+		for (size_t j = 0; j < ny; j++) {
+			this->values[i * ny + j] = sample(this->spec.lo[0] + i * dx, this->spec.lo[1] + j * dy);
+		}
+	}
+
+	if (spec.tolerance > 0) {
+		for (size_t i = 0; i + 1 < nx; i++) {
+			double x = this->spec.lo[0] + (i + 0.5) * dx;
+			if (spec.rank == 1) {
+				this->error = std::max(this->error, std::fabs(sample(x, 0) - (*this)(x)));
+				continue;
+			}
+			for (size_t j = 0; j + 1 < ny; j++) {
+				double y = this->spec.lo[1] + (j + 0.5) * dy;
+				this->error = std::max(this->error, std::fabs(sample(x, y) - (*this)(x, y)));
+			}
+		}
+	}
+}
+
+/*
+ * LuaInterpTable operator(): linear interpolation between the two samples
+ *		around x
+ */
+double LuaInterpTable::operator()(double x) const
+{
+	double t = std::min(std::max(0.0, (x - this->spec.lo[0]) * this->scale[0]), (double) (this->spec.n[0] - 1));
+	size_t i = std::min((size_t) t, this->spec.n[0] - 2);
+	double f = t - i;
+	return this->values[i] + f * (this->values[i + 1] - this->values[i]);
+}
+
+/*
+ * LuaInterpTable operator(): bilinear interpolation between the four samples
+ *		around (x, y)
+ */
+double LuaInterpTable::operator()(double x, double y) const
+{
+	size_t ny = this->spec.n[1];
+	double tx = std::min(std::max(0.0, (x - this->spec.lo[0]) * this->scale[0]), (double) (this->spec.n[0] - 1));
+	double ty = std::min(std::max(0.0, (y - this->spec.lo[1]) * this->scale[1]), (double) (ny - 1));
+	size_t i = std::min((size_t) tx, this->spec.n[0] - 2);
+	size_t j = std::min((size_t) ty, ny - 2);
+	double fx = tx - i, fy = ty - j;
+
+	const double *v = &this->values[i * ny + j];
+	double low = v[0] + fy * (v[1] - v[0]);
+	double high = v[ny] + fy * (v[ny + 1] - v[ny]);
+	return low + fx * (high - low);
+}
+
+/*
+ * LuaInterpTable eval: interpolates at count points. The loop bodies have no
+ *		branches or calls, index the samples with ints and the samples can't
+ *		alias out, so they vectorize with gathers. NaN points clamp to the
+ *		first sample
+ */
+void LuaInterpTable::eval(int count, const double *x, double *out) const
+{
+	const double * __restrict v = this->values.data();
+	double lo = this->spec.lo[0], scale = this->scale[0];
+	double last = (double) (this->spec.n[0] - 1);
+	double cell = (double) (this->spec.n[0] - 2);
+
+	for (int k = 0; k < count; k++) {
+		double t = (x[k] - lo) * scale;
+		t = t > 0 ? t : 0;
+		t = t < last ? t : last;
+		int i = (int) t;
+		i = i < cell ? i : (int) cell;
+		out[k] = v[i] + (t - i) * (v[i + 1] - v[i]);
+	}
+}
+
+void LuaInterpTable::eval(int count, const double *x, const double *y, double *out) const
+{
+	const double * __restrict v = this->values.data();
+	int ny = (int) this->spec.n[1];
+	double lox = this->spec.lo[0], scalex = this->scale[0];
+	double loy = this->spec.lo[1], scaley = this->scale[1];
+	double lastx = (double) (this->spec.n[0] - 1), cellx = (double) (this->spec.n[0] - 2);
+	double lasty = (double) (ny - 1), celly = (double) (ny - 2);
+
+	for (int k = 0; k < count; k++) {
+		double tx = (x[k] - lox) * scalex;
+		double ty = (y[k] - loy) * scaley;
+		tx = tx > 0 ? tx : 0;
+		ty = ty > 0 ? ty : 0;
+		tx = tx < lastx ? tx : lastx;
+		ty = ty < lasty ? ty : lasty;
+		int i = (int) tx, j = (int) ty;
+		i = i < cellx ? i : (int) cellx;
+		j = j < celly ? j : (int) celly;
+
+		int p = i * ny + j;
+		double fx = tx - i, fy = ty - j;
+		double low = v[p] + fy * (v[p + 1] - v[p]);
+		double high = v[p + ny] + fy * (v[p + ny + 1] - v[p + ny]);
+		out[k] = low + fx * (high - low);
+	}
+}
+
+/*
+ * lua_tabulate: version for d>d functions
+ */
+bool lua_tabulate(const std::function<void(double, double*)> &func, const LuaTableSpec &spec, std::function<void(double, double*)> &call, std::function<void(int, double*, double*)> &batch, double &error)
+{
+	if (spec.rank != 1) {
+		return false;
+	}
+
+	std::shared_ptr<LuaInterpTable> table = std::make_shared<LuaInterpTable>(spec, [&func](double x, double y) { double r; func(x, &r); return r; });
+	error = table->getError();
+	if (spec.tolerance > 0 && error > spec.tolerance) {
+		return false;
+	}
+
+	std::function<void(double, double*)> lua = func;
+	call = [table, lua](double x, double *r) {
+		if (table->contains(x)) {
+			*r = (*table)(x);
+		}
+		else {
+			lua(x, r);
+		}
+	};
+
+	batch = [table, lua](int n, double *x, double *r) {
+		table->eval(n, x, r);
+		for (int k = 0; k < n; k++) {
+			if (!table->contains(x[k])) {
+				lua(x[k], &r[k]);
+			}
+		}
+	};
+	return true;
+}
+
+/*
+ * lua_tabulate: version for dd>d functions
+ */
+bool lua_tabulate(const std::function<void(double, double, double*)> &func, const LuaTableSpec &spec, std::function<void(double, double, double*)> &call, std::function<void(int, double*, double*, double*)> &batch, double &error)
+{
+	if (spec.rank != 2) {
+		return false;
+	}
+
+	std::shared_ptr<LuaInterpTable> table = std::make_shared<LuaInterpTable>(spec, [&func](double x, double y) { double r; func(x, y, &r); return r; });
+	error = table->getError();
+	if (spec.tolerance > 0 && error > spec.tolerance) {
+		return false;
+	}
+
+	std::function<void(double, double, double*)> lua = func;
+	call = [table, lua](double x, double y, double *r) {
+		if (table->contains(x, y)) {
+			*r = (*table)(x, y);
+		}
+		else {
+			lua(x, y, r);
+		}
+	};
+
+	batch = [table, lua](int n, double *x, double *y, double *r) {
+		table->eval(n, x, y, r);
+		for (int k = 0; k < n; k++) {
+			if (!table->contains(x[k], y[k])) {
+				lua(x[k], y[k], &r[k]);
+			}
+		}
+	};
+	return true;
+}
+
+/*
+ * lua_compilenative: translates the Lua function on top of the stack, which
+ *		must be defined in a file, to C with native_translate, then compiles
+ *		and loads it. Numbers the function reads from upvalues and globals are
+ *		compiled in with their current values
+ */
+void *lua_compilenative(lua_State *L, std::string signature, NativeCompiler &compiler, std::shared_ptr<void> &handle, std::string &error)
+{
+	int func = lua_gettop(L);
+	lua_Debug ar;
+	lua_pushvalue(L, func);
+	lua_getinfo(L, ">S", &ar);
+
+	void *native = nullptr;
+	std::ifstream file;
+	if (ar.source[0] == '@' && ar.linedefined > 0) {
+		file.open(ar.source + 1, std::ios::binary);
+	}
+	if (!file) {
+		error = "its source file can't be read";
+		lua_pop(L, 1);
+		return native;
+	}
+	std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	// Upvalues shadow globals of the same name
+	auto lookup = [L, func](const std::string &name, double &value) {
+		bool found = false;
+		const char *upvalue;
+		for (int n = 1; !found && (upvalue = lua_getupvalue(L, func, n)); n++) {
+			found = (name == upvalue);
+			if (!found) {
+				lua_pop(L, 1);
+			}
+		}
+		if (!found) {
+			lua_getglobal(L, name.c_str());
+		}
+
+		bool number = (lua_type(L, -1) == LUA_TNUMBER);
+		value = lua_tonumber(L, -1);
+		lua_pop(L, 1);
+		return number;
+	};
+
+	std::string code;
+	if (native_translate(source, ar.linedefined, signature, lookup, code, error)) {
+		native = compiler.load(code, handle, error);
+	}
+	lua_pop(L, 1);
+	return native;
+}
+
+/*
+ * lua_bindnative: binds call to the C function native, and batch to a loop
+ *		calling it for each element
+ */
+template <typename ...args> void lua_bindnative(void *native, std::shared_ptr<void> handle, std::function<void(args...)> &call, std::function<void(int, typename lua_batcharg<args>::type...)> &batch)
+{
+	void (*func)(args...) = reinterpret_cast<void (*)(args...)>(native);
+
+	call = [func, handle](args... a) { func(a...); };
+	batch = [func, handle](int n, typename lua_batcharg<args>::type... a) {
+		for (int i = 0; i < n; i++) {
+			func(lua_batchelem<args>::get(a, i)...);
+		}
+	};
+}
+
+/*
+ * lua_bindbatch: binds batch to a loop calling func for each element of the
+ *		argument arrays. Like LuaBatchFunc, only takes scalar arguments
+ */
+template <typename ...args> void lua_bindbatch(lua_State *L, std::string signature, const std::function<void(args...)> &func, std::function<void(int, typename lua_batcharg<args>::type...)> &batch)
+{
+	char kinds[sizeof...(args) + 1];
+	lua_parsesignature(L, signature, kinds, sizeof...(args));
+	for (size_t i = 0; i < sizeof...(args); i++) {
+		if (kinds[i] != 'i' && kinds[i] != 'd' && kinds[i] != 'b') {
+			lua_error(L, "only functions with scalar arguments can be batched\n");
+		}
+	}
+
+	batch = [func](int n, typename lua_batcharg<args>::type... a) {
+		for (int i = 0; i < n; i++) {
+			func(lua_batchelem<args>::get(a, i)...);
+		}
+	};
+}
+
+/*
+ * lua_appendliteral: versions for each allowed type. Doubles are written with
+ *		the fewest of 15, 16 or 17 significant digits which read back as the
+ *		same value, infinities as math.huge and NaN as 0/0. Bools are written
+ *		as numbers, which is how they are read
+ */
+void lua_appendliteral(std::string &out, int value)
+{
+	char buf[16];
+	out.append(buf, snprintf(buf, sizeof(buf), "%d", value));
+}
+
+void lua_appendliteral(std::string &out, double value)
+{
+	if (std::isnan(value)) {
+		out += "0/0";
+		return;
+	}
+	if (std::isinf(value)) {
+		out += value > 0 ? "math.huge" : "-math.huge";
+		return;
+	}
+
+	// Integral values in the exactly representable range don't need the
+	// search. Negative zero goes through it to keep its sign
+	char buf[32];
+	int len;
+	if (std::fabs(value) < 9007199254740992.0 && value == (double) (long long) value && (value != 0 || !std::signbit(value))) {
+		len = snprintf(buf, sizeof(buf), "%lld", (long long) value);
+	}
+	else {
+		len = snprintf(buf, sizeof(buf), "%.15g", value);
+		if (strtod(buf, nullptr) != value) {
+			len = snprintf(buf, sizeof(buf), "%.16g", value);
+			if (strtod(buf, nullptr) != value) {
+				len = snprintf(buf, sizeof(buf), "%.17g", value);
+			}
+		}
+	}
+	out.append(buf, len);
+}
+
+void lua_appendliteral(std::string &out, bool value)
+{
+	out += value ? '1' : '0';
+}
+
+void lua_appendliteral(std::string &out, const std::string &value)
+{
+	out += '"';
+	for (char c : value) {
+		switch (c) {
+			case '"' : out += "\\\""; break;
+			case '\\' : out += "\\\\"; break;
+			case '\n' : out += "\\n"; break;
+			case '\r' : out += "\\r"; break;
+			case '\0' : out += "\\0"; break;
+			default : out += c;
+		}
+	}
+	out += '"';
+}
+
+/*
+ * lua_appendliteral: version for other arithmetic types, written as doubles
+ *		if they are floating point
+ */
+template <typename T> void lua_appendliteral(std::string &out, T value)
+{
+	if (std::is_floating_point<T>::value) {
+		lua_appendliteral(out, (double) value);
+	}
+	else {
+		out += std::to_string(value);
+	}
+}
+
+/*
+ * lua_writeliteral: writes value as a Lua literal to out
+ */
+template <typename T> void lua_writeliteral(std::ostream &out, const T &value)
+{
+	std::string text;
+	lua_appendliteral(text, value);
+	out.write(text.data(), text.size());
+}
+
+/*
+ * lua_appendcppliteral: versions for the types C++ spells differently than
+ *		Lua. Infinities and NaN are written as constexpr numeric_limits
+ *		calls, so headers using them need <limits>
+ */
+void lua_appendcppliteral(std::string &out, double value)
+{
+	if (std::isnan(value)) {
+		out += "std::numeric_limits<double>::quiet_NaN()";
+	}
+	else if (std::isinf(value)) {
+		out += value > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+	}
+	else {
+		lua_appendliteral(out, value);
+	}
+}
+
+void lua_appendcppliteral(std::string &out, bool value)
+{
+	out += value ? "true" : "false";
+}
+
+/*
+ * lua_writetable: writes the nested Lua tables holding an array of the given
+ *		shape to out. Elements are formatted in chunks of LUA_WRITE_CHUNK,
+ *		spread over all hardware threads for large arrays, and the chunks
+ *		are written in order as each batch of them is done, so the whole
+ *		table is never held in memory. element must be safe to call from
+ *		several threads at once
+ *
+ *		cpp: write elements as C++ literals, for C++ array initializers
+ */
+template <typename F> void lua_writetable(std::ostream &out, const std::vector<size_t> &shape, F element, bool cpp)
+{
+	size_t count = nd_size(shape);
+	if (shape.empty() || count == 0) {
+		out << "{}";
+		return;
+	}
+
+	// Number of elements in one table at each depth, innermost last. Each
+	// one divides the ones before it, so tables only start or end at an
+	// element if the innermost one does
+	std::vector<size_t> spans(shape.size());
+	size_t span = 1;
+	for (size_t d = shape.size(); d-- > 0;) {
+		span *= shape[d];
+		spans[d] = span;
+	}
+
+	// Formats elements [begin, end) with the braces and separators around them
+	auto format = [&](std::string &text, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			for (size_t d = spans.size(); d-- > 0 && i % spans[d] == 0;) {
+				text += '{';
+			}
+			if (cpp) {
+				lua_appendcppliteral(text, element(i));
+			}
+			else {
+				lua_appendliteral(text, element(i));
+			}
+			for (size_t d = spans.size(); d-- > 0 && (i + 1) % spans[d] == 0;) {
+				text += '}';
+			}
+			if (i + 1 < count) {
+				text += ", ";
+			}
+		}
+	};
+
+	size_t chunks = (count + LUA_WRITE_CHUNK - 1) / LUA_WRITE_CHUNK;
+	int num_threads = chunks > 1 ? parallel_default_threads() : 1;
+	std::vector<std::string> texts(std::min(chunks, (size_t) num_threads * 4));
+
+	for (size_t first = 0; first < chunks; first += texts.size()) {
+		int batch = (int) std::min(texts.size(), chunks - first);
+		parallel_for(batch, 1, num_threads, [&](int thread, int begin, int end) {
+			for (int c = begin; c < end; c++) {
+				size_t start = (first + c) * LUA_WRITE_CHUNK;
+				texts[c].clear();
+				format(texts[c], start, std::min(start + LUA_WRITE_CHUNK, count));
+			}
+		});
+
+		for (int c = 0; c < batch; c++) {
+			out.write(texts[c].data(), texts[c].size());
+		}
+	}
+}
+
+/*
+ * lua_openlejit: creates the global lejit table. dir is kept in the registry
+ *		to resolve relative sidecar paths against
+ */
+int lua_openlejit(lua_State *L, std::string dir)
+{
+	luaL_newmetatable(L, LEJIT_ARRAY_META);
+	lua_pop(L, 1);
+
+	lua_pushstring(L, dir.c_str());
+	lua_setfield(L, LUA_REGISTRYINDEX, "lejit_dir");
+
+	lua_newtable(L);
+	lua_pushcfunction(L, lejit_array);
+	lua_setfield(L, -2, "array");
+
+	// lejit.default is an empty table, only recognized by identity
+	lua_newtable(L);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, LUA_REGISTRYINDEX, "lejit_default");
+	lua_setfield(L, -2, "default");
+	lua_setglobal(L, "lejit");
+	return 0;
+}
+
+/*
+ * lua_isdefault: checks if the value at index is lejit.default
+ */
+bool lua_isdefault(lua_State *L, int index)
+{
+	if (!lua_istable(L, index)) {
+		return false;
+	}
+
+	lua_getfield(L, LUA_REGISTRYINDEX, "lejit_default");
+	bool ret = lua_rawequal(L, index < 0 ? index - 1 : index, -1);
+	lua_pop(L, 1);
+	return ret;
+}
+
+/*
+ * lua_isarrayfile: checks if the value at index was made by lejit.array
+ */
+bool lua_isarrayfile(lua_State *L, int index)
+{
+	if (!lua_istable(L, index) || !lua_getmetatable(L, index)) {
+		return false;
+	}
+
+	luaL_getmetatable(L, LEJIT_ARRAY_META);
+	bool ret = lua_rawequal(L, -1, -2);
+	lua_pop(L, 2);
+	return ret;
+}
+
+/*
+ * lua_toarrayfile: gets the path of the sidecar reference at index, relative
+ *		paths being resolved against the config file's directory
+ */
+std::string lua_toarrayfile(lua_State *L, int index)
+{
+	lua_getfield(L, index, "path");
+	if (!lua_isstring(L, -1)) {
+		lua_error(L, "lejit.array reference is missing its path\n");
+	}
+	std::string path = lua_tostring(L, -1);
+	lua_pop(L, 1);
+
+	if (!path.empty() && path[0] != '/') {
+		lua_getfield(L, LUA_REGISTRYINDEX, "lejit_dir");
+		if (lua_isstring(L, -1)) {
+			path = std::string(lua_tostring(L, -1)) + path;
+		}
+		lua_pop(L, 1);
+	}
+	return path;
+}
+
+/*
+ * lua_writearrayfile: writes a sidecar file to a temporary file and renames
+ *		it into place, so readers never see a partly written file
+ */
+bool lua_writearrayfile(std::string path, char type, const std::vector<size_t> &shape, const void *data, size_t elem_size)
+{
+	std::string tmp = path + ".tmp" + std::to_string(getpid());
+	std::ofstream file(tmp, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	uint32_t header[2] = { (uint32_t) type, (uint32_t) shape.size() };
+	size_t count = 1;
+	file.write(LEJIT_ARRAY_MAGIC, 8);
+	file.write(reinterpret_cast<const char *>(header), sizeof(header));
+	for (size_t extent : shape) {
+		uint64_t e = extent;
+		file.write(reinterpret_cast<const char *>(&e), sizeof(e));
+		count *= extent;
+	}
+	file.write(static_cast<const char *>(data), count * elem_size);
+	file.close();
+
+	if (!file || rename(tmp.c_str(), path.c_str()) != 0) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+template <typename T> bool lua_writearrayfile(std::string path, const NDArray<T> &arr)
+{
+	return lua_writearrayfile(path, lua_arraytypecode<T>(), arr.getShape(), arr.data(), sizeof(T));
+}
+
+/*
+ * LuaMappedArray constructor: maps a sidecar file and checks its header
+ *		against its size
+ */
+LuaMappedArray::LuaMappedArray(lua_State *L, std::string path) : path(path), base(MAP_FAILED), length(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		if (fd >= 0) close(fd);
+		lua_error(L, "unable to open array file '%s'\n", path.c_str());
+	}
+	this->mtime = st.st_mtime;
+	this->size = st.st_size;
+	this->ino = st.st_ino;
+	this->length = st.st_size;
+
+	if (this->length < 16) {
+		close(fd);
+		lua_error(L, "'%s' is not a LEJIT array file\n", path.c_str());
+	}
+
+	this->base = mmap(nullptr, this->length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (this->base == MAP_FAILED) {
+		lua_error(L, "unable to map array file '%s'\n", path.c_str());
+	}
+
+	const char *bytes = static_cast<const char *>(this->base);
+	const uint32_t *header = reinterpret_cast<const uint32_t *>(bytes + 8);
+	this->type = (char) header[0];
+	size_t rank = header[1];
+	size_t elem_size = (this->type == 'i') ? sizeof(int) : (this->type == 'd') ? sizeof(double) : 0;
+
+	if (memcmp(bytes, LEJIT_ARRAY_MAGIC, 8) != 0 || !elem_size || this->length < 16 + 8 * rank) {
+		lua_error(L, "'%s' is not a LEJIT array file\n", path.c_str());
+	}
+
+	const uint64_t *extents = reinterpret_cast<const uint64_t *>(bytes + 16);
+	size_t count = 1;
+	for (size_t d = 0; d < rank; d++) {
+		this->shape.push_back(extents[d]);
+		count *= extents[d];
+	}
+
+	this->elements = bytes + 16 + 8 * rank;
+	if (this->length < 16 + 8 * rank + count * elem_size) {
+		lua_error(L, "array file '%s' is shorter than its shape\n", path.c_str());
+	}
+}
+
+/*
+ * LuaMappedArray destructor: unmaps the file
+ */
+LuaMappedArray::~LuaMappedArray()
+{
+	if (this->base != MAP_FAILED) {
+		munmap(this->base, this->length);
+	}
+}
+
+/*
+ * isCurrent: checks if the file on disk still has the modification time,
+ *		size and inode it had when it was mapped
+ */
+bool LuaMappedArray::isCurrent() const
+{
+	struct stat st;
+	if (stat(this->path.c_str(), &st) != 0) {
+		return false;
+	}
+	return st.st_mtime == this->mtime && st.st_size == this->size && st.st_ino == this->ino;
+}
+
+/*
+ * lua_packvalue: version for arithmetic types, copied as they are
+ */
+template <typename T> void lua_packvalue(std::string &out, const T &value)
+{
+	static_assert(std::is_arithmetic<T>::value, "only arithmetic values, strings, vectors and NDArrays can be packed");
+	out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/*
+ * lua_packvalue: version for strings, written as their length then their
+ *		characters
+ */
+void lua_packvalue(std::string &out, const std::string &value)
+{
+	lua_packvalue(out, (uint64_t) value.size());
+	out += value;
+}
+
+/*
+ * lua_packelements: appends the elements of a vector to out, in one block if
+ *		they are contiguous arithmetic values
+ */
+template <typename T> void lua_packelements(std::string &out, const std::vector<T> &value, std::true_type)
+{
+	out.append(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(T));
+}
+
+template <typename T> void lua_packelements(std::string &out, const std::vector<T> &value, std::false_type)
+{
+	for (size_t i = 0; i < value.size(); i++) {
+		const T &element = value[i];
+		lua_packvalue(out, element);
+	}
+}
+
+// True for element types whose vectors can be copied in one block
+template <typename T> using lua_packcontiguous = std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>;
+
+/*
+ * lua_packvalue: version for vectors, written as their length then their
+ *		elements
+ */
+template <typename T> void lua_packvalue(std::string &out, const std::vector<T> &value)
+{
+	lua_packvalue(out, (uint64_t) value.size());
+	lua_packelements(out, value, lua_packcontiguous<T>());
+}
+
+/*
+ * lua_packvalue: version for flat arrays, written as their rank, their shape
+ *		and then their elements in one block
+ */
+template <typename T> void lua_packvalue(std::string &out, const NDArray<T> &value)
+{
+	static_assert(lua_packcontiguous<T>::value, "only NDArrays of arithmetic types can be packed");
+
+	lua_packvalue(out, (uint64_t) value.rank());
+	for (size_t extent : value.getShape()) {
+		lua_packvalue(out, (uint64_t) extent);
+	}
+	out.append(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(T));
+}
+
+/*
+ * lua_unpackvalue: version for arithmetic types
+ */
+template <typename T> bool lua_unpackvalue(const char *&data, const char *end, T &value)
+{
+	static_assert(std::is_arithmetic<T>::value, "only arithmetic values, strings, vectors and NDArrays can be unpacked");
+	if ((size_t) (end - data) < sizeof(T)) {
+		return false;
+	}
+	memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+/*
+ * lua_unpackvalue: version for strings
+ */
+bool lua_unpackvalue(const char *&data, const char *end, std::string &value)
+{
+	uint64_t size;
+	if (!lua_unpackvalue(data, end, size) || (uint64_t) (end - data) < size) {
+		return false;
+	}
+	value.assign(data, size);
+	data += size;
+	return true;
+}
+
+/*
+ * lua_unpackelements: reads the elements of a vector of known length, in one
+ *		block if they are contiguous arithmetic values
+ */
+template <typename T> bool lua_unpackelements(const char *&data, const char *end, std::vector<T> &value, std::true_type)
+{
+	size_t bytes = value.size() * sizeof(T);
+	if ((size_t) (end - data) < bytes) {
+		return false;
+	}
+	memcpy(value.data(), data, bytes);
+	data += bytes;
+	return true;
+}
+
+template <typename T> bool lua_unpackelements(const char *&data, const char *end, std::vector<T> &value, std::false_type)
+{
+	for (size_t i = 0; i < value.size(); i++) {
+		T element;
+		if (!lua_unpackvalue(data, end, element)) {
+			return false;
+		}
+		value[i] = std::move(element);
+	}
+	return true;
+}
+
+/*
+ * lua_unpackvalue: version for vectors. The length is checked against the
+ *		bytes left before anything is allocated
+ */
+template <typename T> bool lua_unpackvalue(const char *&data, const char *end, std::vector<T> &value)
+{
+	uint64_t size;
+	if (!lua_unpackvalue(data, end, size) || size > (uint64_t) (end - data)) {
+		return false;
+	}
+	value.resize(size);
+	return lua_unpackelements(data, end, value, lua_packcontiguous<T>());
+}
+
+/*
+ * lua_unpackvalue: version for flat arrays
+ */
+template <typename T> bool lua_unpackvalue(const char *&data, const char *end, NDArray<T> &value)
+{
+	static_assert(lua_packcontiguous<T>::value, "only NDArrays of arithmetic types can be unpacked");
+
+	uint64_t rank;
+	if (!lua_unpackvalue(data, end, rank) || rank > (uint64_t) (end - data) / sizeof(uint64_t)) {
+		return false;
+	}
+
+	std::vector<size_t> shape(rank);
+	uint64_t count = 1;
+	for (size_t d = 0; d < rank; d++) {
+		uint64_t extent;
+		if (!lua_unpackvalue(data, end, extent)) {
+			return false;
+		}
+		shape[d] = extent;
+		count *= extent;
+	}
+
+	if (count > (uint64_t) (end - data) / sizeof(T)) {
+		return false;
+	}
+	value = NDArray<T>(shape);
+	memcpy(value.data(), data, count * sizeof(T));
+	data += count * sizeof(T);
+	return true;
+}
+
+/*
+ * LuaSharedConfig constructor: creates the header object exclusively, making
+ *		this process the publisher, or opens the one another process created.
+ *		Objects are only readable and writable by their owner, and an
+ *		existing one is only opened if this user owns it
+ */
+LuaSharedConfig::LuaSharedConfig(std::string name) : name(name), owner(false), fd(-1), header(nullptr), data(nullptr), length(0)
+{
+	this->fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (this->fd >= 0) {
+		this->owner = true;
+		if (ftruncate(this->fd, sizeof(LuaSharedHeader)) == 0) {
+			void *base = mmap(nullptr, sizeof(LuaSharedHeader), PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+			if (base != MAP_FAILED) {
+				this->header = static_cast<LuaSharedHeader *>(base);
+				memcpy(this->header->magic, LEJIT_SHARED_MAGIC, 8);
+				this->header->pid.store(getpid(), std::memory_order_release);
+			}
+		}
+	}
+	else if (errno == EEXIST) {
+		// Objects someone else could have written are left alone
+		this->fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (this->fd >= 0 && !LuaSharedConfig::isTrusted(this->fd)) {
+			close(this->fd);
+			this->fd = -1;
+		}
+	}
+}
+
+/*
+ * isTrusted: checks that a shared memory object is owned by the effective
+ *		user and not writable by its group or others
+ */
+bool LuaSharedConfig::isTrusted(int fd)
+{
+	struct stat st;
+	return fstat(fd, &st) == 0 && st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+/*
+ * LuaSharedConfig destructor: unmaps both objects. A publisher which didn't
+ *		publish marks the header failed so nobody waits for it, and removes
+ *		the objects so the next process to load the config file tries again
+ */
+LuaSharedConfig::~LuaSharedConfig()
+{
+	if (this->owner && (!this->header || this->header->state.load(std::memory_order_acquire) != 1)) {
+		if (this->header) {
+			this->header->state.store(2, std::memory_order_release);
+		}
+		LuaSharedConfig::remove(this->name);
+	}
+	if (this->header) {
+		munmap(this->header, sizeof(LuaSharedHeader));
+	}
+	if (this->data) {
+		munmap(this->data, this->length);
+	}
+	if (this->fd >= 0) {
+		close(this->fd);
+	}
+}
+
+/*
+ * publish: writes the bytecode and values to the data object, then marks the
+ *		header ready for the waiting processes
+ */
+bool LuaSharedConfig::publish(const std::string &bytecode, const std::string &values)
+{
+	if (!this->owner || !this->header) {
+		return false;
+	}
+
+	// Replace a data object left behind by a publisher which died
+	std::string data_name = this->name + LEJIT_SHARED_DATA;
+	shm_unlink(data_name.c_str());
+	int data_fd = shm_open(data_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (data_fd < 0) {
+		this->header->state.store(2, std::memory_order_release);
+		return false;
+	}
+
+	// Objects of size 0 can't be mapped
+	size_t length = std::max(bytecode.size() + values.size(), (size_t) 1);
+	void *base = MAP_FAILED;
+	if (ftruncate(data_fd, length) == 0) {
+		base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, data_fd, 0);
+	}
+	close(data_fd);
+	if (base == MAP_FAILED) {
+		this->header->state.store(2, std::memory_order_release);
+		return false;
+	}
+
+	memcpy(base, bytecode.data(), bytecode.size());
+	memcpy(static_cast<char *>(base) + bytecode.size(), values.data(), values.size());
+	munmap(base, length);
+
+	this->header->bytecode_size = bytecode.size();
+	this->header->values_size = values.size();
+	this->header->state.store(1, std::memory_order_release);
+	return true;
+}
+
+/*
+ * attach: waits for the publisher to mark the header ready, then maps the
+ *		data object. If the publisher died before that, the objects are
+ *		removed so the next process to load the config file publishes it
+ */
+bool LuaSharedConfig::attach(double timeout)
+{
+	if (this->owner || this->fd < 0) {
+		return false;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+	std::chrono::microseconds wait(100);
+
+	while (true) {
+		// The header can't be mapped until the publisher has sized it
+		if (!this->header) {
+			struct stat st;
+			if (fstat(this->fd, &st) == 0 && (size_t) st.st_size >= sizeof(LuaSharedHeader)) {
+				void *base = mmap(nullptr, sizeof(LuaSharedHeader), PROT_READ, MAP_SHARED, this->fd, 0);
+				if (base != MAP_FAILED) {
+					this->header = static_cast<LuaSharedHeader *>(base);
+				}
+			}
+		}
+
+		if (this->header) {
+			uint32_t state = this->header->state.load(std::memory_order_acquire);
+			if (state == 1) {
+				break;
+			}
+			if (state == 2) {
+				return false;
+			}
+
+			int32_t pid = this->header->pid.load(std::memory_order_acquire);
+			if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+				LuaSharedConfig::remove(this->name);
+				return false;
+			}
+		}
+
+		if (std::chrono::steady_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(wait);
+		wait = std::min(wait * 2, std::chrono::microseconds(10000));
+	}
+
+	if (memcmp(this->header->magic, LEJIT_SHARED_MAGIC, 8) != 0) {
+		return false;
+	}
+
+	std::string data_name = this->name + LEJIT_SHARED_DATA;
+	int data_fd = shm_open(data_name.c_str(), O_RDONLY, 0);
+	if (data_fd < 0) {
+		return false;
+	}
+
+	size_t length = std::max(this->header->bytecode_size + this->header->values_size, (uint64_t) 1);
+	struct stat st;
+	void *base = MAP_FAILED;
+	if (LuaSharedConfig::isTrusted(data_fd) && fstat(data_fd, &st) == 0 && (size_t) st.st_size >= length) {
+		base = mmap(nullptr, length, PROT_READ, MAP_SHARED, data_fd, 0);
+	}
+	close(data_fd);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+
+	this->data = base;
+	this->length = length;
+	return true;
+}
+
+/*
+ * remove: unlinks the header and data objects with the given name
+ */
+void LuaSharedConfig::remove(std::string name)
+{
+	shm_unlink(name.c_str());
+	shm_unlink((name + LEJIT_SHARED_DATA).c_str());
+}
\ No newline at end of file
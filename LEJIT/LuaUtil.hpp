@@ -23,15 +23,41 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <limits>
+#include <cmath>
+#include <ctype.h>
+#include <type_traits>
+#include <fstream>
+#include <ostream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <errno.h>
 
 #include "./torch/install/include/lua.hpp"
 
+#include "NDArray.cpp"
+#include "Parallel.hpp"
+#include "Native.hpp"
+
 // Macro used to get type information about parameters
 #define type(x) std::type_index(typeid(x))
 
 // Overloaded version of lua_error to include custom message
 void lua_error(lua_State *L, std::string fmt, ...);
 
+// Creates a Lua state which is closed when its last owner is released
+std::shared_ptr<lua_State> lua_newshared();
+
 // Helper functions to handle Lua to C value conversion in a
 // polymorphic way. Only implemented for allowed types
 void lua_gettopvalue(lua_State *L, int &ptr);
@@ -51,6 +77,32 @@ template <typename T, size_t cols, size_t depth> void lua_gettopvalue(lua_State
 template <typename T, size_t rows, size_t cols, size_t depth> void lua_gettopvalue(lua_State *L, T (&ptr)[rows][cols][depth]);
 template <typename T> void lua_gettopvalue(lua_State *L, std::vector<std::vector<std::vector<T>>> (&ptr));
 
+template <typename T> void lua_gettopvalue(lua_State *L, NDArray<T> (&ptr));				// Flat array of any rank
+
+// Fast conversion of Lua tables of numbers or strings, used by the array
+// versions of lua_gettopvalue. Copy the table at index into dst with raw
+// accesses after checking its length, without popping it. The nested version
+// copies a table of ndims dimensions into a contiguous row major array. Longer
+// tables are truncated, unless exact is set
+template <typename T, typename Out> void lua_rawtoarray(lua_State *L, int index, Out dst, size_t size, bool exact = false);
+template <typename T> void lua_rawtoarray(lua_State *L, int index, T *dst, const size_t *dims, int ndims, bool exact = false);
+template <typename T> void lua_rawtovector(lua_State *L, int index, std::vector<T> &ptr);
+template <typename T> void lua_rawtovector(lua_State *L, int index, std::vector<std::vector<T>> &ptr);
+
+// Fetches a global value by name, returning false and leaving ptr untouched if
+// it is nil
+template <typename T> bool lua_getglobalvalue(lua_State *L, std::string name, T &ptr);
+
+// Checks if the value at index can be read into a T by lua_gettopvalue
+// without raising an error, so wrong typed values can be skipped instead of
+// ending the program. The pointer only selects the type
+bool lua_isvalue(lua_State *L, int index, const int *);
+bool lua_isvalue(lua_State *L, int index, const double *);
+bool lua_isvalue(lua_State *L, int index, const bool *);
+bool lua_isvalue(lua_State *L, int index, const std::string *);
+template <typename T> bool lua_isvalue(lua_State *L, int index, const std::vector<T> *);
+template <typename T> bool lua_isvalue(lua_State *L, int index, const NDArray<T> *);
+
 // Functions for pushing values into lua tables on the stack
 void lua_pushtableindex(lua_State *L, int index, int value);
 void lua_pushtableindex(lua_State *L, int index, double value);
@@ -72,7 +124,890 @@ template <typename T> void lua_pushvector(lua_State *L, std::vector<T> (&vec));
 // Call to give a Lua state acess to the custom defined array type
 int lua_openarray (lua_State* L);
 
+// Dumps the function on top of the stack to bytecode, leaving it on the stack
+std::string lua_dumptop(lua_State *L);
+
+// Hashes a string with 64 bit FNV-1a
+uint64_t lua_hashstring(const std::string &str, uint64_t hash = 14695981039346656037ULL);
+
+// Gets the modification time of a file in nanoseconds
+uint64_t lua_mtime(const struct stat &st);
+
+// Hashes the bytecode and upvalues of the Lua function at index, so a
+// redefinition with the same behavior can be recognized. Returns 0 if the
+// function can't be fingerprinted
+uint64_t lua_fingerprint(lua_State *L, int index);
+
+// Comment written into the stub definitions of function parameters
+#define LEJIT_STUB_COMMENT "-- Add a Lua function definition here to override the default behavior"
+
+// Checks if the function at index is still a stub written by
+// writeConfigFile: it has an empty body, and LEJIT_STUB_COMMENT in its source
+bool lua_isstub(lua_State *L, int index);
+
+// Same as luaL_loadfile, but loads precompiled bytecode from cache_dir if the
+// file's contents have been loaded before, and stores it there if not. Sets
+// hit, and sets bytecode to the bytecode of the loaded chunk
+int lua_loadfilecached(lua_State *L, std::string filename, std::string cache_dir, bool &hit, std::string &bytecode);
+
 // Calls an arbitrary Lua function
 void lua_callfunc(lua_State *L, std::string func_name, std::string signature, ...);
 
+// Parses a signature string once into one kind character per argument
+// ('i', 'd', 'b', 'a' for arrays or 'c' for cdata arrays). Returns the number
+// of inparams
+int lua_parsesignature(lua_State *L, std::string signature, char *kinds, size_t num_args);
+
+// Helper functions to push a function argument or fetch a function result at
+// a given stack index. Only implemented for allowed types
+void lua_pushargument(lua_State *L, int val, char kind);
+void lua_pushargument(lua_State *L, double val, char kind);
+void lua_pushargument(lua_State *L, bool val, char kind);
+template <typename T> void lua_pushargument(lua_State *L, T *val, char kind);
+
+// Gets the LuaJIT FFI type name of a cdata array argument
+template <typename T> const char * lua_ctypename(T val);
+const char * lua_ctypename(int *val);
+const char * lua_ctypename(double *val);
+const char * lua_ctypename(bool *val);
+
+// Replaces the function on top of the stack with a wrapper converting cdata
+// array arguments from light userdata to FFI pointers
+void lua_wrapcdata(lua_State *L, const char *kinds, const char **ctypes, int num_in);
+
+// Replaces the function on top of the stack with a driver calling it once for
+// each element of a batch of arguments
+void lua_wrapbatch(lua_State *L, const char *kinds, int num_in, int num_args);
+
+template <typename T> void lua_getresult(lua_State *L, int index, T val, char kind);
+template <typename T> void lua_getresult(lua_State *L, int index, T *ptr, char kind);
+
+/*
+ * structs used for generating index sequences to unpack variadic function
+ * arguments
+ */
+template<int...> 
+struct int_sequence {};
+
+template<int N, int... Is> 
+struct make_int_sequence
+    : make_int_sequence<N-1, N-1, Is...> {};
+
+template<int... Is> 
+struct make_int_sequence<0, Is...>
+    : int_sequence<Is...> {};
+
+/*
+ * LuaRef: reference to a Lua value stored in the registry of a Lua state.
+ *		The reference is released when the LuaRef is destroyed. Shares
+ *		ownership of the state, so it stays open while any reference into it
+ *		is alive
+ */
+class LuaRef {
+private:
+	// Owner of the Lua execution state holding the value
+	std::shared_ptr<lua_State> owner;
+
+	// Lua execution state holding the value
+	lua_State *L;
+
+	// Registry index of the value
+	int ref;
+
+public:
+	// Pops the value on top of the stack into the registry
+	LuaRef(std::shared_ptr<lua_State> owner) : owner(owner), L(owner.get()), ref(luaL_ref(owner.get(), LUA_REGISTRYINDEX)) {}
+	~LuaRef() { luaL_unref(this->L, LUA_REGISTRYINDEX, this->ref); }
+
+	LuaRef(const LuaRef&) = delete;
+	LuaRef& operator=(const LuaRef&) = delete;
+
+	// Pushes the value back onto the stack
+	void push() const { lua_rawgeti(this->L, LUA_REGISTRYINDEX, this->ref); }
+
+	// Owner of the state the value is held in
+	std::shared_ptr<lua_State> getOwner() const { return this->owner; }
+};
+
+/*
+ * LuaStatsValues: values of the statistics kept for a function, times in
+ *		nanoseconds. Times are only kept for calls made while timing was on
+ */
+struct LuaStatsValues {
+	uint64_t calls, errors;
+	uint64_t timed_calls, total_ns, max_ns;
+	uint64_t memo_hits, memo_misses;
+};
+
+/*
+ * LuaStats: call counters and time accounting for a function, shared by all
+ *		of its bindings and safe to update from several threads. Calls are
+ *		only counted unless timing is turned on. Compiled to nothing if
+ *		LEJIT_NO_STATS is defined
+ */
+class LuaStats {
+private:
+	std::atomic<uint64_t> calls, errors;
+	std::atomic<uint64_t> timed_calls, total_ns, max_ns;
+	std::atomic<uint64_t> memo_hits, memo_misses;
+
+	// Whether calls are timed as well as counted
+	std::atomic<bool> timing;
+
+public:
+	LuaStats() : timing(false) { this->clear(); }
+
+	// Turns timing of calls on or off
+	void setTiming(bool timing) { this->timing.store(timing, std::memory_order_relaxed); }
+
+	// True if calls are timed, always false if statistics are disabled
+	bool isTiming() const
+	{
+#ifdef LEJIT_NO_STATS
+		return false;
+#else
+		return this->timing.load(std::memory_order_relaxed);
+#endif
+	}
+
+	// Current time in nanoseconds, 0 if statistics are disabled
+	static uint64_t now()
+	{
+#ifdef LEJIT_NO_STATS
+		return 0;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Records an untimed call
+	void record();
+
+	// Records a call which started at start and returned at end
+	void record(uint64_t start, uint64_t end);
+
+	// Records a Lua error
+	void recordError();
+
+	// Records a lookup in the result cache of a pure function
+	void recordMemo(bool hit);
+
+	LuaStatsValues get() const;
+	void clear();
+};
+
+/*
+ * LuaFunc: callable object which calls a Lua function with a fixed C++
+ *		signature. The signature string is parsed once on construction, so
+ *		each call only pushes arguments and fetches results
+ */
+template <typename ...args>
+class LuaFunc {
+private:
+	// Lua execution state the function is found in
+	lua_State *L;
+
+	// Name of the function in the Lua state, used for error messages
+	std::string name;
+
+	// Registry reference to the function, shared by all copies
+	std::shared_ptr<LuaRef> func;
+
+	// Kind of each argument as parsed from the signature string
+	char kinds[sizeof...(args) + 1];
+
+	// Number of inparams and outparams
+	int num_in, num_out;
+
+	// Statistics of the function, may be null
+	std::shared_ptr<LuaStats> stats;
+
+	// Unpacks arguments in order
+	template<int ...Is> void call(int_sequence<Is...>, args... a) const;
+
+public:
+	// Constructor, func is a reference to the Lua function to call
+	LuaFunc(lua_State *L, std::string name, std::shared_ptr<LuaRef> func, std::string signature, std::shared_ptr<LuaStats> stats = nullptr);
+
+	// Calls the Lua function
+	void operator()(args... a) const { this->call(make_int_sequence<sizeof...(args)>{}, a...); }
+};
+
+/*
+ * lua_batcharg: type of an argument in the batched form of a function. Each
+ *		scalar inparam becomes an array of inputs and each outparam an array
+ *		of results
+ */
+template <typename T> struct lua_batcharg { typedef T *type; };
+template <typename T> struct lua_batcharg<T*> { typedef T *type; };
+
+/*
+ * lua_batchelem: gets the argument of element i of a batch out of the array
+ *		passed for it to the batched form of a function
+ */
+template <typename T> struct lua_batchelem { static T get(T *a, int i) { return a[i]; } };
+template <typename T> struct lua_batchelem<T*> { static T *get(T *a, int i) { return a + i; } };
+
+/*
+ * LuaBatchFunc: callable object which calls a Lua function with scalar
+ *		arguments once for each of n argument tuples, passed as one array per
+ *		argument. The loop over the batch runs in Lua, so the C/Lua boundary is
+ *		only crossed once per batch
+ */
+template <typename ...args>
+class LuaBatchFunc {
+private:
+	// Lua execution state the function is found in
+	lua_State *L;
+
+	// Name of the function in the Lua state, used for error messages
+	std::string name;
+
+	// Registry reference to the batch driver, shared by all copies
+	std::shared_ptr<LuaRef> func;
+
+	// Statistics of the function, may be null. Each batch counts as one call
+	std::shared_ptr<LuaStats> stats;
+
+public:
+	// Constructor, func is a reference to the Lua function to call
+	LuaBatchFunc(lua_State *L, std::string name, std::shared_ptr<LuaRef> func, std::string signature, std::shared_ptr<LuaStats> stats = nullptr);
+
+	// Calls the Lua function for each of the n elements of the argument arrays
+	void operator()(int n, typename lua_batcharg<args>::type... a) const;
+};
+
+/*
+ * LuaThreadState: Lua execution state used by a single thread, with its own
+ *		copy of the config file and of each function bound in it
+ */
+struct LuaThreadState {
+	// Owner of L, shared with the references bound in it
+	std::shared_ptr<lua_State> owner;
+
+	// Lua execution state
+	lua_State *L;
+
+	// Version of the config file bytecode loaded into L, 0 if none
+	unsigned long version;
+
+	// Functions bound in L, indexed by slot
+	std::vector<std::shared_ptr<void>> funcs;
+
+	LuaThreadState();
+	~LuaThreadState();
+
+	LuaThreadState(const LuaThreadState&) = delete;
+	LuaThreadState& operator=(const LuaThreadState&) = delete;
+};
+
+/*
+ * LuaStatePool: hands out one Lua execution state per calling thread. States
+ *		are created lazily from the config file bytecode, kept for as long as
+ *		their thread lives and then reused by the next thread that asks
+ */
+class LuaStatePool : public std::enable_shared_from_this<LuaStatePool> {
+private:
+	// Unique id of the pool, used to find its states in the per thread cache
+	size_t id;
+
+	// Chunk name and bytecode of the config file
+	std::string chunkname;
+	std::string bytecode;
+
+	// Incremented each time the bytecode is replaced
+	std::atomic<unsigned long> version;
+
+	// Number of function slots reserved in each state
+	int num_slots;
+
+	// All states created by the pool, and the ones not in use by any thread
+	std::vector<std::unique_ptr<LuaThreadState>> states;
+	std::vector<LuaThreadState*> free_states;
+
+	// Guards everything above except version
+	std::mutex mutex;
+
+	// Takes a free state or creates a new one
+	LuaThreadState * acquire();
+
+	// Loads the current bytecode into a state, dropping its bound functions
+	void load(LuaThreadState *state);
+
+public:
+	LuaStatePool();
+
+	LuaStatePool(const LuaStatePool&) = delete;
+	LuaStatePool& operator=(const LuaStatePool&) = delete;
+
+	// Replaces the config file bytecode. Each state reloads it the next time
+	// its thread uses it
+	void setBytecode(std::string chunkname, std::string bytecode);
+
+	// Reserves n consecutive function slots and returns the first
+	int newSlots(int n);
+
+	// Gets the state of the calling thread, loaded with the latest bytecode
+	LuaThreadState * local();
+
+	// Puts a state back on the free list once its thread exits
+	void release(LuaThreadState *state);
+
+	// Number of states created so far
+	size_t size();
+};
+
+/*
+ * LuaThreadFunc: callable object which calls a Lua function in the Lua state
+ *		of the calling thread. F is the LuaFunc or LuaBatchFunc type bound in
+ *		each state, the first time the function is called from it
+ */
+template <typename F>
+class LuaThreadFunc {
+private:
+	// Pool of per thread states
+	std::shared_ptr<LuaStatePool> pool;
+
+	// Slot the function is bound to in each state
+	int slot;
+
+	// Name and signature string of the function
+	std::string name;
+	std::string signature;
+
+	// Statistics shared by the function's bindings in all states, may be null
+	std::shared_ptr<LuaStats> stats;
+
+	// Gets the function bound in the calling thread's state
+	const F & local() const;
+
+public:
+	LuaThreadFunc(std::shared_ptr<LuaStatePool> pool, int slot, std::string name, std::string signature, std::shared_ptr<LuaStats> stats = nullptr)
+		: pool(pool), slot(slot), name(name), signature(signature), stats(stats) {}
+
+	// Calls the Lua function
+	template <typename ...Ts> void operator()(Ts... a) const { this->local()(a...); }
+};
+
+/*
+ * LuaBinding: callable a function parameter is bound to. Holds a Lua function
+ *		as the LuaFunc or LuaBatchFunc type F, or the LuaThreadFunc of it, so
+ *		calls into Lua are direct. Any other callable, like a default, native
+ *		function or table, is held in a std::function
+ */
+template <typename F, typename ...args>
+class LuaBinding {
+private:
+	// Lua function called in a single state, or in the calling thread's
+	// state. At most one of them is set
+	std::shared_ptr<F> func;
+	std::shared_ptr<LuaThreadFunc<F>> thread_func;
+
+	// Callable used if neither is set
+	std::function<void(args...)> other;
+
+public:
+	LuaBinding() {}
+	LuaBinding(F func) : func(std::make_shared<F>(func)) {}
+	LuaBinding(LuaThreadFunc<F> func) : thread_func(std::make_shared<LuaThreadFunc<F>>(func)) {}
+	LuaBinding(std::function<void(args...)> func) : other(func) {}
+
+	// Calls the bound callable
+	void operator()(args... a) const
+	{
+		if (this->func) {
+			(*this->func)(a...);
+		}
+		else if (this->thread_func) {
+			(*this->thread_func)(a...);
+		}
+		else {
+			this->other(a...);
+		}
+	}
+};
+
+/*
+ * LuaEpoch: epoch based reclamation shared by all versioned functions. A
+ *		thread pins the current epoch for the duration of each call, and a
+ *		version retired when the epoch advanced to e is only freed once no
+ *		thread is pinned to an epoch before e. Pinning takes no lock
+ */
+class LuaEpoch {
+public:
+	// Epoch a thread is pinned to, 0 while it isn't calling a function, and
+	// how deeply its calls are nested. Slots are reused once their thread exits
+	struct Slot {
+		std::atomic<uint64_t> pinned;
+		std::atomic<bool> in_use;
+		int depth;
+	};
+
+private:
+	// Current epoch, starting at 1
+	std::atomic<uint64_t> epoch;
+
+	// Slots of all threads which have pinned an epoch
+	std::vector<std::unique_ptr<Slot>> slots;
+
+	// Guards slots. Only taken the first time a thread pins, and on advance
+	std::mutex mutex;
+
+	// Gets the slot of the calling thread
+	Slot * slot();
+
+	LuaEpoch() : epoch(1) {}
+
+public:
+	LuaEpoch(const LuaEpoch&) = delete;
+	LuaEpoch& operator=(const LuaEpoch&) = delete;
+
+	// Gets the process wide instance
+	static LuaEpoch & get();
+
+	// Pins the calling thread to the current epoch until the matching unpin,
+	// which is passed the slot pin returns
+	Slot * pin();
+	void unpin(Slot *s);
+
+	// Advances the epoch and returns the new one
+	uint64_t advance();
+
+	// Gets the earliest epoch any thread is pinned to
+	uint64_t oldestPinned();
+};
+
+/*
+ * LuaEpochGuard: pins the calling thread for the lifetime of the guard. The
+ *		thread's slot is only looked up once, on construction
+ */
+struct LuaEpochGuard {
+	LuaEpoch::Slot *slot;
+
+	LuaEpochGuard() : slot(LuaEpoch::get().pin()) {}
+	~LuaEpochGuard() { LuaEpoch::get().unpin(this->slot); }
+};
+
+/*
+ * LuaVersioned: holds successive versions of a callable. publish replaces
+ *		the current version atomically, calls already running finish on the
+ *		version they started with, and replaced versions are freed once no
+ *		thread can still be calling them. The call path takes no lock
+ */
+template <typename F>
+class LuaVersioned {
+private:
+	// A callable and its version number
+	struct Version {
+		F func;
+		unsigned long number;
+	};
+
+	// Version new calls use
+	std::atomic<Version*> current;
+
+	// Replaced versions which may still be in use, with the epoch they were
+	// retired in
+	std::vector<std::pair<Version*, uint64_t>> retired;
+
+	// Guards retired. Only taken by publish
+	std::mutex mutex;
+
+	// Frees the retired versions no thread can still be calling
+	void reclaim();
+
+public:
+	LuaVersioned(F func = F()) : current(new Version { func, 0 }) {}
+	~LuaVersioned();
+
+	LuaVersioned(const LuaVersioned&) = delete;
+	LuaVersioned& operator=(const LuaVersioned&) = delete;
+
+	// Replaces the current version with func
+	void publish(F func);
+
+	// Gets a copy of the current version
+	F get() const;
+
+	// Gets the number of the current version, incremented by each publish
+	unsigned long version() const { return this->current.load()->number; }
+
+	// Calls the current version
+	template <typename ...Ts> void operator()(Ts... a) const
+	{
+		LuaEpochGuard guard;
+		this->current.load(std::memory_order_acquire)->func(a...);
+	}
+};
+
+/*
+ * LuaMemo: fixed size, direct mapped cache of the results of a pure function
+ *		of scalar arguments, each argument and result held in a 64 bit word.
+ *		Every entry is guarded by its own sequence number, so lookups take no
+ *		lock and a store racing with another one for the same entry is
+ *		dropped. clear starts a new generation, which older entries never
+ *		match
+ */
+class LuaMemo {
+private:
+	// Number of entries, a power of 2, and the number of argument and result
+	// words in each
+	size_t entries, num_in, num_out;
+
+	// Words of each entry: sequence number, generation, arguments, results
+	size_t stride;
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+
+	// Current generation
+	std::atomic<uint64_t> gen;
+
+public:
+	// Rounds entries up to a power of 2
+	LuaMemo(size_t entries, size_t num_in, size_t num_out);
+
+	// Gets the current generation. Take it before calling the function, so a
+	// result computed across a clear is stored in the old generation
+	uint64_t generation() const { return this->gen.load(std::memory_order_acquire); }
+
+	// Invalidates every entry
+	void clear() { this->gen.fetch_add(1, std::memory_order_acq_rel); }
+
+	// Copies the results for the arguments in into out if they are cached in
+	// the given generation, returns false if not
+	bool lookup(const uint64_t *in, uint64_t *out, uint64_t generation) const;
+
+	// Caches the results for the arguments in, replacing the entry they map to
+	void store(const uint64_t *in, const uint64_t *out, uint64_t generation);
+};
+
+// Helpers converting between scalar arguments and LuaMemo words. Inparams are
+// passed by value and outparams by pointer, the other is skipped
+inline void lua_memoinput(uint64_t *in, size_t &n, int value) { in[n++] = (uint64_t) (int64_t) value; }
+inline void lua_memoinput(uint64_t *in, size_t &n, double value) { memcpy(&in[n++], &value, sizeof(value)); }
+inline void lua_memoinput(uint64_t *in, size_t &n, bool value) { in[n++] = value; }
+template <typename T> inline void lua_memoinput(uint64_t *in, size_t &n, T *value) {}
+
+template <typename T> inline void lua_memoresult(uint64_t *out, size_t &n, T value) {}
+inline void lua_memoresult(uint64_t *out, size_t &n, int *value) { out[n++] = (uint64_t) (int64_t) *value; }
+inline void lua_memoresult(uint64_t *out, size_t &n, double *value) { memcpy(&out[n++], value, sizeof(*value)); }
+inline void lua_memoresult(uint64_t *out, size_t &n, bool *value) { out[n++] = *value; }
+
+template <typename T> inline void lua_memoreturn(T value, const uint64_t *out, size_t &n) {}
+inline void lua_memoreturn(int *value, const uint64_t *out, size_t &n) { *value = (int) (int64_t) out[n++]; }
+inline void lua_memoreturn(double *value, const uint64_t *out, size_t &n) { memcpy(value, &out[n++], sizeof(*value)); }
+inline void lua_memoreturn(bool *value, const uint64_t *out, size_t &n) { *value = out[n++] != 0; }
+
+/*
+ * LuaMemoFunc: callable object which serves calls to a pure function with
+ *		scalar inparams and outparams from a LuaMemo, and calls the function
+ *		on a miss
+ */
+template <typename ...args>
+class LuaMemoFunc {
+private:
+	// Function called on a miss
+	std::function<void(args...)> func;
+
+	// Result cache, owned by this binding of the function
+	std::shared_ptr<LuaMemo> memo;
+
+	// Statistics to record hits and misses in, or null
+	std::shared_ptr<LuaStats> stats;
+
+public:
+	LuaMemoFunc(std::function<void(args...)> func, size_t entries, std::shared_ptr<LuaStats> stats = nullptr);
+
+	// Gets the result cache
+	std::shared_ptr<LuaMemo> getMemo() const { return this->memo; }
+
+	void operator()(args... a) const;
+};
+
+/*
+ * LuaTableSpec: domain and resolution a function of one or two doubles is
+ *		sampled over. rank is 0 for functions which aren't tabulated
+ */
+struct LuaTableSpec {
+	int rank;
+	double lo[2], hi[2];
+	size_t n[2];
+
+	// Largest error allowed at the midpoints between samples, 0 to skip the
+	// check
+	double tolerance;
+};
+
+/*
+ * LuaInterpTable: samples of a function of one or two doubles on an evenly
+ *		spaced grid, evaluated by linear or bilinear interpolation. Points
+ *		outside the domain are clamped to its edge
+ */
+class LuaInterpTable {
+private:
+	LuaTableSpec spec;
+
+	// Samples per unit along each dimension
+	double scale[2];
+
+	// Samples in row major order, the first dimension varying slowest
+	std::vector<double> values;
+
+	// Largest error at the midpoints between samples, if checked
+	double error;
+
+public:
+	// Samples sample(x, y) at every grid point, and at the midpoints if the
+	// spec has a tolerance. y is 0 for tables of rank 1
+	LuaInterpTable(const LuaTableSpec &spec, std::function<double(double, double)> sample);
+
+	double getError() const { return this->error; }
+
+	// Checks if a point is inside the domain
+	bool contains(double x) const { return x >= this->spec.lo[0] && x <= this->spec.hi[0]; }
+	bool contains(double x, double y) const { return this->contains(x) && y >= this->spec.lo[1] && y <= this->spec.hi[1]; }
+
+	// Interpolates at one point
+	double operator()(double x) const;
+	double operator()(double x, double y) const;
+
+	// Interpolates at count points, in loops the compiler can vectorize
+	void eval(int count, const double *x, double *out) const;
+	void eval(int count, const double *x, const double *y, double *out) const;
+};
+
+// Binds call and batch to a table sampled from func, which they fall back to
+// outside its domain. Returns false if the table exceeds the tolerance, or if
+// func isn't a d>d or dd>d function
+template <typename ...args> bool lua_tabulate(const std::function<void(args...)> &func, const LuaTableSpec &spec, std::function<void(args...)> &call, std::function<void(int, typename lua_batcharg<args>::type...)> &batch, double &error) { return false; }
+bool lua_tabulate(const std::function<void(double, double*)> &func, const LuaTableSpec &spec, std::function<void(double, double*)> &call, std::function<void(int, double*, double*)> &batch, double &error);
+bool lua_tabulate(const std::function<void(double, double, double*)> &func, const LuaTableSpec &spec, std::function<void(double, double, double*)> &call, std::function<void(int, double*, double*, double*)> &batch, double &error);
+
+// Translates the Lua function on top of the stack to C and loads it with
+// compiler, popping the function. Returns the address of the C function, with
+// handle keeping it loaded, or null with error set
+void *lua_compilenative(lua_State *L, std::string signature, NativeCompiler &compiler, std::shared_ptr<void> &handle, std::string &error);
+
+// Binds call and batch to the C function native, which handle keeps loaded
+template <typename ...args> void lua_bindnative(void *native, std::shared_ptr<void> handle, std::function<void(args...)> &call, std::function<void(int, typename lua_batcharg<args>::type...)> &batch);
+
+// Binds batch to a loop calling func for each element. Throws a Lua error if
+// signature has array arguments
+template <typename ...args> void lua_bindbatch(lua_State *L, std::string signature, const std::function<void(args...)> &func, std::function<void(int, typename lua_batcharg<args>::type...)> &batch);
+
+/*
+ * Writing Lua literals to config files. Numbers are written with the fewest
+ * digits that read back as the same double, and large tables are formatted
+ * in chunks on all hardware threads
+ */
+
+// Number of table elements formatted at a time, by one thread
+#define LUA_WRITE_CHUNK 16384
+
+// Appends value as a Lua literal to out
+void lua_appendliteral(std::string &out, int value);
+void lua_appendliteral(std::string &out, double value);
+void lua_appendliteral(std::string &out, bool value);
+void lua_appendliteral(std::string &out, const std::string &value);
+template <typename T> void lua_appendliteral(std::string &out, T value);
+
+// Writes value as a Lua literal to out
+template <typename T> void lua_writeliteral(std::ostream &out, const T &value);
+
+// Appends value as a C++ literal to out, written like lua_appendliteral
+// except for bools, infinities and NaN
+void lua_appendcppliteral(std::string &out, double value);
+void lua_appendcppliteral(std::string &out, bool value);
+template <typename T> void lua_appendcppliteral(std::string &out, const T &value) { lua_appendliteral(out, value); }
+
+// Name of the C++ type constants of type T are written with, null if unsupported
+template <typename T> const char *lua_cpptypename() { return nullptr; }
+template <> inline const char *lua_cpptypename<int>() { return "int"; }
+template <> inline const char *lua_cpptypename<double>() { return "double"; }
+template <> inline const char *lua_cpptypename<bool>() { return "bool"; }
+template <> inline const char *lua_cpptypename<std::string>() { return "const char *"; }
+
+// Writes the nested Lua tables holding an array of the given shape to out,
+// where element(i) gets its i-th element in row major order. With cpp, the
+// same nesting is written as a C++ aggregate initializer of C++ literals
+template <typename F> void lua_writetable(std::ostream &out, const std::vector<size_t> &shape, F element, bool cpp = false);
+
+/*
+ * Binary sidecar array files, referenced from config files with
+ * lejit.array("file.bin"). Layout, in native byte order:
+ *		8 bytes		magic "LEJITARR"
+ *		uint32		element type code, 'i' for int or 'd' for double
+ *		uint32		rank
+ *		uint64		extent of each dimension
+ *		elements in row major order
+ */
+#define LEJIT_ARRAY_MAGIC "LEJITARR"
+#define LEJIT_ARRAY_META "lejit.array"
+
+// Type code of array elements of type T in sidecar files, 0 if unsupported
+template <typename T> char lua_arraytypecode() { return 0; }
+template <> inline char lua_arraytypecode<int>() { return 'i'; }
+template <> inline char lua_arraytypecode<double>() { return 'd'; }
+
+// Opens the lejit library, holding lejit.array and lejit.default, in a Lua
+// state. Relative sidecar paths are resolved against dir
+int lua_openlejit(lua_State *L, std::string dir = "");
+
+// Checks if the value at index is lejit.default, which function parameters
+// are set to to call their C++ default
+bool lua_isdefault(lua_State *L, int index);
+
+// Checks if the value at index is a sidecar reference made by lejit.array,
+// and gets the path it refers to
+bool lua_isarrayfile(lua_State *L, int index);
+std::string lua_toarrayfile(lua_State *L, int index);
+
+// Writes a sidecar file atomically, returning false on failure
+bool lua_writearrayfile(std::string path, char type, const std::vector<size_t> &shape, const void *data, size_t elem_size);
+template <typename T> bool lua_writearrayfile(std::string path, const NDArray<T> &arr);
+
+/*
+ * LuaMappedArray: sidecar array file mapped read only into memory. The
+ *		elements are used in place, without being copied
+ */
+class LuaMappedArray {
+private:
+	// Path of the file, and its modification time, size and inode when mapped
+	std::string path;
+	time_t mtime;
+	off_t size;
+	ino_t ino;
+
+	// Mapped file
+	void *base;
+	size_t length;
+
+	// Element type code, shape and first element
+	char type;
+	std::vector<size_t> shape;
+	const char *elements;
+
+public:
+	// Maps the file, raising a Lua error in L if it is missing or malformed
+	LuaMappedArray(lua_State *L, std::string path);
+	~LuaMappedArray();
+
+	LuaMappedArray(const LuaMappedArray&) = delete;
+	LuaMappedArray& operator=(const LuaMappedArray&) = delete;
+
+	// Getters
+	std::string getPath() const { return this->path; }
+	char getType() const { return this->type; }
+	const std::vector<size_t> &getShape() const { return this->shape; }
+
+	// Checks if the file on disk is still the one that was mapped
+	bool isCurrent() const;
+
+	// Gets a view of the elements, which must be of type T
+	template <typename T> NDView<const T> view() const { return NDView<const T>(reinterpret_cast<const T *>(this->elements), this->shape); }
+};
+
+/*
+ * Binary form of config file snapshots, shared between processes on a node.
+ * Values are written in native byte order, sizes as uint64
+ */
+
+// Appends value to out in binary form
+template <typename T> void lua_packvalue(std::string &out, const T &value);
+void lua_packvalue(std::string &out, const std::string &value);
+template <typename T> void lua_packvalue(std::string &out, const std::vector<T> &value);
+template <typename T> void lua_packvalue(std::string &out, const NDArray<T> &value);
+
+// Reads a value written by lua_packvalue at data, advancing data past it.
+// Returns false if the value would run past end
+template <typename T> bool lua_unpackvalue(const char *&data, const char *end, T &value);
+bool lua_unpackvalue(const char *&data, const char *end, std::string &value);
+template <typename T> bool lua_unpackvalue(const char *&data, const char *end, std::vector<T> &value);
+template <typename T> bool lua_unpackvalue(const char *&data, const char *end, NDArray<T> &value);
+
+/*
+ * Shared config files are published in two POSIX shared memory objects. The
+ * first process to create the header object becomes the publisher, and the
+ * others wait for it to mark the header ready. Both objects are sized once,
+ * as some systems don't allow shared memory objects to be resized
+ */
+#define LEJIT_SHARED_MAGIC "LEJITSHM"
+
+// Suffix of the name of the object holding the bytecode and values
+#define LEJIT_SHARED_DATA "_d"
+
+/*
+ * LuaSharedHeader: header object of a shared config file
+ */
+struct LuaSharedHeader {
+	char magic[8];
+
+	// 0 while the publisher evaluates the config file, 1 once the data object
+	// is complete and 2 if publishing failed
+	std::atomic<uint32_t> state;
+
+	// Process id of the publisher
+	std::atomic<int32_t> pid;
+
+	// Sizes of the bytecode and values in the data object, in that order
+	uint64_t bytecode_size;
+	uint64_t values_size;
+};
+
+/*
+ * LuaSharedConfig: shared config file with a given name, either created by
+ *		this process to publish into, or published by another process and
+ *		mapped read only
+ */
+class LuaSharedConfig {
+private:
+	// Name of the header object
+	std::string name;
+
+	// True if this process created the header object and should publish
+	bool owner;
+
+	// Mapped header object
+	int fd;
+	LuaSharedHeader *header;
+
+	// Mapped data object
+	void *data;
+	size_t length;
+
+	// True if the object open as fd is owned by this user and writable by
+	// nobody else, so its contents can be trusted
+	static bool isTrusted(int fd);
+
+public:
+	// Creates the header object, or opens it if another process already did
+	LuaSharedConfig(std::string name);
+	~LuaSharedConfig();
+
+	LuaSharedConfig(const LuaSharedConfig&) = delete;
+	LuaSharedConfig& operator=(const LuaSharedConfig&) = delete;
+
+	// True if this process should publish the config file
+	bool isOwner() const { return this->owner; }
+
+	// Publishes the bytecode and values and marks the header ready. Returns
+	// false on failure, which the waiting processes are told about
+	bool publish(const std::string &bytecode, const std::string &values);
+
+	// Waits up to timeout seconds for the publisher, then maps the data.
+	// Returns false if it wasn't published in time, publishing failed or the
+	// publisher died, in which case the caller should evaluate the config
+	// file itself
+	bool attach(double timeout);
+
+	// Getters for the published data, valid after attach
+	const char *getBytecode() const { return static_cast<const char *>(this->data); }
+	size_t getBytecodeSize() const { return this->header->bytecode_size; }
+	const char *getValues() const { return this->getBytecode() + this->header->bytecode_size; }
+	size_t getValuesSize() const { return this->header->values_size; }
+
+	// Removes the shared memory objects with the given name. Processes which
+	// have them mapped keep their mapping
+	static void remove(std::string name);
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+/*
+ * 	 _____     ________     _____  _____  _________  
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  | 
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_| 
+ * 	  | |   _   |  _| _  _   | |    | |      | |     
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_    
+ *	|________||________|`.____.'  |_____|  |_____|   
+ *                                                 
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * Dylan Everingham 08/26/2016
+ * NDArray.cpp
+ *
+ * Implementation of the NDArray and NDView classes
+ *
+ */
+
+#include "NDArray.hpp"
+
+/*
+ * nd_size: number of elements in an array of the given shape
+ */
+inline size_t nd_size(const std::vector<size_t> &shape)
+{
+	size_t size = 1;
+	for (size_t extent : shape) {
+		size *= extent;
+	}
+	return size;
+}
+
+/*
+ * nd_strides: writes the row major strides of an array of the given shape
+ */
+inline void nd_strides(const std::vector<size_t> &shape, size_t *strides)
+{
+	size_t stride = 1;
+	for (size_t d = shape.size(); d-- > 0;) {
+		strides[d] = stride;
+		stride *= shape[d];
+	}
+}
+
+/*
+ * nd_checkrank: throws an error if an array of the given rank is indexed with
+ *		a different number of indices
+ */
+inline void nd_checkrank(const char *type, size_t indices, size_t rank)
+{
+	if (indices != rank) {
+		throw std::invalid_argument(std::string(type) + " indexed with " + std::to_string(indices)
+		+ " indices, but has rank " + std::to_string(rank) + "\n");
+	}
+}
+
+/*
+ * NDView constructor: computes row major strides from the shape
+ */
+template <typename T> NDView<T>::NDView(T *ptr, std::vector<size_t> shape) : ptr(ptr), shape(shape), strides(shape.size())
+{
+	nd_strides(this->shape, this->strides.data());
+}
+
+/*
+ * size: total number of elements in the view
+ */
+template <typename T> size_t NDView<T>::size() const
+{
+	return nd_size(this->shape);
+}
+
+/*
+ * operator(): gets the element at one index per dimension. Throws an error if
+ *		the number of indices doesn't match the rank
+ */
+template <typename T> template <typename ...Is> T & NDView<T>::operator()(Is... idx) const
+{
+	nd_checkrank("NDView", sizeof...(Is), this->rank());
+	return this->ptr[nd_offset(this->strides.data(), idx...)];
+}
+
+/*
+ * operator[]: gets the view of rank one lower at index i of the first
+ *		dimension, which shares the elements of this view
+ */
+template <typename T> NDView<T> NDView<T>::operator[](size_t i) const
+{
+	if (this->rank() < 1) {
+		throw std::invalid_argument("Can't take a slice of an NDView of rank 0\n");
+	}
+
+	std::vector<size_t> shape(this->shape.begin() + 1, this->shape.end());
+	return NDView<T>(this->ptr + i * this->strides[0], shape);
+}
+
+/*
+ * NDFixedView constructor: copies the shape and computes row major strides.
+ *		Throws an error if the shape's rank isn't N
+ */
+template <typename T, size_t N> NDFixedView<T, N>::NDFixedView(T *ptr, const std::vector<size_t> &shape) : ptr(ptr)
+{
+	if (shape.size() != N) {
+		throw std::invalid_argument("NDFixedView of rank " + std::to_string(N)
+		+ " taken of an array of rank " + std::to_string(shape.size()) + "\n");
+	}
+	std::copy(shape.begin(), shape.end(), this->shape);
+	nd_strides(shape, this->strides);
+}
+
+/*
+ * NDArray constructor: array of the given shape with every element set to fill
+ */
+template <typename T> NDArray<T>::NDArray(std::vector<size_t> shape, T fill) : shape(shape), strides(shape.size()), elements(nd_size(shape), fill)
+{
+	nd_strides(this->shape, this->strides.data());
+}
+
+/*
+ * NDArray constructor: array of the given shape holding elements in row major
+ *		order. Throws an error if their number doesn't match the shape
+ */
+template <typename T> NDArray<T>::NDArray(std::vector<size_t> shape, std::vector<T> elements) : shape(shape), strides(shape.size()), elements(elements)
+{
+	nd_strides(this->shape, this->strides.data());
+	if (this->elements.size() != nd_size(this->shape)) {
+		throw std::invalid_argument("NDArray given " + std::to_string(this->elements.size())
+		+ " elements, but its shape holds " + std::to_string(nd_size(this->shape)) + "\n");
+	}
+}
+
+/*
+ * nd_shape: appends the extents of the C-style array type A to shape
+ */
+template <typename A> void nd_shape(std::vector<size_t> &shape)
+{
+	if (std::rank<A>::value > 0) {
+		shape.push_back(std::extent<A>::value);
+		nd_shape<typename std::remove_extent<A>::type>(shape);
+	}
+}
+
+/*
+ * NDArray constructor: copies a C-style array of any rank, whose elements are
+ *		already contiguous in row major order
+ */
+template <typename T> template <typename A, typename> NDArray<T>::NDArray(const A &arr)
+{
+	static_assert(std::is_same<typename std::remove_all_extents<A>::type, T>::value, "NDArray element type doesn't match the array");
+
+	nd_shape<A>(this->shape);
+	this->strides.resize(this->shape.size());
+	nd_strides(this->shape, this->strides.data());
+	const T *first = reinterpret_cast<const T *>(&arr);
+	this->elements.assign(first, first + nd_size(this->shape));
+}
+
+/*
+ * reshape: changes the shape of the array. Elements past the end of the new
+ *		shape are dropped, and new ones are value initialized
+ */
+template <typename T> void NDArray<T>::reshape(std::vector<size_t> shape)
+{
+	this->shape = shape;
+	this->strides.resize(shape.size());
+	nd_strides(this->shape, this->strides.data());
+	this->elements.resize(nd_size(shape));
+}
+
+/*
+ * offset: offset of the element at one index per dimension, computed from
+ *		the stored strides. Throws an error if the number of indices doesn't
+ *		match the rank
+ */
+template <typename T> template <typename ...Is> size_t NDArray<T>::offset(Is... idx) const
+{
+	nd_checkrank("NDArray", sizeof...(Is), this->rank());
+	return nd_offset(this->strides.data(), idx...);
+}
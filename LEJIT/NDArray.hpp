@@ -0,0 +1,171 @@
+/*
+ * 	 _____     ________     _____  _____  _________  
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  | 
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_| 
+ * 	  | |   _   |  _| _  _   | |    | |      | |     
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_    
+ *	|________||________|`.____.'  |_____|  |_____|   
+ *                                                 
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * Dylan Everingham 08/26/2016
+ * NDArray.hpp
+ *
+ * Interface for the flat N-dimensional array type used by array parameters
+ * of any rank, and the view used to index into it
+ *
+ */
+
+#ifndef NDARRAY_H
+#define NDARRAY_H
+
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+
+/*
+ * nd_offset: offset in elements of the element at the given indices, one per
+ *		stride. Expands to a sum of products without a loop
+ */
+inline size_t nd_offset(const size_t *) { return 0; }
+template <typename I, typename ...Is> inline size_t nd_offset(const size_t *strides, I i, Is... rest)
+{
+	return (size_t) i * strides[0] + nd_offset(strides + 1, rest...);
+}
+
+/*
+ * NDView: non-owning view of a row major N-dimensional array, in the spirit
+ *		of std::mdspan. Indexing with fewer indices than the rank is not
+ *		allowed, use operator[] to take a slice instead
+ */
+template <typename T>
+class NDView {
+private:
+	// First element
+	T *ptr;
+
+	// Extent of each dimension, and the distance in elements between
+	// consecutive indices along it
+	std::vector<size_t> shape;
+	std::vector<size_t> strides;
+
+public:
+	NDView(T *ptr, std::vector<size_t> shape);
+
+	// Getters for the shape
+	size_t rank() const { return this->shape.size(); }
+	size_t extent(size_t dim) const { return this->shape[dim]; }
+	size_t stride(size_t dim) const { return this->strides[dim]; }
+	const std::vector<size_t> &getShape() const { return this->shape; }
+
+	// Total number of elements
+	size_t size() const;
+
+	// Pointer to the contiguous elements
+	T *data() const { return this->ptr; }
+
+	// Gets the element at one index per dimension
+	template <typename ...Is> T &operator()(Is... idx) const;
+
+	// Gets the view of rank one lower at index i of the first dimension
+	NDView<T> operator[](size_t i) const;
+};
+
+/*
+ * NDFixedView: non-owning view of a row major array whose rank N is known at
+ *		compile time. The strides live in the view, and the number of
+ *		indices is checked when compiling, so indexing is a few multiply-adds
+ */
+template <typename T, size_t N>
+class NDFixedView {
+private:
+	// First element
+	T *ptr;
+
+	// Extent of each dimension, and the distance in elements between
+	// consecutive indices along it
+	size_t shape[N];
+	size_t strides[N];
+
+public:
+	NDFixedView(T *ptr, const std::vector<size_t> &shape);
+
+	// Getters for the shape
+	static constexpr size_t rank() { return N; }
+	size_t extent(size_t dim) const { return this->shape[dim]; }
+	size_t stride(size_t dim) const { return this->strides[dim]; }
+
+	// Pointer to the contiguous elements
+	T *data() const { return this->ptr; }
+
+	// Gets the element at one index per dimension
+	template <typename ...Is> T &operator()(Is... idx) const
+	{
+		static_assert(sizeof...(Is) == N, "NDFixedView must be indexed with one index per dimension");
+		return this->ptr[nd_offset(this->strides, idx...)];
+	}
+};
+
+/*
+ * NDArray: row major N-dimensional array stored in one contiguous block, with
+ *		its shape. Used as the value of array parameters of any rank
+ */
+template <typename T>
+class NDArray {
+private:
+	// Extent of each dimension, and the distance in elements between
+	// consecutive indices along it
+	std::vector<size_t> shape;
+	std::vector<size_t> strides;
+
+	// Elements in row major order
+	std::vector<T> elements;
+
+	// Offset of the element at one index per dimension
+	template <typename ...Is> size_t offset(Is... idx) const;
+
+public:
+	// Constructors
+	NDArray() {}
+	NDArray(std::vector<size_t> shape, T fill = T());
+	NDArray(std::vector<size_t> shape, std::vector<T> elements);
+
+	// Constructor copying a C-style array of any rank, e.g. double[2][3][4]
+	template <typename A, typename = typename std::enable_if<std::is_array<A>::value>::type> NDArray(const A &arr);
+
+	// Getters for the shape
+	size_t rank() const { return this->shape.size(); }
+	size_t extent(size_t dim) const { return this->shape[dim]; }
+	size_t stride(size_t dim) const { return this->strides[dim]; }
+	const std::vector<size_t> &getShape() const { return this->shape; }
+
+	// Total number of elements
+	size_t size() const { return this->elements.size(); }
+
+	// Pointer to the contiguous elements
+	T *data() { return this->elements.data(); }
+	const T *data() const { return this->elements.data(); }
+
+	// Changes the shape, keeping elements in row major order where they fit
+	void reshape(std::vector<size_t> shape);
+
+	// Gets a view of the whole array
+	NDView<T> view() { return NDView<T>(this->data(), this->shape); }
+	NDView<const T> view() const { return NDView<const T>(this->data(), this->shape); }
+
+	// Gets a view of the whole array for indexing with a rank fixed at
+	// compile time. Throws an error if the array has a different rank
+	template <size_t N> NDFixedView<T, N> view() { return NDFixedView<T, N>(this->data(), this->shape); }
+	template <size_t N> NDFixedView<const T, N> view() const { return NDFixedView<const T, N>(this->data(), this->shape); }
+
+	// Gets the element at one index per dimension
+	template <typename ...Is> T &operator()(Is... idx) { return this->elements[this->offset(idx...)]; }
+	template <typename ...Is> const T &operator()(Is... idx) const { return this->elements[this->offset(idx...)]; }
+
+	bool operator==(const NDArray<T> &other) const { return this->shape == other.shape && this->elements == other.elements; }
+};
+
+#endif
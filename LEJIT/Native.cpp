@@ -0,0 +1,1267 @@
+/*
+ * 	 _____     ________     _____  _____  _________  
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  | 
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_| 
+ * 	  | |   _   |  _| _  _   | |    | |      | |     
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_    
+ *	|________||________|`.____.'  |_____|  |_____|   
+ *                                                 
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * Dylan Everingham 08/26/2016
+ * Native.cpp
+ *
+ * Implementation of LEJIT's native tier, which translates function parameters
+ * written in a numeric subset of Lua to C, and compiles and loads them at
+ * runtime
+ *
+ */
+
+#include "Native.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <map>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+
+/*
+ * NativeToken: token of Lua source. Keywords are names
+ */
+struct NativeToken {
+	enum Kind { NAME, NUMBER, STRING, OP, END } kind;
+	std::string text;
+	int line;
+};
+
+/*
+ * NativeLexer: splits Lua source into tokens, starting at a given line
+ */
+class NativeLexer {
+private:
+	// Source being split and the position and line of the next character
+	const std::string &src;
+	size_t pos;
+	int line;
+
+	// Skips a long bracket [[ ... ]] or [==[ ... ]==] starting at pos, returns
+	// false if there is none
+	bool skipLongBracket();
+
+public:
+	// Constructor
+	NativeLexer(const std::string &src, int line);
+
+	// Gets the next token
+	NativeToken next();
+};
+
+NativeLexer::NativeLexer(const std::string &src, int line) : src(src), pos(0), line(1)
+{
+	while (this->line < line && this->pos < src.size()) {
+		if (src[this->pos++] == '\n') {
+			this->line++;
+		}
+	}
+}
+
+bool NativeLexer::skipLongBracket()
+{
+	size_t level = 0;
+	while (this->pos + 1 + level < this->src.size() && this->src[this->pos + 1 + level] == '=') {
+		level++;
+	}
+	if (this->src[this->pos] != '[' || this->pos + 1 + level >= this->src.size() || this->src[this->pos + 1 + level] != '[') {
+		return false;
+	}
+
+	std::string close = "]" + std::string(level, '=') + "]";
+	size_t end = this->src.find(close, this->pos);
+	end = (end == std::string::npos) ? this->src.size() : end + close.size();
+	for (; this->pos < end; this->pos++) {
+		this->line += (this->src[this->pos] == '\n');
+	}
+	return true;
+}
+
+NativeToken NativeLexer::next()
+{
+	const std::string &s = this->src;
+
+	// Skip whitespace and comments
+	while (this->pos < s.size()) {
+		if (isspace(s[this->pos])) {
+			this->line += (s[this->pos++] == '\n');
+		}
+		else if (s.compare(this->pos, 2, "--") == 0) {
+			this->pos += 2;
+			if (!this->skipLongBracket()) {
+				while (this->pos < s.size() && s[this->pos] != '\n') {
+					this->pos++;
+				}
+			}
+		}
+		else {
+			break;
+		}
+	}
+
+	NativeToken tok;
+	tok.line = this->line;
+	if (this->pos >= s.size()) {
+		tok.kind = NativeToken::END;
+		return tok;
+	}
+
+	size_t start = this->pos;
+	char c = s[this->pos];
+
+	// Number, including hexadecimal numbers and exponents
+	if (isdigit(c) || (c == '.' && this->pos + 1 < s.size() && isdigit(s[this->pos + 1]))) {
+		while (this->pos < s.size() && (isalnum(s[this->pos]) || s[this->pos] == '.' || s[this->pos] == '_'
+		|| ((s[this->pos] == '+' || s[this->pos] == '-') && (s[this->pos - 1] == 'e' || s[this->pos - 1] == 'E')))) {
+			this->pos++;
+		}
+		tok.kind = NativeToken::NUMBER;
+	}
+
+	// Name or keyword
+	else if (isalpha(c) || c == '_') {
+		while (this->pos < s.size() && (isalnum(s[this->pos]) || s[this->pos] == '_')) {
+			this->pos++;
+		}
+		tok.kind = NativeToken::NAME;
+	}
+
+	// Quoted or long string
+	else if (c == '"' || c == '\'') {
+		this->pos++;
+		while (this->pos < s.size() && s[this->pos] != c && s[this->pos] != '\n') {
+			this->pos += (s[this->pos] == '\\') ? 2 : 1;
+		}
+		this->pos++;
+		tok.kind = NativeToken::STRING;
+	}
+	else if (c == '[' && this->skipLongBracket()) {
+		tok.kind = NativeToken::STRING;
+	}
+
+	// Operator
+	else {
+		static const char *ops[] = { "...", "..", "==", "~=", "<=", ">=", "::" };
+		this->pos++;
+		for (const char *op : ops) {
+			if (s.compare(start, strlen(op), op) == 0) {
+				this->pos = start + strlen(op);
+				break;
+			}
+		}
+		tok.kind = NativeToken::OP;
+	}
+
+	tok.text = s.substr(start, this->pos - start);
+	return tok;
+}
+
+/*
+ * NativeType: type of a value in a translated function. Integers are used
+ *		for int arguments and for loop counters and literals, and are
+ *		converted to doubles wherever Lua would give a different result
+ */
+enum NativeType { NATIVE_INT, NATIVE_NUM, NATIVE_BOOL, NATIVE_ARRAY };
+
+/*
+ * NativeExpr: C expression translated from a Lua expression
+ */
+struct NativeExpr {
+	NativeType type;
+	std::string code;
+
+	// Element type and index of the first element of arrays
+	char elem;
+	int base;
+
+	// Whether the expression is a number known at translation time, and its value
+	bool constant;
+	double value;
+};
+
+/*
+ * NativeVar: C variable standing in for a Lua local variable or argument
+ */
+struct NativeVar {
+	NativeType type;
+	std::string name;
+
+	// Whether Lua code may assign to it, false for loop counters and arrays
+	bool assignable;
+
+	// Element type ('i', 'd' or 'b') and index of the first element of arrays
+	char elem;
+	int base;
+};
+
+/*
+ * NativeTarget: left hand side of an assignment
+ */
+struct NativeTarget {
+	NativeVar var;
+
+	// Name of the variable in Lua, for error messages
+	std::string name;
+
+	// Index of the element assigned to for arrays
+	std::string index;
+};
+
+/*
+ * NativeTranslator: recursive descent parser of a Lua function, emitting
+ *		the equivalent C function as it goes. Throws std::runtime_error on
+ *		anything outside of the supported subset
+ */
+class NativeTranslator {
+private:
+	// Tokens of the function and the current token
+	NativeLexer lex;
+	NativeToken tok;
+
+	// Line the function is defined on
+	int line;
+
+	// Kind of each argument ('i', 'd', 'b', 'a' or 'c'), element type of
+	// array arguments, and number of inparams
+	std::string kinds, elems;
+	int num_in;
+
+	// Gets numbers read from outside the function
+	std::function<bool(const std::string &, double &)> lookup;
+
+	// Local variables in scope, innermost block last
+	std::vector<std::map<std::string, NativeVar>> scopes;
+
+	// Body of the C function, its indentation and the number of loops the
+	// current statement is in
+	std::string body;
+	int indent;
+	int loops;
+
+	// Counter used to give every variable a unique name
+	int counter;
+
+	void fail(std::string msg) { throw std::runtime_error("line " + std::to_string(this->tok.line) + ": " + msg); }
+	void advance() { this->tok = this->lex.next(); }
+	bool check(const char *text) { return (this->tok.kind == NativeToken::OP || this->tok.kind == NativeToken::NAME) && this->tok.text == text; }
+	bool accept(const char *text) { if (!this->check(text)) return false; this->advance(); return true; }
+	void expect(const char *text);
+	std::string name();
+	void emit(std::string line) { this->body += std::string(this->indent, '\t') + line + "\n"; }
+
+	// Declares a local variable in the innermost scope, returns its C name
+	std::string declare(std::string name, NativeType type, bool assignable = true, char elem = 0, int base = 0);
+	NativeVar *find(const std::string &name);
+
+	// Statements
+	bool blockEnd();
+	bool block();
+	bool statement();
+	bool ifStatement();
+	void forStatement();
+	void localStatement();
+	void returnStatement();
+	void assignment();
+
+	// Expressions
+	NativeExpr expr(int limit = 0);
+	NativeExpr simpleExpr();
+	NativeExpr nameExpr();
+	NativeExpr mathExpr();
+	NativeExpr binary(std::string op, NativeExpr a, NativeExpr b);
+	std::string index(const NativeVar &var);
+	NativeExpr number(double value);
+	void numeric(const NativeExpr &e, const char *what);
+
+public:
+	// Constructor
+	NativeTranslator(const std::string &source, int line, std::string signature, std::function<bool(const std::string &, double &)> lookup);
+
+	// Translates the function, returns the C file
+	std::string translate();
+};
+
+NativeTranslator::NativeTranslator(const std::string &source, int line, std::string signature, std::function<bool(const std::string &, double &)> lookup)
+	: lex(source, line), line(line), num_in(-1), lookup(lookup), indent(1), loops(0), counter(0)
+{
+	this->tok.kind = NativeToken::END;
+	this->tok.line = line;
+
+	const char *sig = signature.c_str();
+	while (*sig) {
+		char c = *sig++;
+		switch (c) {
+			case 'i':
+			case 'd':
+			case 'b':
+				this->kinds += c;
+				this->elems += c;
+				break;
+			case 'a':
+			case 'c':
+				if (*sig != 'i' && *sig != 'd' && *sig != 'b') {
+					this->fail("invalid signature '" + signature + "'");
+				}
+				this->kinds += c;
+				this->elems += *sig++;
+				while (isdigit(*sig)) {
+					sig++;
+				}
+				break;
+			case '>':
+				this->num_in = this->kinds.size();
+				break;
+			default:
+				this->fail("invalid signature '" + signature + "'");
+		}
+	}
+	if (this->num_in < 0) {
+		this->num_in = this->kinds.size();
+	}
+	for (size_t i = this->num_in; i < this->kinds.size(); i++) {
+		if (this->kinds[i] != this->elems[i]) {
+			this->fail("array outparams are not supported");
+		}
+	}
+}
+
+void NativeTranslator::expect(const char *text)
+{
+	if (!this->accept(text)) {
+		this->fail(std::string("'") + text + "' expected near '" + this->tok.text + "'");
+	}
+}
+
+std::string NativeTranslator::name()
+{
+	static const char *keywords[] = { "and", "break", "do", "else", "elseif", "end", "false", "for", "function", "goto", "if",
+		"in", "local", "nil", "not", "or", "repeat", "return", "then", "true", "until", "while" };
+
+	if (this->tok.kind != NativeToken::NAME) {
+		this->fail("name expected near '" + this->tok.text + "'");
+	}
+	for (const char *keyword : keywords) {
+		if (this->tok.text == keyword) {
+			this->fail("name expected near '" + this->tok.text + "'");
+		}
+	}
+	std::string name = this->tok.text;
+	this->advance();
+	return name;
+}
+
+std::string NativeTranslator::declare(std::string name, NativeType type, bool assignable, char elem, int base)
+{
+	NativeVar var = { type, "v" + std::to_string(++this->counter) + "_" + name, assignable, elem, base };
+	this->scopes.back()[name] = var;
+	return var.name;
+}
+
+NativeVar *NativeTranslator::find(const std::string &name)
+{
+	for (auto scope = this->scopes.rbegin(); scope != this->scopes.rend(); scope++) {
+		auto it = scope->find(name);
+		if (it != scope->end()) {
+			return &it->second;
+		}
+	}
+	return nullptr;
+}
+
+/*
+ * translate: parses the function header on the given line and the body up to
+ *		its end, and returns the C file
+ */
+std::string NativeTranslator::translate()
+{
+	// Find the function keyword, either in function f(...) or f = function(...)
+	this->advance();
+	while (this->tok.kind != NativeToken::END && this->tok.line == this->line && !this->check("function")) {
+		this->advance();
+	}
+	if (!this->accept("function")) {
+		this->fail("no function definition found");
+	}
+	if (this->tok.kind == NativeToken::NAME) {
+		this->name();
+		while (this->accept(".")) {
+			this->name();
+		}
+		if (this->check(":")) {
+			this->fail("methods are not supported");
+		}
+	}
+
+	// Arguments, copied into locals so the function may assign to them
+	std::string params;
+	this->scopes.emplace_back();
+	for (size_t i = 0; i < this->kinds.size(); i++) {
+		static const std::map<char, std::string> ctypes = { { 'i', "int" }, { 'd', "double" }, { 'b', "_Bool" } };
+		std::string ctype = ctypes.at(this->elems[i]);
+		std::string arg = "a" + std::to_string(i);
+		params += (i ? ", " : "") + ctype + ((int) i < this->num_in && this->kinds[i] == this->elems[i] ? " " : " *") + arg;
+	}
+
+	this->expect("(");
+	int num_params = 0;
+	while (!this->check(")")) {
+		if (num_params && !this->accept(",")) {
+			this->fail("')' expected near '" + this->tok.text + "'");
+		}
+		if (this->check("...")) {
+			this->fail("varargs are not supported");
+		}
+		std::string param = this->name();
+		if (num_params >= this->num_in) {
+			this->fail("the function has more parameters than the signature has inparams");
+		}
+
+		std::string arg = "a" + std::to_string(num_params);
+		switch (this->kinds[num_params]) {
+			case 'i':
+				this->emit("long long " + this->declare(param, NATIVE_INT) + " = " + arg + ";");
+				break;
+			case 'd':
+				this->emit("double " + this->declare(param, NATIVE_NUM) + " = " + arg + ";");
+				break;
+			case 'b':
+				this->emit("int " + this->declare(param, NATIVE_BOOL) + " = " + arg + ";");
+				break;
+			default:
+				// Userdata arrays are indexed from 1, FFI cdata from 0
+				this->scopes.back()[param] = { NATIVE_ARRAY, arg, false, this->elems[num_params], this->kinds[num_params] == 'a' };
+		}
+		num_params++;
+	}
+	this->advance();
+
+	bool returns = this->block();
+	if (this->num_in < (int) this->kinds.size() && !returns) {
+		this->fail("the function may end without returning its results");
+	}
+	this->expect("end");
+
+	std::string code = "#include <math.h>\n\n";
+	code += "static inline double lejit_mod(double a, double b) { return a - floor(a / b) * b; }\n";
+	code += "static inline double lejit_min(double a, double b) { return b < a ? b : a; }\n";
+	code += "static inline double lejit_max(double a, double b) { return b > a ? b : a; }\n";
+	code += "static inline double lejit_deg(double x) { return x * (180.0 / 3.14159265358979323846); }\n";
+	code += "static inline double lejit_rad(double x) { return x * (3.14159265358979323846 / 180.0); }\n\n";
+	code += "void " NATIVE_SYMBOL "(" + params + ")\n{\n" + this->body + "}\n";
+	return code;
+}
+
+bool NativeTranslator::blockEnd()
+{
+	return this->tok.kind == NativeToken::END || this->check("end") || this->check("else") || this->check("elseif") || this->check("until");
+}
+
+/*
+ * block: translates statements up to the end of the block, returns true if
+ *		the block always returns. Callers open its scope
+ */
+bool NativeTranslator::block()
+{
+	bool returns = false;
+	while (!this->blockEnd()) {
+		if (this->check("return")) {
+			this->returnStatement();
+			return true;
+		}
+		returns = this->statement();
+	}
+	return returns;
+}
+
+/*
+ * statement: translates one statement, returns true if it always returns
+ */
+bool NativeTranslator::statement()
+{
+	if (this->accept(";")) {
+		return false;
+	}
+	else if (this->check("if")) {
+		return this->ifStatement();
+	}
+	else if (this->accept("while")) {
+		NativeExpr cond = this->expr();
+		if (cond.type != NATIVE_BOOL) {
+			this->fail("while conditions must be comparisons or booleans");
+		}
+		this->expect("do");
+		this->emit("while (" + cond.code + ") {");
+		this->indent++;
+		this->loops++;
+		this->scopes.emplace_back();
+		this->block();
+		this->scopes.pop_back();
+		this->loops--;
+		this->indent--;
+		this->expect("end");
+		this->emit("}");
+	}
+	else if (this->accept("repeat")) {
+		// The condition can see locals of the body
+		this->emit("for (;;) {");
+		this->indent++;
+		this->loops++;
+		this->scopes.emplace_back();
+		this->block();
+		this->expect("until");
+		NativeExpr cond = this->expr();
+		if (cond.type != NATIVE_BOOL) {
+			this->fail("until conditions must be comparisons or booleans");
+		}
+		this->emit("if (" + cond.code + ") break;");
+		this->scopes.pop_back();
+		this->loops--;
+		this->indent--;
+		this->emit("}");
+	}
+	else if (this->accept("do")) {
+		this->emit("{");
+		this->indent++;
+		this->scopes.emplace_back();
+		bool returns = this->block();
+		this->scopes.pop_back();
+		this->indent--;
+		this->expect("end");
+		this->emit("}");
+		return returns;
+	}
+	else if (this->accept("for")) {
+		this->forStatement();
+	}
+	else if (this->accept("local")) {
+		this->localStatement();
+	}
+	else if (this->accept("break")) {
+		if (!this->loops) {
+			this->fail("break outside of a loop");
+		}
+		this->emit("break;");
+	}
+	else if (this->check("function")) {
+		this->fail("nested functions are not supported");
+	}
+	else if (this->check("goto") || this->check("::")) {
+		this->fail("goto is not supported");
+	}
+	else {
+		this->assignment();
+	}
+	return false;
+}
+
+/*
+ * ifStatement: translates an if statement, returns true if every branch
+ *		returns and there is an else branch
+ */
+bool NativeTranslator::ifStatement()
+{
+	bool returns = true;
+	std::string open = "if (";
+	while (this->accept(open == "if (" ? "if" : "elseif")) {
+		NativeExpr cond = this->expr();
+		if (cond.type != NATIVE_BOOL) {
+			this->fail("if conditions must be comparisons or booleans");
+		}
+		this->expect("then");
+		this->emit(open + cond.code + ") {");
+		this->indent++;
+		this->scopes.emplace_back();
+		returns = this->block() && returns;
+		this->scopes.pop_back();
+		this->indent--;
+		open = "} else if (";
+	}
+
+	if (this->accept("else")) {
+		this->emit("} else {");
+		this->indent++;
+		this->scopes.emplace_back();
+		returns = this->block() && returns;
+		this->scopes.pop_back();
+		this->indent--;
+	}
+	else {
+		returns = false;
+	}
+	this->expect("end");
+	this->emit("}");
+	return returns;
+}
+
+/*
+ * forStatement: translates a numeric for loop. The limit and step are
+ *		evaluated once before the loop, as in Lua, and the counter is an
+ *		integer if the start and step are
+ */
+void NativeTranslator::forStatement()
+{
+	std::string var = this->name();
+	if (this->check(",") || this->check("in")) {
+		this->fail("generic for loops are not supported");
+	}
+	this->expect("=");
+	NativeExpr start = this->expr();
+	this->expect(",");
+	NativeExpr limit = this->expr();
+	NativeExpr step = this->number(1);
+	if (this->accept(",")) {
+		step = this->expr();
+	}
+	this->numeric(start, "for loop start");
+	this->numeric(limit, "for loop limit");
+	this->numeric(step, "for loop step");
+	this->expect("do");
+
+	std::string ctype = (start.type == NATIVE_INT && step.type == NATIVE_INT) ? "long long" : "double";
+	std::string id = std::to_string(++this->counter);
+	std::string lim = "v" + id + "_limit";
+	std::string st = "v" + id + "_step";
+
+	this->emit("{");
+	this->indent++;
+	this->emit((limit.type == NATIVE_INT ? "long long " : "double ") + lim + " = " + limit.code + ";");
+	if (!step.constant) {
+		this->emit(ctype + " " + st + " = " + step.code + ";");
+	}
+
+	this->scopes.emplace_back();
+	std::string counter = this->declare(var, ctype == "double" ? NATIVE_NUM : NATIVE_INT, false);
+
+	// A constant step fixes the direction of the loop, leaving a plain
+	// comparison compilers can vectorize around
+	std::string cond = "(" + st + " > 0 ? " + counter + " <= " + lim + " : " + counter + " >= " + lim + ")";
+	if (step.constant) {
+		cond = counter + (step.value > 0 ? " <= " : " >= ") + lim;
+		st = step.code;
+	}
+	this->emit("for (" + ctype + " " + counter + " = " + start.code + "; " + cond + "; " + counter + " += " + st + ") {");
+	this->indent++;
+	this->loops++;
+	this->block();
+	this->loops--;
+	this->indent--;
+	this->scopes.pop_back();
+	this->expect("end");
+	this->emit("}");
+	this->indent--;
+	this->emit("}");
+}
+
+/*
+ * localStatement: translates a declaration of locals. Every value is
+ *		evaluated before the locals come into scope, as in Lua. Locals
+ *		declared without a value start at 0
+ */
+void NativeTranslator::localStatement()
+{
+	if (this->check("function")) {
+		this->fail("nested functions are not supported");
+	}
+
+	std::vector<std::string> names;
+	do {
+		names.push_back(this->name());
+	} while (this->accept(","));
+
+	std::vector<NativeExpr> values;
+	if (this->accept("=")) {
+		do {
+			values.push_back(this->expr());
+		} while (this->accept(","));
+		if (values.size() != names.size()) {
+			this->fail("locals must be declared with one value each");
+		}
+	}
+
+	for (size_t i = 0; i < names.size(); i++) {
+		if (values.empty()) {
+			this->emit("double " + this->declare(names[i], NATIVE_NUM) + " = 0;");
+			continue;
+		}
+
+		NativeExpr &value = values[i];
+		if (value.type == NATIVE_ARRAY) {
+			// Another name for an array argument
+			static const std::map<char, std::string> ctypes = { { 'i', "int *" }, { 'd', "double *" }, { 'b', "_Bool *" } };
+			this->emit(ctypes.at(value.elem) + this->declare(names[i], NATIVE_ARRAY, false, value.elem, value.base) + " = " + value.code + ";");
+		}
+		else if (value.type == NATIVE_BOOL) {
+			this->emit("int " + this->declare(names[i], NATIVE_BOOL) + " = " + value.code + ";");
+		}
+		else {
+			this->emit("double " + this->declare(names[i], NATIVE_NUM) + " = " + value.code + ";");
+		}
+	}
+}
+
+/*
+ * returnStatement: translates a return statement into stores to the
+ *		outparams. Values are evaluated before any is stored, in case an
+ *		outparam points into an array argument
+ */
+void NativeTranslator::returnStatement()
+{
+	this->expect("return");
+	std::vector<NativeExpr> values;
+	if (!this->blockEnd() && !this->check(";")) {
+		do {
+			values.push_back(this->expr());
+		} while (this->accept(","));
+	}
+	this->accept(";");
+	if (!this->blockEnd()) {
+		this->fail("'end' expected after return");
+	}
+
+	size_t num_out = this->kinds.size() - this->num_in;
+	if (values.size() < num_out) {
+		this->fail("the function returns fewer values than the signature has outparams");
+	}
+
+	std::vector<std::string> results;
+	for (size_t i = 0; i < num_out; i++) {
+		NativeExpr &value = values[i];
+		char kind = this->kinds[this->num_in + i];
+		if (kind == 'b' && value.type != NATIVE_BOOL) {
+			this->fail("bool outparams must be returned comparisons or booleans");
+		}
+		if (kind != 'b') {
+			this->numeric(value, "int and double outparams");
+		}
+		results.push_back(kind == 'i' ? "(int) (" + value.code + ")" : value.code);
+	}
+
+	if (num_out == 1) {
+		this->emit("*a" + std::to_string(this->num_in) + " = " + results[0] + ";");
+	}
+	else if (num_out > 1) {
+		this->emit("{");
+		this->indent++;
+		for (size_t i = 0; i < num_out; i++) {
+			std::string ctype = (this->kinds[this->num_in + i] == 'i') ? "int" : (this->kinds[this->num_in + i] == 'd') ? "double" : "_Bool";
+			this->emit(ctype + " r" + std::to_string(i) + " = " + results[i] + ";");
+		}
+		for (size_t i = 0; i < num_out; i++) {
+			this->emit("*a" + std::to_string(this->num_in + i) + " = r" + std::to_string(i) + ";");
+		}
+		this->indent--;
+		this->emit("}");
+	}
+	this->emit("return;");
+}
+
+/*
+ * assignment: translates an assignment to locals, arguments or elements of
+ *		array arguments. With several targets, array indices and then values
+ *		are evaluated into temporaries before anything is assigned
+ */
+void NativeTranslator::assignment()
+{
+	std::vector<NativeTarget> targets;
+	do {
+		if (this->tok.kind != NativeToken::NAME) {
+			this->fail("unexpected '" + this->tok.text + "'");
+		}
+		std::string target = this->name();
+		NativeVar *var = this->find(target);
+		if (!var) {
+			if (this->check("(") || this->check(":") || this->check(".") || this->tok.kind == NativeToken::STRING || this->check("{")) {
+				this->fail("function calls are not supported as statements");
+			}
+			this->fail("assignment to global '" + target + "' is not supported");
+		}
+		if (this->check("(") || this->check(":") || this->check(".")) {
+			this->fail("'" + target + "' is not a function or table");
+		}
+
+		NativeTarget t = { *var, target, "" };
+		if (var->type == NATIVE_ARRAY && this->accept("[")) {
+			t.index = this->index(*var);
+			this->expect("]");
+		}
+		else if (!var->assignable) {
+			this->fail("'" + target + "' can't be assigned to");
+		}
+		targets.push_back(t);
+	} while (this->accept(","));
+
+	this->expect("=");
+	std::vector<NativeExpr> values;
+	do {
+		values.push_back(this->expr());
+	} while (this->accept(","));
+	if (values.size() != targets.size()) {
+		this->fail("assignments must have one value for each target");
+	}
+
+	std::vector<std::string> lhs, rhs;
+	for (size_t i = 0; i < targets.size(); i++) {
+		NativeTarget &t = targets[i];
+		NativeExpr &value = values[i];
+		NativeType type = t.index.empty() ? t.var.type : (t.var.elem == 'b') ? NATIVE_BOOL : NATIVE_NUM;
+
+		if (type == NATIVE_BOOL && value.type != NATIVE_BOOL) {
+			this->fail("'" + t.name + "' can only be assigned comparisons or booleans");
+		}
+		if (type == NATIVE_INT && value.type != NATIVE_INT) {
+			this->fail("int argument '" + t.name + "' can only be assigned integers");
+		}
+		if (type == NATIVE_NUM) {
+			this->numeric(value, "numeric variables");
+		}
+
+		lhs.push_back(t.index.empty() ? t.var.name : t.var.name + "[" + t.index + "]");
+		rhs.push_back((!t.index.empty() && t.var.elem == 'i') ? "(int) (" + value.code + ")" : value.code);
+	}
+
+	if (targets.size() == 1) {
+		this->emit(lhs[0] + " = " + rhs[0] + ";");
+		return;
+	}
+
+	this->emit("{");
+	this->indent++;
+	for (size_t i = 0; i < targets.size(); i++) {
+		if (!targets[i].index.empty()) {
+			std::string tmp = "i" + std::to_string(i);
+			this->emit("long long " + tmp + " = " + targets[i].index + ";");
+			lhs[i] = targets[i].var.name + "[" + tmp + "]";
+		}
+	}
+	for (size_t i = 0; i < targets.size(); i++) {
+		NativeType type = values[i].type == NATIVE_BOOL ? NATIVE_BOOL : NATIVE_NUM;
+		this->emit((type == NATIVE_BOOL ? "int t" : "double t") + std::to_string(i) + " = " + rhs[i] + ";");
+	}
+	for (size_t i = 0; i < targets.size(); i++) {
+		this->emit(lhs[i] + " = t" + std::to_string(i) + ";");
+	}
+	this->indent--;
+	this->emit("}");
+}
+
+/*
+ * Priorities of binary operators on their left and right, as in Lua
+ */
+static const std::map<std::string, std::pair<int, int>> native_priority = {
+	{ "or", { 1, 1 } }, { "and", { 2, 2 } },
+	{ "<", { 3, 3 } }, { "<=", { 3, 3 } }, { ">", { 3, 3 } }, { ">=", { 3, 3 } }, { "==", { 3, 3 } }, { "~=", { 3, 3 } },
+	{ "..", { 5, 4 } }, { "+", { 6, 6 } }, { "-", { 6, 6 } },
+	{ "*", { 7, 7 } }, { "/", { 7, 7 } }, { "%", { 7, 7 } }, { "^", { 10, 9 } }
+};
+
+// Priority of unary operators
+#define NATIVE_UNARY_PRIORITY 8
+
+/*
+ * expr: translates an expression whose binary operators bind tighter than
+ *		limit
+ */
+NativeExpr NativeTranslator::expr(int limit)
+{
+	NativeExpr e;
+	if (this->accept("-")) {
+		e = this->expr(NATIVE_UNARY_PRIORITY);
+		this->numeric(e, "unary minus");
+		e = e.constant ? this->number(-e.value) : NativeExpr { e.type, "(-" + e.code + ")" };
+	}
+	else if (this->accept("not")) {
+		e = this->expr(NATIVE_UNARY_PRIORITY);
+		if (e.type != NATIVE_BOOL) {
+			this->fail("not is only supported on comparisons and booleans");
+		}
+		e.code = "(!" + e.code + ")";
+	}
+	else if (this->check("#")) {
+		this->fail("the length operator is not supported");
+	}
+	else {
+		e = this->simpleExpr();
+	}
+
+	while (this->tok.kind == NativeToken::OP || this->tok.kind == NativeToken::NAME) {
+		auto op = native_priority.find(this->tok.text);
+		if (op == native_priority.end() || op->second.first <= limit) {
+			break;
+		}
+		this->advance();
+		NativeExpr rhs = this->expr(op->second.second);
+		e = this->binary(op->first, e, rhs);
+	}
+	return e;
+}
+
+/*
+ * binary: translates a binary operation. Division and exponentiation are
+ *		always done on doubles, and modulo is floored, as in Lua
+ */
+NativeExpr NativeTranslator::binary(std::string op, NativeExpr a, NativeExpr b)
+{
+	if (op == "and" || op == "or") {
+		if (a.type != NATIVE_BOOL || b.type != NATIVE_BOOL) {
+			this->fail(op + " is only supported on comparisons and booleans");
+		}
+		return { NATIVE_BOOL, "(" + a.code + (op == "and" ? " && " : " || ") + b.code + ")" };
+	}
+	if (op == "==" || op == "~=") {
+		if ((a.type == NATIVE_BOOL) != (b.type == NATIVE_BOOL) || a.type == NATIVE_ARRAY || b.type == NATIVE_ARRAY) {
+			this->fail("only numbers or booleans can be compared for equality");
+		}
+		return { NATIVE_BOOL, "(" + a.code + (op == "==" ? " == " : " != ") + b.code + ")" };
+	}
+	if (op == "..") {
+		this->fail("strings are not supported");
+	}
+
+	this->numeric(a, "arithmetic and comparisons");
+	this->numeric(b, "arithmetic and comparisons");
+	if (op == "<" || op == "<=" || op == ">" || op == ">=") {
+		return { NATIVE_BOOL, "(" + a.code + " " + op + " " + b.code + ")" };
+	}
+	if (op == "/") {
+		return { NATIVE_NUM, "((double) " + a.code + " / " + b.code + ")" };
+	}
+	if (op == "%") {
+		return { NATIVE_NUM, "lejit_mod(" + a.code + ", " + b.code + ")" };
+	}
+	if (op == "^") {
+		return { NATIVE_NUM, "pow(" + a.code + ", " + b.code + ")" };
+	}
+	NativeType type = (a.type == NATIVE_INT && b.type == NATIVE_INT) ? NATIVE_INT : NATIVE_NUM;
+	return { type, "(" + a.code + " " + op + " " + b.code + ")" };
+}
+
+/*
+ * simpleExpr: translates a literal, a parenthesized expression, a variable,
+ *		an array element, or a math library call or constant
+ */
+NativeExpr NativeTranslator::simpleExpr()
+{
+	if (this->tok.kind == NativeToken::NUMBER) {
+		char *end;
+		double value = strtod(this->tok.text.c_str(), &end);
+		if (*end) {
+			this->fail("malformed number '" + this->tok.text + "'");
+		}
+		this->advance();
+		return this->number(value);
+	}
+	if (this->tok.kind == NativeToken::STRING) {
+		this->fail("strings are not supported");
+	}
+	if (this->accept("true")) {
+		return { NATIVE_BOOL, "1" };
+	}
+	if (this->accept("false")) {
+		return { NATIVE_BOOL, "0" };
+	}
+	if (this->check("nil")) {
+		this->fail("nil is not supported");
+	}
+	if (this->check("function")) {
+		this->fail("nested functions are not supported");
+	}
+	if (this->check("{")) {
+		this->fail("tables are not supported");
+	}
+	if (this->check("...")) {
+		this->fail("varargs are not supported");
+	}
+	if (this->accept("(")) {
+		NativeExpr e = this->expr();
+		this->expect(")");
+		e.code = "(" + e.code + ")";
+		return e;
+	}
+	return this->nameExpr();
+}
+
+/*
+ * nameExpr: translates a name. Locals and arguments become their variables,
+ *		other names the number they hold when the function is translated
+ */
+NativeExpr NativeTranslator::nameExpr()
+{
+	std::string name = this->name();
+	NativeVar *var = this->find(name);
+
+	if (var) {
+		if (this->check("(") || this->check(":") || this->check(".")) {
+			this->fail("'" + name + "' is not a function or table");
+		}
+		if (var->type != NATIVE_ARRAY) {
+			return { var->type, var->name };
+		}
+		if (!this->accept("[")) {
+			return { NATIVE_ARRAY, var->name, var->elem, var->base };
+		}
+		std::string idx = this->index(*var);
+		this->expect("]");
+		NativeType type = (var->elem == 'b') ? NATIVE_BOOL : (var->elem == 'i') ? NATIVE_INT : NATIVE_NUM;
+		return { type, var->name + "[" + idx + "]" };
+	}
+
+	if (name == "math" && this->accept(".")) {
+		return this->mathExpr();
+	}
+	if (this->check("(") || this->check(":") || this->tok.kind == NativeToken::STRING || this->check("{")) {
+		this->fail("calls to '" + name + "' are not supported, only calls to the math library are");
+	}
+	if (this->check("[") || this->check(".")) {
+		this->fail("tables are not supported");
+	}
+
+	double value;
+	if (!this->lookup(name, value)) {
+		this->fail("'" + name + "' is not a local or a number");
+	}
+	return this->number(value);
+}
+
+/*
+ * mathExpr: translates a call to a function of the math library, or one of
+ *		its constants
+ */
+NativeExpr NativeTranslator::mathExpr()
+{
+	// Name of each supported function in C, and its number of arguments.
+	// min and max take any number
+	static const std::map<std::string, std::pair<std::string, int>> functions = {
+		{ "abs", { "fabs", 1 } }, { "ceil", { "ceil", 1 } }, { "floor", { "floor", 1 } }, { "sqrt", { "sqrt", 1 } },
+		{ "exp", { "exp", 1 } }, { "log", { "log", 1 } }, { "log10", { "log10", 1 } },
+		{ "sin", { "sin", 1 } }, { "cos", { "cos", 1 } }, { "tan", { "tan", 1 } },
+		{ "asin", { "asin", 1 } }, { "acos", { "acos", 1 } }, { "atan", { "atan", 1 } }, { "atan2", { "atan2", 2 } },
+		{ "sinh", { "sinh", 1 } }, { "cosh", { "cosh", 1 } }, { "tanh", { "tanh", 1 } },
+		{ "pow", { "pow", 2 } }, { "fmod", { "fmod", 2 } }, { "min", { "lejit_min", 0 } }, { "max", { "lejit_max", 0 } },
+		{ "deg", { "lejit_deg", 1 } }, { "rad", { "lejit_rad", 1 } }
+	};
+
+	std::string member = this->name();
+	if (member == "pi") {
+		return this->number(3.14159265358979323846);
+	}
+	if (member == "huge") {
+		return this->number(HUGE_VAL);
+	}
+
+	auto function = functions.find(member);
+	if (function == functions.end() || !this->check("(")) {
+		this->fail("math." + member + " is not supported");
+	}
+	this->advance();
+
+	std::vector<NativeExpr> arguments;
+	while (!this->check(")")) {
+		if (!arguments.empty()) {
+			this->expect(",");
+		}
+		arguments.push_back(this->expr());
+		this->numeric(arguments.back(), "math library arguments");
+	}
+	this->advance();
+
+	int num_args = function->second.second;
+	if ((num_args && (int) arguments.size() != num_args) || arguments.empty()) {
+		this->fail("math." + member + " takes " + std::to_string(num_args ? num_args : 1) + (num_args ? "" : " or more") + " arguments");
+	}
+
+	// min and max fold their arguments from the left
+	if (!num_args) {
+		std::string code = arguments[0].code;
+		for (size_t i = 1; i < arguments.size(); i++) {
+			code = function->second.first + "(" + code + ", " + arguments[i].code + ")";
+		}
+		return { arguments.size() == 1 ? arguments[0].type : NATIVE_NUM, code };
+	}
+
+	std::string code = function->second.first + "(" + arguments[0].code;
+	for (size_t i = 1; i < arguments.size(); i++) {
+		code += ", " + arguments[i].code;
+	}
+	return { NATIVE_NUM, code + ")" };
+}
+
+/*
+ * index: translates an array index following '[' to a C index, truncated
+ *		to an integer as the array types do, and offset to start from 0
+ */
+std::string NativeTranslator::index(const NativeVar &var)
+{
+	NativeExpr idx = this->expr();
+	this->numeric(idx, "array indices");
+	std::string code = (idx.type == NATIVE_INT) ? idx.code : "(long long) " + idx.code;
+	return var.base ? code + " - " + std::to_string(var.base) : code;
+}
+
+/*
+ * number: translates a number to a literal, an integer one if the number is
+ *		an integer small enough to be exact as a double
+ */
+NativeExpr NativeTranslator::number(double value)
+{
+	NativeExpr e = { NATIVE_NUM, "", 0, 0, true, value };
+	char buf[32];
+	if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0 && (value != 0 || !std::signbit(value))) {
+		snprintf(buf, sizeof(buf), "%lldLL", (long long) value);
+		e.type = NATIVE_INT;
+		e.code = buf;
+	}
+	else if (std::isinf(value)) {
+		e.code = "HUGE_VAL";
+	}
+	else if (std::isnan(value)) {
+		e.code = "(0.0 / 0.0)";
+	}
+	else {
+		snprintf(buf, sizeof(buf), "%.17g", value);
+		e.code = buf;
+		if (e.code.find_first_of(".e") == std::string::npos) {
+			e.code += ".0";
+		}
+	}
+
+	if (std::signbit(value)) {
+		e.code = (e.code[0] == '-') ? "(" + e.code + ")" : "(-" + e.code + ")";
+	}
+	return e;
+}
+
+void NativeTranslator::numeric(const NativeExpr &e, const char *what)
+{
+	if (e.type != NATIVE_INT && e.type != NATIVE_NUM) {
+		this->fail(std::string(what) + " must be numbers");
+	}
+}
+
+/*
+ * native_translate: translates the Lua function defined on line of source
+ *		to C, see NativeTranslator
+ */
+bool native_translate(const std::string &source, int line, std::string signature, std::function<bool(const std::string &, double &)> lookup, std::string &code, std::string &error)
+{
+	try {
+		NativeTranslator translator(source, line, signature, lookup);
+		code = translator.translate();
+		return true;
+	}
+	catch (const std::runtime_error &e) {
+		error = e.what();
+		return false;
+	}
+}
+
+/*
+ * NativeCompiler constructor
+ */
+NativeCompiler::NativeCompiler(std::string command, std::string dir)
+{
+	this->command = command;
+	this->dir = dir;
+	this->hits = 0;
+	this->misses = 0;
+}
+
+/*
+ * load: loads the library compiled from code. Libraries are compiled to a
+ *		temporary name and renamed into the cache, so processes compiling the
+ *		same function at once never load a partially written library
+ */
+void *NativeCompiler::load(const std::string &code, std::shared_ptr<void> &handle, std::string &error)
+{
+	uint64_t hash = lua_hashstring(this->command + "\n" + code);
+	char key[32];
+	snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+
+	// Without a cache directory, the library is removed once it is loaded
+	std::string dir = this->dir;
+	if (dir.empty()) {
+		const char *tmp = getenv("TMPDIR");
+		dir = (tmp && *tmp) ? tmp : "/tmp";
+	}
+	std::string tmp = dir + "/native_" + key + "." + std::to_string((long) getpid());
+	std::string library = this->dir.empty() ? tmp + ".so" : dir + "/native_" + key + ".so";
+
+	struct stat st;
+	bool cached = !this->dir.empty() && stat(library.c_str(), &st) == 0;
+	if (cached) {
+		this->hits++;
+	}
+	else {
+		this->misses++;
+		mkdir(dir.c_str(), 0755);
+
+		std::string source_file = tmp + ".c";
+		std::ofstream out(source_file);
+		out << code;
+		out.close();
+		if (!out) {
+			remove(source_file.c_str());
+			error = "can't write " + source_file;
+			return nullptr;
+		}
+
+		// Collect the compiler's messages for the error
+		std::string output;
+		std::string cmd = this->command + " -o '" + tmp + ".so' '" + source_file + "' -lm 2>&1";
+		FILE *pipe = popen(cmd.c_str(), "r");
+		int status = -1;
+		if (pipe) {
+			char buf[256];
+			while (fgets(buf, sizeof(buf), pipe)) {
+				output += buf;
+			}
+			status = pclose(pipe);
+		}
+		remove(source_file.c_str());
+
+		if (status != 0) {
+			remove((tmp + ".so").c_str());
+			error = "'" + cmd + "' failed" + (output.empty() ? "" : ":\n" + output);
+			return nullptr;
+		}
+		if (library != tmp + ".so" && rename((tmp + ".so").c_str(), library.c_str()) != 0) {
+			remove((tmp + ".so").c_str());
+			error = "can't move the compiled library to " + library;
+			return nullptr;
+		}
+	}
+
+	void *lib = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (this->dir.empty()) {
+		remove(library.c_str());
+	}
+	if (!lib) {
+		error = dlerror();
+		return nullptr;
+	}
+
+	void *func = dlsym(lib, NATIVE_SYMBOL);
+	if (!func) {
+		error = dlerror();
+		dlclose(lib);
+		return nullptr;
+	}
+	handle = std::shared_ptr<void>(lib, dlclose);
+	return func;
+}
@@ -0,0 +1,79 @@
+/*
+ * 	 _____     ________     _____  _____  _________  
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  | 
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_| 
+ * 	  | |   _   |  _| _  _   | |    | |      | |     
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_    
+ *	|________||________|`.____.'  |_____|  |_____|   
+ *                                                 
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * Dylan Everingham 08/26/2016
+ * Native.hpp
+ *
+ * Interface of LEJIT's native tier, which translates function parameters
+ * written in a numeric subset of Lua to C, and compiles and loads them at
+ * runtime
+ *
+ */
+
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <string>
+#include <memory>
+#include <functional>
+
+// Command native functions are compiled with, followed by -o and the names
+// of the shared library and the C file. Contraction into fused multiply adds
+// is disabled so results match LuaJIT's
+#define DEFAULT_NATIVE_COMPILER "cc -std=c99 -O3 -fPIC -shared -ffp-contract=off -fno-math-errno"
+
+// Name of the C function generated from a Lua function
+#define NATIVE_SYMBOL "lejit_native"
+
+// Translates the Lua function defined on line of source to a C function
+// named NATIVE_SYMBOL, with arguments of the types in signature. lookup gets
+// the value of a number the function reads from outside of it, which is
+// compiled in as a constant. Returns false with error set if the function
+// uses anything outside of the supported subset
+bool native_translate(const std::string &source, int line, std::string signature, std::function<bool(const std::string &, double &)> lookup, std::string &code, std::string &error);
+
+/*
+ * NativeCompiler: compiles C files generated by native_translate to shared
+ *		libraries, caching them in a directory under a hash of their code and
+ *		the compiler command, and loads them
+ */
+class NativeCompiler {
+private:
+	// Command compiling a C file to a shared library
+	std::string command;
+
+	// Directory libraries are cached in, libraries are compiled to a
+	// temporary file each time if empty
+	std::string dir;
+
+	// Number of libraries found in, and missing from, the cache
+	unsigned long hits, misses;
+
+public:
+	// Constructor
+	NativeCompiler(std::string command = DEFAULT_NATIVE_COMPILER, std::string dir = "");
+
+	// Setters for the compiler command and the cache directory
+	void setCommand(std::string command) { this->command = command; }
+	void setDirectory(std::string dir) { this->dir = dir; }
+
+	// Getters for the cache statistics
+	unsigned long getHits() { return this->hits; }
+	unsigned long getMisses() { return this->misses; }
+
+	// Loads the library compiled from code, compiling it first if it isn't
+	// cached. Returns the address of its NATIVE_SYMBOL function, with handle
+	// keeping the library loaded, or null with error set
+	void *load(const std::string &code, std::shared_ptr<void> &handle, std::string &error);
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * 	 _____     ________     _____  _____  _________  
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  | 
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_| 
+ * 	  | |   _   |  _| _  _   | |    | |      | |     
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_    
+ *	|________||________|`.____.'  |_____|  |_____|   
+ *                                                 
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * Dylan Everingham 08/26/2016
+ * Parallel.cpp
+ *
+ * Implementation of the work stealing loop used by LEJIT's parallel map and
+ * reduce kernels
+ *
+ */
+
+#include "Parallel.hpp"
+
+/*
+ * parallel_default_threads: number of hardware threads, or 1 if unknown
+ */
+int parallel_default_threads()
+{
+	int num_threads = std::thread::hardware_concurrency();
+	return (num_threads > 0) ? num_threads : 1;
+}
+
+/*
+ * parallel_steal: moves the back half of another worker's range into the
+ *		empty range of worker t. Returns false if every range is empty
+ */
+static bool parallel_steal(ParallelRange *ranges, int num_threads, int t)
+{
+	for (int k = 1; k < num_threads; k++) {
+		ParallelRange &victim = ranges[(t + k) % num_threads];
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			int remaining = victim.end - victim.begin;
+			if (remaining <= 0) {
+				continue;
+			}
+			begin = victim.end - (remaining + 1) / 2;
+			end = victim.end;
+			victim.end = begin;
+		}
+
+		std::lock_guard<std::mutex> lock(ranges[t].mutex);
+		ranges[t].begin = begin;
+		ranges[t].end = end;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * parallel_worker: runs chunks of at most grain elements off the front of
+ *		worker t's range, stealing when it is empty, until no work is left
+ */
+static void parallel_worker(ParallelRange *ranges, int num_threads, int t, int grain, std::function<void(int, int, int)> &body)
+{
+	while (true) {
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(ranges[t].mutex);
+			begin = ranges[t].begin;
+			end = std::min(begin + grain, ranges[t].end);
+			ranges[t].begin = end;
+		}
+
+		if (begin < end) {
+			body(t, begin, end);
+		}
+		else if (!parallel_steal(ranges, num_threads, t)) {
+			return;
+		}
+	}
+}
+
+/*
+ * parallel_for: calls body(thread, begin, end) on chunks covering [0, n).
+ *		Each thread starts with an equal share of the range and takes chunks
+ *		of at most grain elements off its front. A thread that runs out
+ *		steals the back half of another thread's share, so the load stays
+ *		balanced when elements take different amounts of time.
+ *
+ *		n: number of loop indices
+ *		grain: maximum number of indices passed to one call of body
+ *		num_threads: number of threads, including the calling thread
+ *		body: called with the worker number and the chunk to run
+ */
+void parallel_for(int n, int grain, int num_threads, std::function<void(int, int, int)> body)
+{
+	if (n <= 0) {
+		return;
+	}
+	if (grain < 1) {
+		grain = 1;
+	}
+
+	// No point in more threads than chunks
+	num_threads = std::max(1, std::min(num_threads, (n + grain - 1) / grain));
+
+	std::unique_ptr<ParallelRange[]> ranges(new ParallelRange[num_threads]);
+	for (int t = 0; t < num_threads; t++) {
+		ranges[t].begin = (int) ((long long) n * t / num_threads);
+		ranges[t].end = (int) ((long long) n * (t + 1) / num_threads);
+	}
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < num_threads; t++) {
+		threads.emplace_back(parallel_worker, ranges.get(), num_threads, t, grain, std::ref(body));
+	}
+
+	parallel_worker(ranges.get(), num_threads, 0, grain, body);
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
@@ -0,0 +1,50 @@
+/*
+ * 	 _____     ________     _____  _____  _________  
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  | 
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_| 
+ * 	  | |   _   |  _| _  _   | |    | |      | |     
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_    
+ *	|________||________|`.____.'  |_____|  |_____|   
+ *                                                 
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * Dylan Everingham 08/26/2016
+ * Parallel.hpp
+ *
+ * Interface for the work stealing loop used by LEJIT's parallel map and
+ * reduce kernels
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+
+// Default number of elements a worker thread takes from its range at a time
+#define DEFAULT_GRAIN 1024
+
+/*
+ * ParallelRange: range of loop indices still to be run by one worker thread.
+ *		Other workers steal from its back end once they run out
+ */
+struct ParallelRange {
+	std::mutex mutex;
+	int begin, end;
+};
+
+// Number of worker threads used when none is given, one per hardware thread
+int parallel_default_threads();
+
+// Calls body(thread, begin, end) on chunks covering [0, n), spread over
+// num_threads threads with work stealing. The calling thread is thread 0
+void parallel_for(int n, int grain, int num_threads, std::function<void(int, int, int)> body);
+
+#endif
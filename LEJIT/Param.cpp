@@ -45,64 +45,155 @@ template <typename T> TypedParam<T>::TypedParam(std::string id, T def_val, std::
 }
 
 /*
- * getLuaString: produces a string that can be printed to the Lua config file
- *		which represents as assignment to the parameter its default value.
- *		Also includes the optional docstring, if present.
- * 		This version is for all int double and bool parameters
+ * writeLuaDoc: writes the optional docstring, if present, and the parameter
+ *		identifier and = which start the assignment of its default value
  */
-template <typename T> std::string TypedParam<T>::getLuaString()
+void Param::writeLuaDoc(std::ostream &out)
 {
-	// Initialize return value
-	std::string ret = "";
+	if (this->doc.length()) {
+		out << "--[[\n" << this->doc << "\n--]]\n";
+	}
+
+	out << this->id << " = ";
+}
+
+/*
+ * writeFrozenDecl: writes the optional docstring as a C++ comment, and the
+ *		declaration of a constexpr constant named after the parameter up to
+ *		the = which starts its initializer
+ */
+bool Param::writeFrozenDecl(std::ostream &out, const char *type_name, const std::vector<size_t> &dims)
+{
+	if (!type_name || std::find(dims.begin(), dims.end(), 0) != dims.end()) {
+		return false;
+	}
 
-	// Start with docstring
 	if (this->doc.length()) {
-		ret += "--[[\n";
-		ret += doc;
-		ret += "\n--]]\n";
+		std::istringstream doc(this->doc);
+		std::string line;
+		while (std::getline(doc, line)) {
+			out << "// " << line << "\n";
+		}
+	}
+
+	out << "constexpr " << type_name << " " << this->id;
+	for (size_t dim : dims) {
+		out << "[" << dim << "]";
 	}
+	out << " = ";
+	return true;
+}
 
-	// Then do parameter identifier and =
-	ret += this->id;
-	ret += " = ";
+/*
+ * writeLua: writes an assignment to the parameter of its default value to
+ *		the Lua config file. Numbers are written so they read back exactly.
+ * 		This version is for all int double bool and string parameters
+ */
+template <typename T> void TypedParam<T>::writeLua(std::ostream &out)
+{
+	this->writeLuaDoc(out);
+	lua_writeliteral(out, this->def_val);
+	out << "\n";
+}
 
-	// Then add default value of the parameter
-	ret += std::to_string(this->def_val);
-	
-	// Add newline after each parameter declaration
-	ret += "\n";
+/*
+ * writeFrozen: writes the snapshotted value as a constexpr C++ constant. This
+ *		version is for all int double bool and string parameters
+ */
+template <typename T> bool TypedParam<T>::writeFrozen(std::ostream &out)
+{
+	if (!this->writeFrozenDecl(out, lua_cpptypename<T>(), {})) {
+		return false;
+	}
 
-	return ret;
+	std::string text;
+	lua_appendcppliteral(text, this->value);
+	out << text << ";\n";
+	return true;
 }
 
 /*
- * getLuaString: version for string parameters
+ * snapshotValue: reads a global out of the evaluated config file into value
+ *		and sets has_value to whether it was found. Values of the wrong type
+ *		or shape are left out like missing ones, with error set to why, so
+ *		they are only reported when the parameter is read. Returns true if
+ *		the value or has_value changed
  */
-template <> std::string TypedParam<std::string>::getLuaString()
+template <typename T> bool snapshotValue(lua_State *L, std::string id, T &value, bool &has_value, std::string &error)
 {
-	// Initialize return value
-	std::string ret = "";
+	T new_value = T();
+	bool had_value = has_value;
+
+	lua_getglobal(L, id.c_str());
+	error.clear();
+	has_value = false;
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+	}
+	else if (!lua_isvalue(L, -1, &new_value)) {
+		error = std::string("has the wrong type or shape (got a ") + luaL_typename(L, -1) + ")";
+		lua_pop(L, 1);
+	}
+	else {
+		lua_gettopvalue(L, new_value);
+		has_value = true;
+	}
 
-	// Start with docstring
-	if (this->doc.length()) {
-		ret += "--[[\n";
-		ret += doc;
-		ret += "\n--]]\n";
+	bool changed = (has_value != had_value) || (has_value && !(new_value == value));
+	if (changed) {
+		value = std::move(new_value);
 	}
+	return changed;
+}
 
-	// Then do parameter identifier and =
-	ret += this->id;
-	ret += " = ";
+/*
+ * unpackValue: reads a value written by lua_packvalue into value, the way
+ *		snapshotValue reads it out of the config file. Returns false if the
+ *		data doesn't hold exactly one value
+ */
+template <typename T> bool unpackValue(const char *data, size_t size, T &value, bool &has_value, bool &changed)
+{
+	T new_value = T();
+	const char *end = data + size;
+	if (!lua_unpackvalue(data, end, new_value) || data != end) {
+		return false;
+	}
 
-	// Then add default value of the parameter
-	ret += "\"";
-	ret += this->def_val;
-	ret += "\"";
-	
-	// Add newline after each parameter declaration
-	ret += "\n";
+	changed = !has_value || !(new_value == value);
+	has_value = true;
+	if (changed) {
+		value = std::move(new_value);
+	}
+	return true;
+}
 
-	return ret;
+/*
+ * snapshot: reads the value of the parameter out of the evaluated config file.
+ *		Parameters missing from the config file, or of the wrong type, are
+ *		left out of the snapshot.
+ *		Returns true if the value changed. This version is for all int,
+ *		double, bool and string parameters
+ */
+template <typename T> bool TypedParam<T>::snapshot(lua_State *L)
+{
+	return snapshotValue(L, this->id, this->value, this->has_value, this->error);
+}
+
+/*
+ * pack: version for all int, double, bool and string parameters
+ */
+template <typename T> bool TypedParam<T>::pack(std::string &out)
+{
+	lua_packvalue(out, this->value);
+	return true;
+}
+
+/*
+ * unpack: version for all int, double, bool and string parameters
+ */
+template <typename T> bool TypedParam<T>::unpack(const char *data, size_t size, bool &changed)
+{
+	return unpackValue(data, size, this->value, this->has_value, changed);
 }
 
 /*
@@ -134,40 +225,57 @@ template <typename T> TypedParam<std::vector<T>>::TypedParam(std::string id, std
 }
 
 /*
- * getLuaString: version for 1d c-style array parameters
+ * writeLua: version for 1d c-style array parameters
  */
-template <typename T> std::string TypedParam<std::vector<T>>::getLuaString()
+template <typename T> void TypedParam<std::vector<T>>::writeLua(std::ostream &out)
 {
+	this->writeLuaDoc(out);
 
-	// Initialize return value
-	std::string ret = "";
+	const std::vector<T> &def_val = this->def_val;
+	lua_writetable(out, this->getDims(), [&def_val](size_t i) -> T { return def_val[i]; });
 
-	// Start with docstring
-	if (this->doc.length()) {
-		ret += "--[[\n";
-		ret += doc;
-		ret += "\n--]]\n";
-	}
+	out << "\n";
+}
 
-	// Then do parameter identifier and =
-	ret += this->id;
-	ret += " = ";
+/*
+ * writeFrozen: version for 1d c-style array parameters
+ */
+template <typename T> bool TypedParam<std::vector<T>>::writeFrozen(std::ostream &out)
+{
+	const std::vector<T> &value = this->value;
+	std::vector<size_t> dims { value.size() };
+	if (!this->writeFrozenDecl(out, lua_cpptypename<T>(), dims)) {
+		return false;
+	}
 
-	// Brackets to enclose lua table
-	ret += "{";
+	lua_writetable(out, dims, [&value](size_t i) -> T { return value[i]; }, true);
+	out << ";\n";
+	return true;
+}
 
-	// Then add default value of the parameter
-	size_t size = this->getDims()[0];
-	for(int i = 0; i < size-1; i++) {
-		ret += std::to_string(this->def_val[i]);
-		ret += ", ";
-	}
-	ret += std::to_string(this->def_val[size-1]);
+/*
+ * snapshot: version for 1d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<T>>::snapshot(lua_State *L)
+{
+	return snapshotValue(L, this->id, this->value, this->has_value, this->error);
+}
 
-	// Add close bracket and newline
-	ret += "}\n";
+/*
+ * pack: version for 1d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<T>>::pack(std::string &out)
+{
+	lua_packvalue(out, this->value);
+	return true;
+}
 
-	return ret;
+/*
+ * unpack: version for 1d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<T>>::unpack(const char *data, size_t size, bool &changed)
+{
+	return unpackValue(data, size, this->value, this->has_value, changed);
 }
 
 /*
@@ -199,50 +307,70 @@ template <typename T> TypedParam<std::vector<std::vector<T>>>::TypedParam(std::s
 }
 
 /*
- * getLuaString: version for 2d c-style array parameters
+ * writeLua: version for 2d c-style array parameters
  */
-template <typename T> std::string TypedParam<std::vector<std::vector<T>>>::getLuaString()
+template <typename T> void TypedParam<std::vector<std::vector<T>>>::writeLua(std::ostream &out)
 {
-	// Initialize return value
-	std::string ret = "";
+	this->writeLuaDoc(out);
 
-	// Start with docstring
-	if (this->doc.length()) {
-		ret += "--[[\n";
-		ret += doc;
-		ret += "\n--]]\n";
-	}
-
-	// Then do parameter identifier and =
-	ret += this->id;
-	ret += " = ";
-
-	// Get table dimensions
-	size_t rows = this->getDims()[0];
-	size_t cols = this->getDims()[1];
+	// Tables are written with the length of the first row
+	std::vector<size_t> dims = this->getDims();
+	const std::vector<std::vector<T>> &def_val = this->def_val;
+	size_t cols = dims[1];
+	lua_writetable(out, dims, [&def_val, cols](size_t i) -> T { return def_val[i / cols][i % cols]; });
 
-	// Brackets to enclose Lua table
-	ret += "{";
-
-	for(int i = 0; i < rows; i++) {
-		ret += "{";
+	out << "\n";
+}
 
-		for (int j = 0; j < cols; j++) {
-			ret += std::to_string(this->def_val[i][j]);
-			if (j < cols-1) {
-				ret += ", ";
-			}
-		}
+/*
+ * writeFrozen: version for 2d c-style array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<T>>>::writeFrozen(std::ostream &out)
+{
+	const std::vector<std::vector<T>> &value = this->value;
+	if (value.empty()) {
+		return false;
+	}
 
-		ret += "}";
-		if (i < rows-1) {
-			ret+= ", ";
+	std::vector<size_t> dims { value.size(), value[0].size() };
+	for (const std::vector<T> &row : value) {
+		if (row.size() != dims[1]) {
+			return false;
 		}
 	}
+	if (!this->writeFrozenDecl(out, lua_cpptypename<T>(), dims)) {
+		return false;
+	}
 
-	ret += "}\n";
+	size_t cols = dims[1];
+	lua_writetable(out, dims, [&value, cols](size_t i) -> T { return value[i / cols][i % cols]; }, true);
+	out << ";\n";
+	return true;
+}
 
-	return ret;
+/*
+ * snapshot: version for 2d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<T>>>::snapshot(lua_State *L)
+{
+	return snapshotValue(L, this->id, this->value, this->has_value, this->error);
+}
+
+/*
+ * pack: version for 2d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<T>>>::pack(std::string &out)
+{
+	lua_packvalue(out, this->value);
+	return true;
+}
+
+/*
+ * unpack: version for 2d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<T>>>::unpack(const char *data, size_t size, bool &changed)
+{
+	return unpackValue(data, size, this->value, this->has_value, changed);
 }
 
 /*
@@ -274,71 +402,252 @@ template <typename T> TypedParam<std::vector<std::vector<std::vector<T>>>>::Type
 }
 
 /*
- * getLuaString: version for 3d c-style array parameters
+ * writeLua: version for 3d c-style array parameters
  */
-template <typename T> std::string TypedParam<std::vector<std::vector<std::vector<T>>>>::getLuaString()
+template <typename T> void TypedParam<std::vector<std::vector<std::vector<T>>>>::writeLua(std::ostream &out)
 {
-	// Initialize return value
-	std::string ret = "";
+	this->writeLuaDoc(out);
 
-	// Start with docstring
-	if (this->doc.length()) {
-		ret += "--[[\n";
-		ret += doc;
-		ret += "\n--]]\n";
+	// Tables are written with the dimensions of the first row and column
+	std::vector<size_t> dims = this->getDims();
+	const std::vector<std::vector<std::vector<T>>> &def_val = this->def_val;
+	size_t cols = dims[1], depth = dims[2];
+	lua_writetable(out, dims, [&def_val, cols, depth](size_t i) -> T { return def_val[i / (cols * depth)][i / depth % cols][i % depth]; });
+
+	out << "\n";
+}
+
+/*
+ * writeFrozen: version for 3d c-style array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<std::vector<T>>>>::writeFrozen(std::ostream &out)
+{
+	const std::vector<std::vector<std::vector<T>>> &value = this->value;
+	if (value.empty() || value[0].empty()) {
+		return false;
 	}
 
-	// Then do parameter identifier and =
-	ret += this->id;
-	ret += " = ";
+	std::vector<size_t> dims { value.size(), value[0].size(), value[0][0].size() };
+	for (const std::vector<std::vector<T>> &row : value) {
+		if (row.size() != dims[1]) {
+			return false;
+		}
+		for (const std::vector<T> &col : row) {
+			if (col.size() != dims[2]) {
+				return false;
+			}
+		}
+	}
+	if (!this->writeFrozenDecl(out, lua_cpptypename<T>(), dims)) {
+		return false;
+	}
 
-	// Get table dimensions
-	size_t rows = this->getDims()[0];
-	size_t cols = this->getDims()[1];
-	size_t depth = this->getDims()[2];
+	size_t cols = dims[1], depth = dims[2];
+	lua_writetable(out, dims, [&value, cols, depth](size_t i) -> T { return value[i / (cols * depth)][i / depth % cols][i % depth]; }, true);
+	out << ";\n";
+	return true;
+}
 
-	// Brackets to enclose lua table
-	ret += "{";
+/*
+ * snapshot: version for 3d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<std::vector<T>>>>::snapshot(lua_State *L)
+{
+	return snapshotValue(L, this->id, this->value, this->has_value, this->error);
+}
 
-	for(int i = 0; i < rows; i++) {
-		ret += "{";
+/*
+ * pack: version for 3d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<std::vector<T>>>>::pack(std::string &out)
+{
+	lua_packvalue(out, this->value);
+	return true;
+}
 
-		for (int j = 0; j < cols; j++) {
-			ret += "{";
+/*
+ * unpack: version for 3d array parameters
+ */
+template <typename T> bool TypedParam<std::vector<std::vector<std::vector<T>>>>::unpack(const char *data, size_t size, bool &changed)
+{
+	return unpackValue(data, size, this->value, this->has_value, changed);
+}
 
-			for (int k = 0; k < depth; k++) {
-				ret += std::to_string(this->def_val[i][j][k]);
+/*
+ * TypedParam constructor for flat arrays of any rank
+ */
+template <typename T> TypedParam<NDArray<T>>::TypedParam(std::string id, NDArray<T> def_val)
+{
+	// Initialize member variables
+	this->id = id;
+	this->def_val = def_val;
+	this->doc = "";
 
-				if (k < depth-1) {
-					ret += ", ";
-				}
-			}
+	this->type = type(NDArray<T>);
+}
 
-			ret += "}";
+/*
+ * Flat array type TypedParam constructor with optional docstring
+ */
+template <typename T> TypedParam<NDArray<T>>::TypedParam(std::string id, NDArray<T> def_val, std::string doc)
+{
+	// Initialize member variables
+	this->id = id;
+	this->def_val = def_val;
+	this->doc = doc;
 
-			if (j < cols-1) {
-				ret += ", ";
-			}
+	this->type = type(NDArray<T>);
+}
+
+/*
+ * writeLua: version for flat arrays of any rank. The default value is written
+ *		as a reference to its sidecar file if it has one
+ */
+template <typename T> void TypedParam<NDArray<T>>::writeLua(std::ostream &out)
+{
+	this->writeLuaDoc(out);
+
+	if (!this->sidecar.empty()) {
+		out << "lejit.array(";
+		lua_writeliteral(out, this->sidecar);
+		out << ")";
+	}
+	else {
+		const T *data = this->def_val.data();
+		lua_writetable(out, this->def_val.getShape(), [data](size_t i) -> T { return data[i]; });
+	}
+
+	out << "\n";
+}
+
+/*
+ * writeFrozen: version for flat arrays of any rank. Mapped values are
+ *		written straight from the sidecar file
+ */
+template <typename T> bool TypedParam<NDArray<T>>::writeFrozen(std::ostream &out)
+{
+	NDView<const T> view = this->getView();
+	if (view.rank() == 0 || !this->writeFrozenDecl(out, lua_cpptypename<T>(), view.getShape())) {
+		return false;
+	}
+
+	const T *data = view.data();
+	lua_writetable(out, view.getShape(), [data](size_t i) -> T { return data[i]; }, true);
+	out << ";\n";
+	return true;
+}
+
+/*
+ * snapshot: version for flat arrays of any rank
+ */
+template <typename T> bool TypedParam<NDArray<T>>::snapshot(lua_State *L)
+{
+	lua_getglobal(L, this->id.c_str());
+	if (lua_isarrayfile(L, -1)) {
+		std::string path = lua_toarrayfile(L, -1);
+		lua_pop(L, 1);
+
+		// Keep the existing mapping if the file hasn't changed
+		bool had_value = this->has_value;
+		this->has_value = true;
+		this->error.clear();
+		if (this->mapped && this->mapped->getPath() == path && this->mapped->isCurrent()) {
+			return !had_value;
 		}
 
-		ret += "}";
-		if (i < rows-1) {
-			ret+= ", ";
+		std::shared_ptr<LuaMappedArray> mapped = std::make_shared<LuaMappedArray>(L, path);
+		if (mapped->getType() != lua_arraytypecode<T>() || mapped->getShape().size() != this->def_val.rank()) {
+			this->error = "has an array file '" + path + "' of the wrong type or rank";
+			this->has_value = false;
+			this->mapped = nullptr;
+			return had_value;
 		}
+
+		this->mapped = mapped;
+		this->value = NDArray<T>();
+		return true;
+	}
+	lua_pop(L, 1);
+
+	bool had_value = this->has_value;
+	bool changed = this->mapped != nullptr;
+	this->mapped = nullptr;
+	changed = snapshotValue(L, this->id, this->value, this->has_value, this->error) || changed;
+
+	if (this->has_value && this->value.rank() != this->def_val.rank()) {
+		this->error = "is a table of rank " + std::to_string(this->value.rank()) + ", expected rank " + std::to_string(this->def_val.rank());
+		this->has_value = false;
+		changed = had_value;
+	}
+
+	return changed;
+}
+
+/*
+ * pack: version for flat arrays of any rank. Values mapped from sidecar
+ *		files are packed like any other
+ */
+template <typename T> bool TypedParam<NDArray<T>>::pack(std::string &out)
+{
+	lua_packvalue(out, this->getValue());
+	return true;
+}
+
+/*
+ * unpack: version for flat arrays of any rank
+ */
+template <typename T> bool TypedParam<NDArray<T>>::unpack(const char *data, size_t size, bool &changed)
+{
+	bool was_mapped = this->mapped != nullptr;
+	if (!unpackValue(data, size, this->value, this->has_value, changed)) {
+		return false;
 	}
 
-	ret += "}\n";
+	this->mapped = nullptr;
+	changed = changed || was_mapped;
+	return true;
+}
 
-	return ret;
+/*
+ * getValue: version for flat arrays of any rank. A value mapped from a
+ *		sidecar file is copied into memory the first time it is asked for
+ */
+template <typename T> const NDArray<T> & TypedParam<NDArray<T>>::getValue()
+{
+	if (this->mapped && this->value.rank() == 0) {
+		NDView<const T> view = this->mapped->template view<T>();
+		this->value = NDArray<T>(view.getShape(), std::vector<T>(view.data(), view.data() + view.size()));
+	}
+	return this->value;
+}
+
+/*
+ * writeSidecar: writes the default value to <id>.bin in dir if it has at
+ *		least threshold elements and its type can be stored in a sidecar file
+ */
+template <typename T> bool TypedParam<NDArray<T>>::writeSidecar(std::string dir, size_t threshold)
+{
+	if (!lua_arraytypecode<T>() || this->def_val.size() < threshold) {
+		return false;
+	}
+
+	std::string name = this->id + ".bin";
+	if (!lua_writearrayfile(dir + name, this->def_val)) {
+		return false;
+	}
+
+	this->sidecar = name;
+	return true;
 }
 
 /*
  * TypedParam constructor for C++ std::function type parameters
  */
-template <typename ...args> TypedParam<std::function<void(args...)>>::TypedParam(lua_State *L, std::string id, std::string signature, std::function<void(args...)> def_val)
+template <typename ...args> TypedParam<std::function<void(args...)>>::TypedParam(std::shared_ptr<lua_State> L, std::string id, std::string signature, std::function<void(args...)> def_val)
 {
 	// Initialize member variables
-	this->L = L;
+	this->owner = L;
+	this->L = L.get();
 	this->type = type(std::function<void(args...)>);
 	this->id = id;
 	this->signature = signature;
@@ -349,10 +658,11 @@ template <typename ...args> TypedParam<std::function<void(args...)>>::TypedParam
 /*
  * C++ std::function type TypedParam constructor with optional docstring
  */
-template <typename ...args> TypedParam<std::function<void(args...)>>::TypedParam(lua_State *L, std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc)
+template <typename ...args> TypedParam<std::function<void(args...)>>::TypedParam(std::shared_ptr<lua_State> L, std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc)
 {
 	// Initialize member variables
-	this->L = L;
+	this->owner = L;
+	this->L = L.get();
 	this->type = type(std::function<void(args...)>);
 	this->id = id;
 	this->signature = signature;
@@ -375,7 +685,7 @@ template <typename ...args> std::string TypedParam<std::function<void(args...)>>
 		std::string sig("");
 
 		// For each argument...
-		for (int argnum = 0; argnum < this->num_args; argnum++) {
+		for (size_t argnum = 0; argnum < this->num_args; argnum++) {
 
 			if (type(int) == this->argtypes[argnum]) {
 				sig += 'i';
@@ -405,62 +715,294 @@ template <typename ...args> std::string TypedParam<std::function<void(args...)>>
 }
 
 /*
- * getLuaString: version for function parameters
+ * writeLua: version for function parameters, writes a stub definition taking
+ *		one argument for each input parameter in the signature. Until the
+ *		stub is edited, the default is called instead of it
  */
-template <typename ...args> std::string TypedParam<std::function<void(args...)>>::getLuaString()
+template <typename ...args> void TypedParam<std::function<void(args...)>>::writeLua(std::ostream &out)
 {
-	std::string ret = "";
+	this->writeLuaDoc(out);
+	out << "function(";
 
-	// Start with docstring
-	if (this->doc.length()) {
-		ret += "--[[\n";
-		ret += doc;
-		ret += "\n--]]\n";
+	// Add an argument for each inparam in signature
+	char kinds[sizeof...(args) + 1];
+	int num_in = lua_parsesignature(this->L, this->getSignature(), kinds, sizeof...(args));
+	for (int i = 0; i < num_in; i++) {
+		if (i > 0) {
+			out << ", ";
+		}
+		out << "arg" << i;
 	}
+	out << ")\n";
 
-	// Then do parameter identifier and =
-	ret += this->id;
-	ret += " = function(";
+	// Add message indicating that this function can be redefined by the user
+	out << "\t" LEJIT_STUB_COMMENT "\n";
+	out << "end\n";
+}
 
-	const char * sig = this->getSignature().c_str();
-	bool finished_inparams = 0;
-	int i = 0;
+/*
+ * snapshot: version for function parameters. Publishes the Lua function as a
+ *		new version of most_recent if the config file defines one. Calls
+ *		already running finish on the previous version. If the function's
+ *		bytecode and upvalues are the same as those of the bound function,
+ *		the existing binding is kept and false is returned.
+ *		Functions set to nil or lejit.default, or left as the stub written by
+ *		writeConfigFile, are bound to the default without going through Lua,
+ *		if there is one
+ */
+template <typename ...args> bool TypedParam<std::function<void(args...)>>::snapshot(lua_State *L)
+{
+	lua_getglobal(L, this->id.c_str());
+	bool had_value = this->has_value;
+	bool had_default = this->uses_default;
+	this->uses_default = this->def_val && (lua_isnil(L, -1) || lua_isdefault(L, -1) || lua_isstub(L, -1));
+	this->has_value = this->uses_default || lua_isfunction(L, -1);
+	this->error = (this->has_value || lua_isnil(L, -1)) ? "" : std::string("is not a function (got a ") + luaL_typename(L, -1) + ")";
+
+	if (!this->has_value) {
+		lua_pop(L, 1);
+		return had_value;
+	}
 
-	// Add an argument for each inparam in signature
-	while(!finished_inparams && (*sig)) {
-		switch(*sig++) {
-			case '>' : 
-				finished_inparams = 1;
-				break;
-			default:
-				if (i > 0) {
-					ret += ", ";
-				}
-				ret += "arg";
-				ret += std::to_string(i);
-				i++;
-				break;
+	// The default doesn't depend on the config file, so it is only bound when
+	// the function changes to it
+	if (this->uses_default) {
+		lua_pop(L, 1);
+		if (had_value && had_default) {
+			return false;
+		}
+		this->fingerprint = 0;
+		this->lua_func = nullptr;
+	}
+	else {
+		// Keep the existing binding if the function is the same as before.
+		// Cached results are dropped anyway, as they may depend on other
+		// globals, and tables are always sampled again, and native functions
+		// compiled again with the new values of the globals, for the same reason
+		uint64_t fingerprint = lua_fingerprint(L, -1);
+		if (had_value && fingerprint && fingerprint == this->fingerprint && !this->table_spec.rank && !this->native) {
+			if (this->memo) {
+				this->memo->clear();
+			}
+			lua_pop(L, 1);
+			return false;
 		}
+		this->fingerprint = fingerprint;
+		this->lua_func = std::make_shared<LuaRef>(this->owner);
 	}
-	ret += ")\n";
+	this->getLuaFunc();
 
-	// Add message indicating that this function can be redefined by the user
-	ret += "\t-- Add a Lua function definition here to override the default behavior\n";
-	ret += "end\n";
+	// Rebind the batched form if it is in use, otherwise the next time it is read
+	if (this->batch_bound) {
+		this->batch_bound = false;
+		this->getLuaBatchFunc();
+	}
+	return true;
+}
+
+/*
+ * setStatePool: version for function parameters. Reserves a slot for the
+ *		function and one for its batched form in each per thread state
+ */
+template <typename ...args> void TypedParam<std::function<void(args...)>>::setStatePool(std::shared_ptr<LuaStatePool> pool)
+{
+	this->pool = pool;
+	this->slot = pool->newSlots(2);
 
-	return ret;
+	// Rebind on the next snapshot even if the function is unchanged
+	this->fingerprint = 0;
 }
 
 /*
  * getLuaFunc: returns std::function with Lua function read from config file bound to it,
- *		using lua_callfunc and std::bind
+ *		using a LuaFunc specialized for the function's argument types. If
+ *		threads are enabled the function is called in the Lua state of the
+ *		calling thread. Native functions are compiled to C and called
+ *		directly. Pure functions are called through a LuaMemoFunc
  */
 template <typename ...args> std::function<void(args...)> TypedParam<std::function<void(args...)>>::getLuaFunc()
 {
-	this->most_recent = this->getLuaFunc(make_int_sequence<sizeof...(args)>{});
-	return this->most_recent;
+	this->memo = nullptr;
+	this->table_batch = nullptr;
+	this->direct_batch = nullptr;
+
+	// The default is called as is, it is neither cached, tabulated nor compiled
+	if (!this->lua_func) {
+		this->most_recent->publish(this->def_val);
+		return this->def_val;
+	}
+
+	// Binding in the reader's own state also checks the signature
+	LuaFunc<args...> func(this->L, this->getId(), this->lua_func, this->getSignature(), this->stats);
+
+	// Native functions don't use a Lua state, so any thread can call them
+	std::function<void(args...)> bound;
+	if (this->native) {
+		std::shared_ptr<void> handle;
+		std::string error;
+		this->lua_func->push();
+		void *native_func = lua_compilenative(this->L, this->getSignature(), *this->native, handle, error);
+		if (native_func) {
+			lua_bindnative(native_func, handle, bound, this->direct_batch);
+		}
+		else {
+			printf("Function parameter '%s' can't be compiled natively, %s. Calling Lua instead\n", this->id.c_str(), error.c_str());
+		}
+	}
+	// Lua functions are published as their own type, everything else as the
+	// std::function wrapping it
+	Binding binding;
+	if (!bound && this->pool) {
+		LuaThreadFunc<LuaFunc<args...>> thread_func(this->pool, this->slot, this->getId(), this->getSignature(), this->stats);
+		binding = thread_func;
+		bound = thread_func;
+	}
+	else if (!bound) {
+		binding = func;
+		bound = func;
+	}
+	else {
+		binding = bound;
+	}
+
+	// Tabulated functions are sampled into a new table with each binding, and
+	// pure functions get a new result cache
+	if (this->table_spec.rank) {
+		std::function<void(args...)> table_call;
+		if (lua_tabulate(bound, this->table_spec, table_call, this->table_batch, this->table_error)) {
+			bound = table_call;
+			binding = bound;
+		}
+		else {
+			printf("Table of function parameter '%s' has error %g, above the tolerance %g. Calling Lua instead\n",
+				this->id.c_str(), this->table_error, this->table_spec.tolerance);
+		}
+	}
+	else if (this->memo_entries) {
+		LuaMemoFunc<args...> memo_func(bound, this->memo_entries, this->stats);
+		this->memo = memo_func.getMemo();
+		bound = memo_func;
+		binding = bound;
+	}
+
+	this->most_recent->publish(binding);
+	return bound;
+}
+
+/*
+ * setPure: version for function parameters. Checks that every inparam and
+ *		outparam in the signature is an int, double or bool, then rebinds the
+ *		function with a result cache if the config file defines it. Batched
+ *		calls are not cached
+ */
+template <typename ...args> void TypedParam<std::function<void(args...)>>::setPure(size_t entries)
+{
+	std::string signature = this->getSignature();
+	size_t num_out = 0;
+	bool outparams = false;
+	for (char c : signature) {
+		if (c == '>' && !outparams) {
+			outparams = true;
+		}
+		else if (c == 'i' || c == 'd' || c == 'b') {
+			num_out += outparams;
+		}
+		else {
+			throw std::invalid_argument("Function parameter '" + this->id + "' with signature '" + signature
+			+ "' can't be pure, only int, double and bool arguments are allowed\n");
+		}
+	}
+	if (!num_out) {
+		throw std::invalid_argument("Function parameter '" + this->id + "' has no outparams and can't be pure\n");
+	}
+
+	this->memo_entries = entries;
+	if (this->has_value && this->lua_func) {
+		this->getLuaFunc();
+	}
+}
+
+/*
+ * setTabulated: version for function parameters. Checks that the function is
+ *		d>d for tables of rank 1 or dd>d for rank 2, and that the domain has
+ *		at least two samples along each dimension, then rebinds the function
+ *		to a table if the config file defines it
+ */
+template <typename ...args> void TypedParam<std::function<void(args...)>>::setTabulated(const LuaTableSpec &spec)
+{
+	std::vector<std::type_index> types;
+	if (spec.rank == 1) {
+		types = { type(double), type(double*) };
+	}
+	else if (spec.rank == 2) {
+		types = { type(double), type(double), type(double*) };
+	}
+
+	std::string signature = this->getSignature();
+	if (types.empty() || this->argtypes != types || signature != std::string(spec.rank, 'd') + ">d") {
+		throw std::invalid_argument("Function parameter '" + this->id + "' with signature '" + signature
+		+ "' can't be tabulated with rank " + std::to_string(spec.rank) + ", only d>d and dd>d functions can\n");
+	}
+	for (int d = 0; d < spec.rank; d++) {
+		if (spec.n[d] < 2 || !(spec.hi[d] > spec.lo[d])) {
+			throw std::invalid_argument("Function parameter '" + this->id + "' needs at least 2 samples over a nonempty domain to be tabulated\n");
+		}
+	}
+
+	this->table_spec = spec;
+	if (this->has_value && this->lua_func) {
+		this->getLuaFunc();
+		if (this->batch_bound) {
+			this->batch_bound = false;
+			this->getLuaBatchFunc();
+		}
+	}
 }
-template <typename ...args> template<int ...Is> std::function<void(args...)> TypedParam<std::function<void(args...)>>::getLuaFunc(int_sequence<Is...>)
+
+/*
+ * setNative: version for function parameters. Rebinds the function, compiled
+ *		to C if compiler isn't null, if the config file defines it
+ */
+template <typename ...args> void TypedParam<std::function<void(args...)>>::setNative(std::shared_ptr<NativeCompiler> compiler)
+{
+	this->native = compiler;
+	if (this->has_value && this->lua_func) {
+		this->getLuaFunc();
+		if (this->batch_bound) {
+			this->batch_bound = false;
+			this->getLuaBatchFunc();
+		}
+	}
+}
+
+/*
+ * getLuaBatchFunc: returns std::function with the batched form of the Lua
+ *		function bound to it, or the table, C function or default the
+ *		function is served from. Only bound once per snapshot
+ */
+template <typename ...args> std::function<void(int, typename lua_batcharg<args>::type...)> TypedParam<std::function<void(args...)>>::getLuaBatchFunc()
 {
-	return std::bind(&lua_callfunc, this->L, this->getId(), this->getSignature(), placeholder_template<Is>{}...);
+	if (!this->batch_bound && !this->lua_func) {
+		lua_bindbatch(this->L, this->getSignature(), this->def_val, this->direct_batch);
+		this->most_recent_batch->publish(this->direct_batch);
+		this->batch_bound = true;
+	}
+	else if (!this->batch_bound) {
+		if (this->table_batch) {
+			this->most_recent_batch->publish(this->table_batch);
+		}
+		else if (this->direct_batch) {
+			this->most_recent_batch->publish(this->direct_batch);
+		}
+		else if (this->pool) {
+			this->most_recent_batch->publish(LuaThreadFunc<LuaBatchFunc<args...>>(this->pool, this->slot + 1, this->getId(), this->getSignature(), this->stats));
+		}
+		else {
+			// The batch driver is only built in the reader's own state when
+			// it is called there
+			this->most_recent_batch->publish(LuaBatchFunc<args...>(this->L, this->getId(), this->lua_func, this->getSignature(), this->stats));
+		}
+		this->batch_bound = true;
+	}
+	return this->most_recent_batch->get();
 }
\ No newline at end of file
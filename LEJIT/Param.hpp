@@ -25,11 +25,10 @@
 #include <string>
 #include <functional>
 #include <typeindex>
+#include <sstream>
 
 #include "LuaUtil.cpp"
 
-using namespace std::placeholders;
-
 // Macro used to get type information about parameters
 #define type(x) std::type_index(typeid(x))
 
@@ -45,16 +44,95 @@ protected:
 	std::string id;
 	std::string doc;
 
+	// True if the parameter was found in the most recently evaluated config file
+	bool has_value = false;
+
+	// Why the parameter was left out of the snapshot although the config
+	// file sets it, e.g. because it has the wrong type. Empty if it wasn't
+	std::string error;
+
+	// Callbacks fired after reloads which change the parameter
+	std::vector<std::function<void()>> on_change;
+
+	// Writes the docstring and the start of the assignment to the parameter
+	void writeLuaDoc(std::ostream &out);
+
+	// Writes the docstring and the declaration of a constexpr C++ constant
+	// named after the parameter, with the given type and array dimensions, up
+	// to its initializer. Returns false if the type is null or a dimension is 0
+	bool writeFrozenDecl(std::ostream &out, const char *type_name, const std::vector<size_t> &dims);
+
 public:
+	virtual ~Param() {}
+
 	std::type_index getType() { return this->type; }
 	std::string getId() { return this->id; }
 	std::string getDoc() { return this->doc; }
+	bool hasValue() { return this->has_value; }
+	std::string getError() { return this->error; }
+
+	// Writes the assignment of the default value, with the docstring, to a
+	// Lua config file
+	virtual void writeLua(std::ostream &out) { out << "This type has no supported Lua representation!\n"; };
+
+	// Gets the text written by writeLua as a string
+	std::string getLuaString() { std::ostringstream out; this->writeLua(out); return out.str(); }
+
+	// Writes the snapshotted value as a constexpr C++ constant named after the
+	// parameter, for headers written by writeFrozenHeader. Returns false for
+	// parameters which can't be constants, such as functions
+	virtual bool writeFrozen(std::ostream &out) { return false; };
+
+	// Reads the value of the parameter out of an evaluated config file into
+	// the snapshot served by readParam. Returns true if the value changed
+	virtual bool snapshot(lua_State *L) { return false; };
 
-	virtual std::string getLuaString() { return std::string("This type has no supported Lua representation!\n"); };
+	// Makes the parameter callable from any thread through a pool of per
+	// thread Lua states. Only function parameters use it
+	virtual void setStatePool(std::shared_ptr<LuaStatePool> pool) {};
+
+	// Writes the default value to a binary sidecar file in dir, which
+	// writeLua then references, if it has at least threshold elements.
+	// Only flat array parameters use it
+	virtual bool writeSidecar(std::string dir, size_t threshold) { return false; };
+
+	// Appends the snapshotted value to out in the binary form config files
+	// are shared between processes in. Returns false for parameters which
+	// can only be read out of a Lua state, such as functions
+	virtual bool pack(std::string &out) { return false; };
+
+	// Reads a value written by pack into the snapshot, setting changed if it
+	// differs. Returns false if the data is malformed
+	virtual bool unpack(const char *data, size_t size, bool &changed) { return false; };
+
+	// Leaves the parameter out of the snapshot, returns true if it had a value
+	bool clearValue() { bool had_value = this->has_value; this->has_value = false; return had_value; }
+
+	// Gets the call statistics of the parameter, null for parameters which
+	// are not functions or if statistics are disabled
+	virtual std::shared_ptr<LuaStats> getStats() { return nullptr; };
+
+	// Puts a cache of entries results in front of calls to the parameter,
+	// which must be a pure function of scalar arguments. 0 removes it
+	virtual void setPure(size_t entries) { throw std::invalid_argument("Parameter '" + this->id + "' is not a function and can't be pure\n"); };
+
+	// Serves calls to the parameter, which must be a d>d or dd>d function,
+	// from a table sampled over the domain in spec
+	virtual void setTabulated(const LuaTableSpec &spec) { throw std::invalid_argument("Parameter '" + this->id + "' is not a function and can't be tabulated\n"); };
+
+	// Compiles the parameter, which must be a function, to C with compiler
+	// each time it is bound. Null goes back to calling Lua
+	virtual void setNative(std::shared_ptr<NativeCompiler> compiler) { throw std::invalid_argument("Parameter '" + this->id + "' is not a function and can't be compiled natively\n"); };
 
 	// Treat all non array parameters as arrays of length 1
 	virtual std::vector<size_t> getDims() { return std::vector<size_t> {1}; };
 
+	// Adds a callback fired after each reload which changes the parameter
+	void addOnChange(std::function<void()> on_change) { this->on_change.push_back(on_change); }
+
+	// Fires the change callbacks, returns false if there are none
+	bool fireOnChange() { for (auto &f : this->on_change) f(); return !this->on_change.empty(); }
+
 };
 
 /*
@@ -66,6 +144,9 @@ protected:
 	// Default value of parameter
 	T def_val;
 
+	// Value of parameter in the config file snapshot
+	T value;
+
 public:
 	// Constructors
 	TypedParam(std::string id, T def_val);
@@ -74,8 +155,22 @@ public:
 	// Getter for default value
 	T getDefVal() { return this->def_val; }
 
-	// Produces string to be printed to Lua configuration file
-	std::string getLuaString();
+	// Getter for snapshotted value
+	T getValue() { return this->value; }
+
+	// Writes the parameter to a Lua configuration file
+	void writeLua(std::ostream &out);
+
+	// Writes the snapshotted value as a constexpr C++ constant
+	bool writeFrozen(std::ostream &out);
+
+	// Reads parameter value out of the config file into the snapshot
+	bool snapshot(lua_State *L);
+
+	// Packs the snapshot into, and unpacks it from, the binary form shared
+	// between processes
+	bool pack(std::string &out);
+	bool unpack(const char *data, size_t size, bool &changed);
 };
 
 /* 
@@ -88,6 +183,9 @@ private:
 	// Default value of parameter
 	std::vector<T> def_val;
 
+	// Value of parameter in the config file snapshot
+	std::vector<T> value;
+
 public:
 	// Constructors
 	TypedParam(std::string id, std::vector<T> def_val);
@@ -96,9 +194,23 @@ public:
 	// Getter for default value
 	T getDefVal() { return this->def_val; }
 
-	// Gets string expressing sunction signature and documentation which can be
-	// printed to a Lua config file
-	std::string getLuaString();
+	// Getter for snapshotted value
+	const std::vector<T> &getValue() { return this->value; }
+
+	// Writes the default value and documentation to a Lua config file
+	void writeLua(std::ostream &out);
+
+	// Writes the snapshotted value as a constexpr C++ array. Ragged arrays
+	// can't be written
+	bool writeFrozen(std::ostream &out);
+
+	// Reads parameter value out of the config file into the snapshot
+	bool snapshot(lua_State *L);
+
+	// Packs the snapshot into, and unpacks it from, the binary form shared
+	// between processes
+	bool pack(std::string &out);
+	bool unpack(const char *data, size_t size, bool &changed);
 
 	// Getter for array size
 	std::vector<size_t> getDims() { return std::vector<size_t> { this->def_val.size() }; };
@@ -114,6 +226,9 @@ private:
 	// Default value of parameter
 	std::vector<std::vector<T>> def_val;
 
+	// Value of parameter in the config file snapshot
+	std::vector<std::vector<T>> value;
+
 public:
 	// Constructors
 	TypedParam(std::string id, std::vector<std::vector<T>> def_val);
@@ -122,9 +237,23 @@ public:
 	// Getter for default value
 	T getDefVal() { return this->def_val; }
 
-	// Gets string expressing sunction signature and documentation which can be
-	// printed to a Lua config file
-	std::string getLuaString();
+	// Getter for snapshotted value
+	const std::vector<std::vector<T>> &getValue() { return this->value; }
+
+	// Writes the default value and documentation to a Lua config file
+	void writeLua(std::ostream &out);
+
+	// Writes the snapshotted value as a constexpr C++ array. Ragged arrays
+	// can't be written
+	bool writeFrozen(std::ostream &out);
+
+	// Reads parameter value out of the config file into the snapshot
+	bool snapshot(lua_State *L);
+
+	// Packs the snapshot into, and unpacks it from, the binary form shared
+	// between processes
+	bool pack(std::string &out);
+	bool unpack(const char *data, size_t size, bool &changed);
 
 	// Getter for array size
 	std::vector<size_t> getDims() { return std::vector<size_t> { this->def_val.size(), this->def_val[0].size() }; };
@@ -140,6 +269,9 @@ private:
 	// Default value of parameter
 	std::vector<std::vector<std::vector<T>>> def_val;
 
+	// Value of parameter in the config file snapshot
+	std::vector<std::vector<std::vector<T>>> value;
+
 public:
 	// Constructors
 	TypedParam(std::string id, std::vector<std::vector<std::vector<T>>> def_val);
@@ -148,55 +280,172 @@ public:
 	// Getter for default value
 	T getDefVal() { return this->def_val; }
 
-	// Gets string expressing sunction signature and documentation which can be
-	// printed to a Lua config file
-	std::string getLuaString();
+	// Getter for snapshotted value
+	const std::vector<std::vector<std::vector<T>>> &getValue() { return this->value; }
+
+	// Writes the default value and documentation to a Lua config file
+	void writeLua(std::ostream &out);
+
+	// Writes the snapshotted value as a constexpr C++ array. Ragged arrays
+	// can't be written
+	bool writeFrozen(std::ostream &out);
+
+	// Reads parameter value out of the config file into the snapshot
+	bool snapshot(lua_State *L);
+
+	// Packs the snapshot into, and unpacks it from, the binary form shared
+	// between processes
+	bool pack(std::string &out);
+	bool unpack(const char *data, size_t size, bool &changed);
 
 	// Getter for array dimensions
 	std::vector<size_t> getDims() { return std::vector<size_t> { this->def_val.size(), this->def_val[0].size(), this->def_val[0][0].size() }; };
 };
 
 /*
- * structs used for generating lists of std::placeholders for std::bind with 
- * variadic function templates
+ * TypedParam specialization for flat arrays of any rank
  */
-template<int...> 
-struct int_sequence {};
+template <typename T>
+class TypedParam<NDArray<T>> : public Param {
+private:
+	// Default value of parameter
+	NDArray<T> def_val;
+
+	// Value of parameter in the config file snapshot. Only filled in on
+	// demand if the value is a mapped sidecar file
+	NDArray<T> value;
+
+	// Sidecar file the value is mapped from, null if it is a Lua table
+	std::shared_ptr<LuaMappedArray> mapped;
+
+	// Name of the sidecar file the default value was written to by
+	// writeSidecar, empty if it is written as a Lua table
+	std::string sidecar;
+
+public:
+	// Constructors
+	TypedParam(std::string id, NDArray<T> def_val);
+	TypedParam(std::string id, NDArray<T> def_val, std::string doc);
+
+	// Getter for default value
+	const NDArray<T> &getDefVal() { return this->def_val; }
+
+	// Getter for snapshotted value. Copies a mapped value the first time
+	const NDArray<T> &getValue();
+
+	// Gets a view of the snapshotted value. Mapped values are not copied, and
+	// the view stays valid until a reload changes the parameter
+	NDView<const T> getView() { return this->mapped ? this->mapped->template view<T>() : NDView<const T>(this->value.data(), this->value.getShape()); }
+
+	// Writes the default value, or a reference to its sidecar file, and
+	// documentation to a Lua config file
+	void writeLua(std::ostream &out);
+
+	// Writes the snapshotted value as a constexpr C++ constant
+	bool writeFrozen(std::ostream &out);
 
-template<int N, int... Is> 
-struct make_int_sequence
-    : make_int_sequence<N-1, N-1, Is...> {};
+	// Reads parameter value out of the config file into the snapshot, either
+	// from a Lua table or by mapping a sidecar file. The rank must match that
+	// of the default value
+	bool snapshot(lua_State *L);
 
-template<int... Is> 
-struct make_int_sequence<0, Is...>
-    : int_sequence<Is...> {};
+	// Packs the snapshot into, and unpacks it from, the binary form shared
+	// between processes
+	bool pack(std::string &out);
+	bool unpack(const char *data, size_t size, bool &changed);
 
-template<int> // begin with 0 here!
-struct placeholder_template {};
+	// Writes the default value to a sidecar file in dir if it has at least
+	// threshold elements, so writeLua references it
+	bool writeSidecar(std::string dir, size_t threshold);
 
-namespace std
-{
-	template<int N>
-	struct std::is_placeholder< placeholder_template<N> >
-    	: std::integral_constant<int, N+1> {};
-}
+	// Getter for array dimensions
+	std::vector<size_t> getDims() { return this->def_val.getShape(); };
+};
+
+/*
+ * BatchParam: base class for function parameters which can also be read in
+ *		batched form. Lets the batched form be looked up by its own type
+ */
+template <typename ...bargs>
+class BatchParam : public Param {
+public:
+	// Reads the batched form of the Lua function and binds it to a std::function
+	virtual std::function<void(int, bargs...)> getLuaBatchFunc() = 0;
 
+	// Gets most recently compiled batched form of the function
+	virtual std::function<void(int, bargs...)> getMostRecentBatch() = 0;
+};
 
 /*
  * TypedParam specialization for function types
  */
 template <typename ...args>
-class TypedParam<std::function<void(args...)>> : public Param {
+class TypedParam<std::function<void(args...)>> : public BatchParam<typename lua_batcharg<args>::type...> {
 private:
 	// Default value of function
 	std::function<void(args...)> def_val;
 
-	// Most recently compiled version of the function
-	std::function<void(args...)> most_recent = this->def_val;
+	// Callables the function and its batched form are bound to
+	typedef LuaBinding<LuaFunc<args...>, args...> Binding;
+	typedef LuaBinding<LuaBatchFunc<args...>, int, typename lua_batcharg<args>::type...> BatchBinding;
+
+	// Versions of the function. Each snapshot which rebinds it publishes a
+	// new version, and handles returned by getMostRecent call the latest one
+	std::shared_ptr<LuaVersioned<Binding>> most_recent = std::make_shared<LuaVersioned<Binding>>(this->def_val);
+
+	// Versions of the batched form of the function, bound on demand
+	std::shared_ptr<LuaVersioned<BatchBinding>> most_recent_batch = std::make_shared<LuaVersioned<BatchBinding>>();
+
+	// Whether the batched form is bound to the function in the snapshot
+	bool batch_bound = false;
+
+	// Registry reference to the Lua function in the config file snapshot
+	std::shared_ptr<LuaRef> lua_func;
+
+	// Owner of L, shared with the references to the function taken from it
+	std::shared_ptr<lua_State> owner;
+
+	// Fingerprint of the bound Lua function, 0 if it couldn't be taken
+	uint64_t fingerprint = 0;
 
 	// Lua execution state the function definition will be found in
 	lua_State *L;
 
+	// Pool of per thread Lua states, and the first of the two slots the
+	// function and its batched form are bound to in them. Null unless threads
+	// are enabled
+	std::shared_ptr<LuaStatePool> pool;
+	int slot = 0;
+
+	// Number of entries in the result cache of each binding of the function,
+	// 0 unless it was declared pure, and the cache of the current binding
+	size_t memo_entries = 0;
+	std::shared_ptr<LuaMemo> memo;
+
+	// Domain the function is sampled over, of rank 0 unless it is tabulated,
+	// the error of the current table and its batched form
+	LuaTableSpec table_spec = {};
+	double table_error = 0;
+	std::function<void(int, typename lua_batcharg<args>::type...)> table_batch;
+
+	// Compiler of the native tier, null unless the function is compiled to C
+	std::shared_ptr<NativeCompiler> native;
+
+	// Batched form of the current binding if it calls C++ or C directly,
+	// which it does for native functions and the default
+	std::function<void(int, typename lua_batcharg<args>::type...)> direct_batch;
+
+	// Whether the config file leaves the function to its default, by setting
+	// it to nil or lejit.default or keeping the stub definition
+	bool uses_default = false;
+
+	// Call statistics, kept across reloads
+#ifdef LEJIT_NO_STATS
+	std::shared_ptr<LuaStats> stats;
+#else
+	std::shared_ptr<LuaStats> stats = std::make_shared<LuaStats>();
+#endif
+
 	// String encoding signature of the interal function
 	std::string signature;
 
@@ -219,16 +468,16 @@ private:
 
 public:
 	// Constructors
-	TypedParam(lua_State *L, std::string id, std::function<void(args...)> def_val) : TypedParam(L, id, "", def_val) {}
-	TypedParam(lua_State *L, std::string id, std::function<void(args...)> def_val, std::string doc) : TypedParam(L, id, "", def_val, doc) {}
-	TypedParam(lua_State *L, std::string id, std::string signature, std::function<void(args...)> def_val);
-	TypedParam(lua_State *L, std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc);
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, std::function<void(args...)> def_val) : TypedParam(L, id, "", def_val) {}
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, std::function<void(args...)> def_val, std::string doc) : TypedParam(L, id, "", def_val, doc) {}
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, std::string signature, std::function<void(args...)> def_val);
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, std::string signature, std::function<void(args...)> def_val, std::string doc);
 
 	// Constructors that take and convert a function pointer (important note: no way to readParam() to a function pointer)
-	TypedParam(lua_State *L, std::string id, void(*def_val)(args...)) : TypedParam(L, id, static_cast<std::function<void(args...)>>(def_val)) {}
-	TypedParam(lua_State *L, std::string id, void(*def_val)(args...), std::string doc) : TypedParam(L, id, static_cast<std::function<void(args...)>>(def_val), doc) {}
-	TypedParam(lua_State *L, std::string id, std::string signature, void(*def_val)(args...)) : TypedParam(L, id, signature, static_cast<std::function<void(args...)>>(def_val)) {}
-	TypedParam(lua_State *L, std::string id, std::string signature, void(*def_val)(args...), std::string doc) : TypedParam(L, id, signature, static_cast<std::function<void(args...)>>(def_val), doc) {}
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, void(*def_val)(args...)) : TypedParam(L, id, static_cast<std::function<void(args...)>>(def_val)) {}
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, void(*def_val)(args...), std::string doc) : TypedParam(L, id, static_cast<std::function<void(args...)>>(def_val), doc) {}
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, std::string signature, void(*def_val)(args...)) : TypedParam(L, id, signature, static_cast<std::function<void(args...)>>(def_val)) {}
+	TypedParam(std::shared_ptr<lua_State> L, std::string id, std::string signature, void(*def_val)(args...), std::string doc) : TypedParam(L, id, signature, static_cast<std::function<void(args...)>>(def_val), doc) {}
 
 	// Getter for default value
 	std::function<void(args...)> getDefVal() { return this->def_val; }
@@ -236,17 +485,57 @@ public:
 	// Getter for number of arguments taken by internal function
 	size_t getNumArgs() { return this->num_args; }
 
-	// Gets most recently compiled version of the function
-	std::function<void(args...)> getMostRecent() { return this->most_recent; }
+	// Gets a handle which always calls the most recently compiled version of
+	// the function, including versions compiled after it was taken
+	std::function<void(args...)> getMostRecent() { auto v = this->most_recent; return [v](args... a) { (*v)(a...); }; }
+
+	// Same as getMostRecent, for the batched form of the function
+	std::function<void(int, typename lua_batcharg<args>::type...)> getMostRecentBatch() { auto v = this->most_recent_batch; return [v](int n, typename lua_batcharg<args>::type... a) { (*v)(n, a...); }; }
 
-	// Gets string expressing sunction signature and documentation which can be
-	// printed to a Lua config file
-	std::string getLuaString();
+	// Gets the version number of the function, incremented each time it is rebound
+	unsigned long getVersion() { return this->most_recent->version(); }
 
-	// Reads Lua function out of config file and binds it to a std::function, 
-	// which it returns
+	// Calls most recently compiled version of the function without copying it
+	void callMostRecent(args... a) { (*this->most_recent)(a...); }
+	void callMostRecentBatch(int n, typename lua_batcharg<args>::type... a) { if (!this->batch_bound) this->getLuaBatchFunc(); (*this->most_recent_batch)(n, a...); }
+
+	// Writes a stub definition with the signature and documentation to a Lua
+	// config file
+	void writeLua(std::ostream &out);
+
+	// Binds the Lua function to most_recent if the config file defines it and
+	// it differs from the bound one, or the default if the config file leaves
+	// the function to it
+	bool snapshot(lua_State *L);
+
+	// Routes calls to the Lua state of the calling thread from the next snapshot on
+	void setStatePool(std::shared_ptr<LuaStatePool> pool);
+
+	// Gets the call statistics of the function
+	std::shared_ptr<LuaStats> getStats() { return this->stats; }
+
+	// Declares the function pure, caching its results in front of the Lua
+	// calls. Its signature may only hold scalars
+	void setPure(size_t entries);
+
+	// Serves calls from a table sampled from the Lua function each time it is
+	// bound. Only for d>d and dd>d functions
+	void setTabulated(const LuaTableSpec &spec);
+
+	// Gets the largest interpolation error measured for the current table
+	double getTableError() { return this->table_error; }
+
+	// Compiles the Lua function to C each time it is bound, if it only uses
+	// the subset of Lua the native tier supports
+	void setNative(std::shared_ptr<NativeCompiler> compiler);
+
+	// Binds the Lua function in the config file snapshot to a std::function, 
+	// or the default if there is none, publishes it as the newest version and
+	// returns it
 	std::function<void(args...)> getLuaFunc();
-	template<int ...Is> std::function<void(args...)> getLuaFunc(int_sequence<Is...>);
+
+	// Same as getLuaFunc, but for the batched form of the function
+	std::function<void(int, typename lua_batcharg<args>::type...)> getLuaBatchFunc();
 };
 
 #endif
\ No newline at end of file
@@ -116,42 +116,33 @@ int main(int argc, char *argv[])
 	// Create new config file with default name "config.lua"
 	LEJITReader *lr = new LEJITReader();
 
-	// Register each configurable parameter with LEJIT
-	lr->registerParam("planetnum", planetnum, 
+	// Bind each configurable parameter to its variable
+	lr->bindParam("planetnum", planetnum, 
 		"Planetnum: number of planet to simulate i.e. 1 = Mercury, 2 = Venus, etc.");
 
-	lr->registerParam("numrevs", numrevs,
+	lr->bindParam("numrevs", numrevs,
 		"Numrevs: the number of revolutions around the Sun to simulate");
 
-	lr->registerParam("nout", nout,
+	lr->bindParam("nout", nout,
 		"Nout: The number of steps performed between each output data point.");
 
-	lr->registerParam("teststring", teststring);
+	lr->bindParam("teststring", teststring);
 
-	lr->registerParam("do_calc", "ii>i", do_calc, "A test callback std::function");
+	lr->bindParam("do_calc", "ii>i", do_calc, "A test callback std::function");
 
-	lr->registerParam("arr_func", arr_func, "A test std::function which takes an array argument");
+	lr->bindParam("arr_func", arr_func, "A test std::function which takes an array argument");
 
-	lr->registerParam("testarr", testarr);
+	lr->bindParam("testarr", testarr);
 
-	lr->registerParam("testarr2d", testarr2d);
+	lr->bindParam("testarr2d", testarr2d);
 
-	lr->registerParam("testarr3d", testarr3d);
+	lr->bindParam("testarr3d", testarr3d);
 
-	lr->registerParam("testvec", testvec);
+	lr->bindParam("testvec", testvec);
 
-	// Write config file. If it already exists, instead read parameter values out of it
+	// Write config file. If it already exists, instead read every bound parameter out of it
 	if(!lr->writeConfigFile()) {
-		lr->readParam("planetnum", planetnum);
-		lr->readParam("numrevs", numrevs);
-		lr->readParam("nout", nout);
-		lr->readParam("teststring", teststring);
-		lr->readParam("do_calc", do_calc);
-		lr->readParam("arr_func", arr_func);
-		lr->readParam("testarr", testarr);
-		lr->readParam("testarr2d", testarr2d);
-		lr->readParam("testarr3d", testarr3d);
-		lr->readParam("testvec", testvec);
+		lr->refreshAll();
 	}
 
 	// Test that parameters have been read correctly
@@ -11,7 +11,7 @@ int main(int argc, char *argv[])
 	// Register params
 	LEJITReader_RegisterInt(reader, "testint", 42);
 	LEJITReader_RegisterFunction_ii(reader, "testfunc");
-	LEJITReader_RegisterFunction_adad(reader, "testarrfunc");
+	LEJITFunc_C *testarrfunc = LEJITReader_RegisterFunction_adad(reader, "testarrfunc");
 
 	// Write config file
 	LEJITReader_WriteConfigFile(reader);
@@ -28,6 +28,10 @@ int main(int argc, char *argv[])
 	double arr0[3] = {1.0, 2.0, 3.0};
 	double arr1[3] = {4.0, 5.0, 6.0};
 	LEJITReader_ReadFunction_adad(reader, "testarrfunc");
-	LEJITReader_CallFunction_adad(reader, "testarrfunc", arr0, arr1);
+	// Call through the handle, skipping the lookup by name
+	LEJITFunc_Call_adad(testarrfunc, arr0, arr1);
 	printf("arr0[0] = %f\n", arr0[0]);
+
+	// Free reader
+	LEJITReader_Destroy(reader);
 }
\ No newline at end of file
@@ -28,7 +28,7 @@ end
 SEED = 123
 N = 100
 MC_ITERATIONS = 1000000
-SOR_ITERATIONS = 10000
+SOR_ITERATIONS = 1000
 OMEGA = 1.25
 
 --[[ LU DECOMPOSITION ]]--
@@ -132,6 +132,18 @@ function lua_montecarlo()
 	return ((under_curve / MC_ITERATIONS) * 4.0)
 end
 
+-- Takes Monte Carlo sample number i. The point is generated from i alone, so
+-- samples can be taken in any order by any thread
+function lua_mcsample(i)
+	local x = ((i * 1103515245 + 12345) % 2147483648) / 2147483648
+	local y = ((i * 22695477 + 1) % 2147483648) / 2147483648
+
+	if (x*x + y*y <= 1.0) then
+		return 1
+	end
+	return 0
+end
+
 
 --[ SOR ]--
 
@@ -146,6 +158,14 @@ function lua_sor1loop(omega_over_four, one_minus_omega, Gi, Gim1, Gip1)
 	end
 end
 
+-- Gi, Gim1 and Gip1 are zero-based FFI cdata pointers
+function lua_sor1loop_cdata(omega_over_four, one_minus_omega, Gi, Gim1, Gip1)
+	Nm1 = N - 1
+	for j = 1, Nm1 - 1 do
+		Gi[j] = omega_over_four * (Gim1[j] + Gip1[j] + Gi[j-1] + Gi[j+1]) + one_minus_omega * Gi[j]
+	end
+end
+
 function lua_sor()
 	math.randomseed(SEED)
 
@@ -178,3 +198,21 @@ function lua_sor()
 	end
 	return sum
 end
+
+--[[ TABLE CONVERSION ]]--
+
+function lua_maketable(rows, cols)
+	local t = {}
+	for i = 1, rows do
+		if cols > 0 then
+			local row = {}
+			for j = 1, cols do
+				row[j] = i + j * 0.5
+			end
+			t[i] = row
+		else
+			t[i] = i * 0.5
+		end
+	end
+	big_table = t
+end
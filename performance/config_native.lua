@@ -0,0 +1,56 @@
+--[[							   ]]--
+--[[  NATIVE TIER CHECK FUNCTIONS  ]]--
+--[[							   ]]--
+
+-- Each function is called both through Lua and compiled to C by
+-- nativecheck.cpp, which compares the results
+
+OFFSET = 1.5
+
+--[[ SCALAR ]]--
+
+function check_poly(x)
+	return 3 * x * x - 2 * x + math.sqrt(math.abs(x)) + OFFSET
+end
+
+-- Modulo is floored in Lua, so the result has the sign of b
+function check_fmod(x, y)
+	return x % y
+end
+
+function check_mod(a, b)
+	return a % b
+end
+
+function check_countdown(n)
+	local s = 0
+	for i = n, 1, -3 do
+		s = i - s
+	end
+	return s
+end
+
+-- The direction of the loop is only known at run time
+function check_step(n, step)
+	local s = 0
+	for i = n, -n, step do
+		s = s + i * i - i
+	end
+	return s
+end
+
+--[[ ARRAYS ]]--
+
+function check_axpy(n, a, x, y)
+	for i = 1, n do
+		y[i] = a * x[i] + y[i] % 3
+	end
+end
+
+function check_horner(n, x)
+	local s = 0
+	for i = n, 1, -1 do
+		s = s * 0.5 + x[i]
+	end
+	return s
+end
@@ -0,0 +1,158 @@
+/*
+ * 	 _____     ________     _____  _____  _________
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  |
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_|
+ * 	  | |   _   |  _| _  _   | |    | |      | |
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_
+ *	|________||________|`.____.'  |_____|  |_____|
+ *
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * memocheck.cpp
+ *
+ * Checks the result cache of pure function parameters when it is used from
+ * several threads at once
+ * To run, make check, or make memocheck and ./memocheck. Build it with
+ * -fsanitize=thread to also check it for data races
+ *
+ * The cached function returns its result together with the version of the
+ * function it was computed with. A clearing thread bumps the version before
+ * each clear, as a reload does when it changes the function, while the other
+ * threads call the function through the cache. Every result must be correct
+ * for its arguments, and no call may be served a result computed with a
+ * version older than the cache generation it started in. Exits with status 1
+ * if either is ever wrong, or if there were no hits or no misses
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../LEJIT/Lejit.hpp"
+
+#define MEMO_ENTRIES 4096						// Entries in the result cache
+#define NUM_THREADS 4							// Threads calling the function
+#define CALLS_PER_THREAD 200000					// Calls made by each of them
+#define CLEAR_INTERVAL 50000					// Calls between clears
+#define NUM_ARGS 50								// Distinct values of each argument
+
+
+/* Check harness */
+
+static std::atomic<int> checks(0), failures(0);
+
+/*
+ * check: counts a check, and reports it if it failed
+ */
+static void check(bool ok, const char *what)
+{
+	checks++;
+	if (!ok && failures++ < 10) {
+		printf("%s\n", what);
+	}
+}
+
+// Version of the cached function, bumped before each clear
+static std::atomic<int> version(1);
+
+// Number of times the cached function was called
+static std::atomic<long> calls(0);
+
+/*
+ * pure: function with cached results. The result only depends on x and k,
+ *		the version is returned to detect results from an older generation
+ */
+static void pure(double x, int k, double *result, int *result_version)
+{
+	calls++;
+	*result = x * k + 0.5;
+	*result_version = version.load();
+}
+
+
+/* Checks */
+
+/*
+ * checkSingle: hits, misses and clears from a single thread
+ */
+static void checkSingle()
+{
+	std::shared_ptr<LuaStats> stats = std::make_shared<LuaStats>();
+	LuaMemoFunc<double,int,double*,int*> memo_func(pure, MEMO_ENTRIES, stats);
+	double result;
+	int result_version;
+
+	long before = calls;
+	memo_func(1.5, 3, &result, &result_version);
+	memo_func(1.5, 3, &result, &result_version);
+	check(calls == before + 1, "second call with the same arguments wasn't a hit");
+	check(result == 1.5 * 3 + 0.5, "hit returned the wrong result");
+
+	memo_func.getMemo()->clear();
+	memo_func(1.5, 3, &result, &result_version);
+	check(calls == before + 2, "call after a clear wasn't a miss");
+}
+
+/*
+ * checkThreads: NUM_THREADS threads calling through one cache, the first of
+ *		them also bumping the version and clearing it every CLEAR_INTERVAL
+ *		calls
+ */
+static void checkThreads()
+{
+	std::shared_ptr<LuaStats> stats = std::make_shared<LuaStats>();
+	LuaMemoFunc<double,int,double*,int*> memo_func(pure, MEMO_ENTRIES, stats);
+	std::shared_ptr<LuaMemo> memo = memo_func.getMemo();
+
+	// The version and the generation are bumped in lockstep from here on, so
+	// generation g is only ever current while the version is at least g
+	version = (int) memo->generation();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < NUM_THREADS; t++) {
+		threads.emplace_back([&memo_func, &memo, t] {
+			for (int i = 0; i < CALLS_PER_THREAD; i++) {
+				double x = ((i * 7 + t) % NUM_ARGS) * 0.25;
+				int k = i % 13 - 6;
+
+				int generation = (int) memo->generation();
+				double result;
+				int result_version;
+				memo_func(x, k, &result, &result_version);
+
+				check(result == x * k + 0.5, "call was served the wrong result");
+				check(result_version >= generation, "call was served a result from before a clear");
+
+				if (t == 0 && i % CLEAR_INTERVAL == CLEAR_INTERVAL - 1) {
+					version++;
+					memo->clear();
+				}
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	LuaStatsValues values = stats->get();
+	printf("%d threads: %lu hits, %lu misses\n", NUM_THREADS, (unsigned long) values.memo_hits, (unsigned long) values.memo_misses);
+#ifndef LEJIT_NO_STATS
+	check(values.memo_hits > 0, "no call was a hit");
+	check(values.memo_misses > 0, "no call was a miss");
+	check(values.memo_hits + values.memo_misses == (uint64_t) NUM_THREADS * CALLS_PER_THREAD, "hits and misses don't add up to the calls");
+#endif
+}
+
+int main()
+{
+	checkSingle();
+	checkThreads();
+
+	printf("%d of %d checks passed\n", checks - failures, (int) checks);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * 	 _____     ________     _____  _____  _________
+ *	|_   _|   |_   __  |   |_   _||_   _||  _   _  |
+ * 	  | |       | |_ \_|     | |    | |  |_/ | | \_|
+ * 	  | |   _   |  _| _  _   | |    | |      | |
+ *	 _| |__/ | _| |__/ || |__' |   _| |_    _| |_
+ *	|________||________|`.____.'  |_____|  |_____|
+ *
+ *			  Lua Easy Just In Time Library
+ *						Version 1.0
+ *			  Los Alamos National Laboratory
+ *
+ * nativecheck.cpp
+ *
+ * Checks that function parameters compiled to C with setNative compute the
+ * same results as the Lua functions they were compiled from
+ * To run, make check, or make nativecheck and ./nativecheck
+ *
+ * Every function in config_native.lua is read from two readers, one calling
+ * it in Lua and one compiled to C, and both are called with the same
+ * arguments, including negative operands of modulo and numeric for loops
+ * counting down. Exits with status 1 if any result differs, or if a function
+ * wasn't compiled natively
+ *
+ * It also checks that a config file sharing its bytecode cache with an
+ * identical file elsewhere is compiled from its own source
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "../LEJIT/Lejit.hpp"
+
+#define NATIVE_FILENAME "config_native.lua"
+#define ARRAY_LENGTH 7							// Elements in array arguments
+#define TOLERANCE 1e-12							// Relative difference allowed between results
+
+
+/* Check harness */
+
+static int checks = 0, failures = 0;
+
+/*
+ * compare: counts a check, and reports it if the Lua and native results
+ *		differ by more than TOLERANCE
+ */
+static void compare(std::string call, double lua, double native)
+{
+	checks++;
+	if (lua == native || fabs(lua - native) <= TOLERANCE * fabs(lua)) {
+		return;
+	}
+	failures++;
+	printf("%-40s Lua %.17g, native %.17g\n", call.c_str(), lua, native);
+}
+
+/*
+ * NativeCheck: the functions of config_native.lua read from a reader calling
+ *		them in Lua and one compiling them to C
+ */
+class NativeCheck {
+private:
+	LEJITReader *lua_lr, *native_lr;
+
+	// Ids of the functions read, to check that they were compiled
+	std::vector<std::string> ids;
+
+public:
+	NativeCheck() : lua_lr(new LEJITReader(NATIVE_FILENAME)), native_lr(new LEJITReader(NATIVE_FILENAME)) {}
+	~NativeCheck() { delete this->lua_lr; delete this->native_lr; }
+
+	// Registers and reads a function from both readers
+	template <typename ...args> void read(std::string id, std::string signature, std::function<void(args...)> &lua, std::function<void(args...)> &native)
+	{
+		this->lua_lr->registerParam(id, signature, lua);
+		this->lua_lr->readParam(id, lua);
+
+		this->native_lr->registerParam(id, signature, native);
+		this->native_lr->setNative(id);
+		this->native_lr->readParam(id, native);
+
+		this->ids.push_back(id);
+	}
+
+	// Reports functions whose native reader called Lua
+	void checkCompiled()
+	{
+		for (std::string &id : this->ids) {
+			checks++;
+			if (this->native_lr->getStats(id).calls) {
+				failures++;
+				printf("%-40s was not compiled natively\n", id.c_str());
+			}
+		}
+	}
+};
+
+
+/* Checks */
+
+/*
+ * checkScalar: d>d, dd>d, ii>i and i>i functions
+ */
+static void checkScalar(NativeCheck &nc)
+{
+	std::function<void(double,double*)> lua_poly, native_poly;
+	std::function<void(double,double,double*)> lua_fmod, native_fmod;
+	std::function<void(int,int,int*)> lua_mod, native_mod, lua_step, native_step;
+	std::function<void(int,int*)> lua_countdown, native_countdown;
+
+	nc.read("check_poly", "d>d", lua_poly, native_poly);
+	nc.read("check_fmod", "dd>d", lua_fmod, native_fmod);
+	nc.read("check_mod", "ii>i", lua_mod, native_mod);
+	nc.read("check_countdown", "i>i", lua_countdown, native_countdown);
+	nc.read("check_step", "ii>i", lua_step, native_step);
+
+	double x[] = { -3.75, -1.0, -0.5, 0.0, 0.25, 1.0, 2.5, 1e6 };
+	double y[] = { -2.5, -1.0, 0.75, 3.0 };
+	int a[] = { -7, -6, -1, 0, 1, 5, 7, 100 };
+	int b[] = { -3, -1, 2, 3, 7 };
+	int steps[] = { -4, -1, 1, 3 };
+
+	for (double xi : x) {
+		double lua, native;
+		lua_poly(xi, &lua);
+		native_poly(xi, &native);
+		compare("check_poly(" + std::to_string(xi) + ")", lua, native);
+
+		for (double yi : y) {
+			lua_fmod(xi, yi, &lua);
+			native_fmod(xi, yi, &native);
+			compare("check_fmod(" + std::to_string(xi) + ", " + std::to_string(yi) + ")", lua, native);
+		}
+	}
+
+	for (int ai : a) {
+		int lua, native;
+		for (int bi : b) {
+			lua_mod(ai, bi, &lua);
+			native_mod(ai, bi, &native);
+			compare("check_mod(" + std::to_string(ai) + ", " + std::to_string(bi) + ")", lua, native);
+		}
+
+		lua_countdown(ai, &lua);
+		native_countdown(ai, &native);
+		compare("check_countdown(" + std::to_string(ai) + ")", lua, native);
+
+		for (int step : steps) {
+			lua_step(ai, step, &lua);
+			native_step(ai, step, &native);
+			compare("check_step(" + std::to_string(ai) + ", " + std::to_string(step) + ")", lua, native);
+		}
+	}
+}
+
+/*
+ * checkArrays: functions taking arrays, written in place or reduced
+ */
+static void checkArrays(NativeCheck &nc)
+{
+	std::function<void(int,double,double*,double*)> lua_axpy, native_axpy;
+	std::function<void(int,double*,double*)> lua_horner, native_horner;
+
+	nc.read("check_axpy", "idad1ad1", lua_axpy, native_axpy);
+	nc.read("check_horner", "iad1>d", lua_horner, native_horner);
+
+	double x[ARRAY_LENGTH], lua_y[ARRAY_LENGTH], native_y[ARRAY_LENGTH];
+	for (int i = 0; i < ARRAY_LENGTH; i++) {
+		x[i] = 1.25 * i - 4;
+		lua_y[i] = native_y[i] = 2.5 - 1.5 * i;
+	}
+
+	lua_axpy(ARRAY_LENGTH, -0.5, x, lua_y);
+	native_axpy(ARRAY_LENGTH, -0.5, x, native_y);
+	for (int i = 0; i < ARRAY_LENGTH; i++) {
+		compare("check_axpy y[" + std::to_string(i) + "]", lua_y[i], native_y[i]);
+	}
+
+	for (int n = 0; n <= ARRAY_LENGTH; n++) {
+		double lua, native;
+		lua_horner(n, x, &lua);
+		native_horner(n, x, &native);
+		compare("check_horner(" + std::to_string(n) + ")", lua, native);
+	}
+}
+
+/*
+ * writeFile: writes a config file defining g
+ */
+static void writeFile(std::string filename, std::string body)
+{
+	std::ofstream file(filename);
+	file << "g = function(x)\n\treturn " << body << "\nend\n";
+}
+
+/*
+ * checkSharedCache: two identical config files in different directories share
+ *		a bytecode cache. After the first is loaded and then edited, the
+ *		second must still be compiled natively from its own source
+ */
+static void checkSharedCache()
+{
+	char tmp[] = "/tmp/nativecheckXXXXXX";
+	if (!mkdtemp(tmp)) {
+		checks++;
+		failures++;
+		printf("unable to create a temporary directory\n");
+		return;
+	}
+	std::string dir = tmp;
+	mkdir((dir + "/a").c_str(), 0700);
+	mkdir((dir + "/b").c_str(), 0700);
+	writeFile(dir + "/a/config.lua", "x * 2");
+	writeFile(dir + "/b/config.lua", "x * 2");
+
+	std::function<void(double,double*)> g_a, g_b;
+	double result;
+	{
+		LEJITReader lr(dir + "/a/config.lua");
+		lr.setBytecodeCache(dir + "/cache");
+		lr.registerParam("g", "d>d", g_a);
+		lr.readParam("g", g_a);
+	}
+	writeFile(dir + "/a/config.lua", "x * 3");
+	{
+		LEJITReader lr(dir + "/b/config.lua");
+		lr.setBytecodeCache(dir + "/cache");
+		lr.registerParam("g", "d>d", g_b);
+		lr.setNative("g");
+		lr.readParam("g", g_b);
+		g_b(10, &result);
+	}
+	compare("g(10) with a shared bytecode cache", 20, result);
+
+	system(("rm -rf " + dir).c_str());
+}
+
+int main()
+{
+	NativeCheck nc;
+
+	checkScalar(nc);
+	checkArrays(nc);
+	nc.checkCompiled();
+	checkSharedCache();
+
+	printf("%d of %d checks passed\n", checks - failures, checks);
+	return failures ? 1 : 0;
+}
@@ -14,15 +14,32 @@
  * performancetest.cpp
  *
  * Performance tests for C++ and LEJIT
- * To run, simply make and ./performancetest
- * Can change test parameters below and comment out unwanted tests
- * in the main thread if desired
+ * To run, simply make and ./performancetest, or make benchmark to also write
+ * the results to results.json and results.csv
+ *
+ * Usage: ./performancetest [--warmup W] [--reps R] [--filter GROUP]
+ *			[--json FILE] [--csv FILE]
+ *
+ * Each benchmark is set up once (creating its LEJITReader and reading its
+ * functions, untimed), run W times to warm up the JIT, then timed R times.
+ * Inputs are reset before every run, outside of the timed region. The median,
+ * 95th percentile and minimum wall time of the timed runs are reported, along
+ * with the median time per call. A call is one evaluation of the innermost
+ * kernel (one square, one multiply-subtract, one Monte Carlo sample, one SOR
+ * point update), counted the same way for every variant of a benchmark.
+ * Each variant's checksum is compared with the first variant of its group, and
+ * the exit status is 1 if any differ
  *
  */
 
 #include <stdio.h>
-#include <time.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <map>
 
 #include "../LEJIT/Lejit.hpp"
 
@@ -34,402 +51,351 @@
 #define MC_ITERATIONS 1000000					// Iterations for Monte Carlo test
 #define SOR_ITERATIONS 1000						// Iterations for SOR test
 #define OMEGA 1.25								// Parameter for SOR
-#define REPS 10									// Number of times to repeat tests in "reps" functions
+#define WARMUP 2								// Default number of untimed runs of each benchmark
+#define REPS 10									// Default number of timed runs of each benchmark
 #define LUA_FILENAME "config.lua"
 #define FFI_FILENAME "config_ffi.lua"
-#define INSITU_FILENAME "config_insitu.lua"
 
+// Number of multiply-subtracts in an N x N LU decomposition
+#define LU_CALLS ((long) (N - 1) * N * (2 * N - 1) / 6)
 
-/* Square tests - testing the speed of calling a function to square an int */
+// Number of point updates in SOR_ITERATIONS sweeps of SOR
+#define SOR_CALLS ((long) SOR_ITERATIONS * (N - 2) * (N - 2))
+#define TABLE_ELEMENTS 1000000						// Elements in table conversion tests
+#define TABLE_COLS 1000							// Columns of 2D table conversion tests
 
-int CFunction(int val)
-{
-	return val * val;
-}
-int LuaJITFunction(lua_State *L, int val)
-{
-	lua_getglobal(L, "lua_square");
-	lua_pushnumber(L, val);
-	lua_pcall(L, 1, 1, 0);
-	int retval = lua_tointeger(L, -1);
-	lua_pop(L, 1);
-	return retval;
-}
-void CTest_sameval()
-{
-	clock_t t = clock();
 
-	for (int i = 0; i < NUM_ITERATIONS; i++) {
-		CFunction(100);
-	}
+/* Benchmark harness */
 
-	t = clock() - t;
-	printf("C++ test with same argument repeated: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
-}
-void CTest_incval() 
-{
-	clock_t t = clock();
+/*
+ * Benchmark: one variant of a benchmark. Set up by the constructor and torn
+ *		down by the destructor, neither of which is timed
+ */
+class Benchmark {
+public:
+	virtual ~Benchmark() {}
 
-	for (int i = 0; i < NUM_ITERATIONS; i++) {
-		CFunction(i);
-	}
+	// Resets inputs before each run, untimed
+	virtual void reset() {}
 
-	t = clock() - t;
-	printf("C++ test with incrementing arguments: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
-}
-void LuaJITTest_sameval()
-{	
-	clock_t t = clock();
-
-	lua_State *L = luaL_newstate();
-	if (luaL_loadfile(L, LUA_FILENAME) || lua_pcall(L, 0, 0, 0)) {
-		lua_error(L);
-		return;
-	}
+	// Timed part of the benchmark. Returns a checksum of the result
+	virtual double run() = 0;
+};
 
-	for (int i = 0; i < NUM_ITERATIONS; i++) {
-		LuaJITFunction(L, 100);
-	}
+/*
+ * LejitBenchmark: benchmark owning a LEJITReader. The reader is deleted after
+ *		the functions read from it, which are members of derived classes
+ */
+class LejitBenchmark : public Benchmark {
+protected:
+	LEJITReader *lr;
 
-	t = clock() - t;
-	printf("LuaJIT test with same argument repeated: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
-}
-void LuaJITTest_incval()
-{	
-	clock_t t = clock();
-
-	lua_State *L = luaL_newstate();
-	if (luaL_loadfile(L, LUA_FILENAME) || lua_pcall(L, 0, 0, 0)) {
-		lua_error(L);
-		return;
-	}
+public:
+	LejitBenchmark(std::string filename) : lr(new LEJITReader(filename)) {}
+	~LejitBenchmark() { delete this->lr; }
+};
 
-	for (int i = 0; i < NUM_ITERATIONS; i++) {
-		LuaJITFunction(L, i);
-	}
+/*
+ * BenchmarkCase: name of a benchmark variant, its number of calls per run
+ *		and how to create it
+ */
+struct BenchmarkCase {
+	std::string group;
+	std::string variant;
+	long calls;
+	std::function<Benchmark*()> create;
+	// True if the checksum can't be compared with the rest of the group, e.g.
+	// because the variant generates its own input in Lua or returns nothing
+	bool unchecked;
+};
 
-	t = clock() - t;
-	printf("LuaJIT test with incrementing arguments: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
-}
-void LuaJITTest_sameval_loop()
-{	
-	clock_t t = clock();
-
-	lua_State *L = luaL_newstate();
-	if (luaL_loadfile(L, LUA_FILENAME) || lua_pcall(L, 0, 0, 0)) {
-		lua_error(L);
-		return;
-	}
-	
-	lua_getglobal(L, "lua_square_loop_same");
-	lua_pushnumber(L, NUM_ITERATIONS);
-	lua_pcall(L, 1, 0, 0);
+/*
+ * BenchmarkResult: statistics of the timed runs of one benchmark variant
+ */
+struct BenchmarkResult {
+	std::string group;
+	std::string variant;
+	int reps;
+	long calls;
+	double min, median, p95;		// Seconds
+	double checksum;
+};
 
-	t = clock() - t;
-	printf("LuaJIT test with repeated argument and computation done in Lua loop: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+/*
+ * percentile: nearest rank percentile of a sorted list of times
+ */
+double percentile(const std::vector<double> &sorted, double p)
+{
+	size_t rank = (size_t) ceil(p * sorted.size());
+	return sorted[(rank > 0) ? rank - 1 : 0];
 }
-void LuaJITTest_incval_loop()
-{	
-	clock_t t = clock();
-
-	lua_State *L = luaL_newstate();
-	if (luaL_loadfile(L, LUA_FILENAME) || lua_pcall(L, 0, 0, 0)) {
-		lua_error(L);
-		return;
-	}
-	
-	lua_getglobal(L, "lua_square_loop_inc");
-	lua_pushnumber(L, NUM_ITERATIONS);
-	lua_pcall(L, 1, 0, 0);
 
-	t = clock() - t;
-	printf("LuaJIT test with incrementing arguments and computation done in Lua loop: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
-}
-void LejitTest_sameval()
+/*
+ * runBenchmark: sets up a benchmark, warms it up, times reps runs and tears
+ *		it down
+ */
+BenchmarkResult runBenchmark(const BenchmarkCase &bc, int warmup, int reps)
 {
-	clock_t t = clock();
+	std::unique_ptr<Benchmark> b(bc.create());
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(int,int*)> stdf = [](int x, int *y){ return x; };
-	lr->registerParam("lua_square", "i>i", stdf);
-	lr->readParam("lua_square", stdf);
-
-	int res = 0;
-	for (int i = 0; i < NUM_ITERATIONS; i++) {
-		stdf(100, &res);
+	double checksum = 0;
+	for (int r = 0; r < warmup; r++) {
+		b->reset();
+		checksum = b->run();
 	}
 
-	t = clock() - t;
-	printf("LEJIT test with same repeated argument: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	std::vector<double> times;
+	for (int r = 0; r < reps; r++) {
+		b->reset();
+		auto start = std::chrono::steady_clock::now();
+		checksum = b->run();
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+
+	BenchmarkResult res;
+	res.group = bc.group;
+	res.variant = bc.variant;
+	res.reps = reps;
+	res.calls = bc.calls;
+	res.min = times.front();
+	res.median = (reps % 2) ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+	res.p95 = percentile(times, 0.95);
+	res.checksum = checksum;
+	return res;
 }
-void LejitTest_incval()
+
+/*
+ * sameChecksum: whether two checksums agree to within rounding, since
+ *		variants may sum in a different order
+ */
+bool sameChecksum(double a, double b)
 {
-	clock_t t = clock();
+	return fabs(a - b) <= 1e-9 * std::max(fabs(a), fabs(b));
+}
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(int,int*)> stdf = [](int x, int *y){ return x; };
-	lr->registerParam("lua_square", "i>i", stdf);
-	lr->readParam("lua_square", stdf);
+/*
+ * writeJSON: writes results as a JSON array of objects, times in seconds
+ */
+bool writeJSON(const char *filename, const std::vector<BenchmarkResult> &results)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		printf("Unable to open file %s\n", filename);
+		return false;
+	}
 
-	int res = 0;
-	for (int i = 0; i < NUM_ITERATIONS; i++) {
-		stdf(i, &res);
+	fprintf(f, "[\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult &r = results[i];
+		fprintf(f, "  {\"group\": \"%s\", \"variant\": \"%s\", \"reps\": %d, \"calls\": %ld, "
+			"\"min_s\": %.9g, \"median_s\": %.9g, \"p95_s\": %.9g, \"ns_per_call\": %.6g, \"checksum\": %.17g}%s\n",
+			r.group.c_str(), r.variant.c_str(), r.reps, r.calls, r.min, r.median, r.p95,
+			r.median * 1e9 / r.calls, r.checksum, (i + 1 < results.size()) ? "," : "");
 	}
+	fprintf(f, "]\n");
 
-	t = clock() - t;
-	printf("LEJIT test with incrementing arguments: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	fclose(f);
+	return true;
 }
-void LejitTest_sameval_loop()
-{
-	clock_t t = clock();
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(int)> stdf = [](int x){};
-	lr->registerParam("lua_square_loop_same", stdf);
-	lr->readParam("lua_square_loop_same", stdf);
+/*
+ * writeCSV: writes results as CSV with a header row, times in seconds
+ */
+bool writeCSV(const char *filename, const std::vector<BenchmarkResult> &results)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		printf("Unable to open file %s\n", filename);
+		return false;
+	}
 
-	stdf(NUM_ITERATIONS);
+	fprintf(f, "group,variant,reps,calls,min_s,median_s,p95_s,ns_per_call,checksum\n");
+	for (const BenchmarkResult &r : results) {
+		fprintf(f, "%s,%s,%d,%ld,%.9g,%.9g,%.9g,%.6g,%.17g\n",
+			r.group.c_str(), r.variant.c_str(), r.reps, r.calls, r.min, r.median, r.p95,
+			r.median * 1e9 / r.calls, r.checksum);
+	}
 
-	t = clock() - t;
-	printf("LEJIT test with same repeated argument and computation done in Lua loop: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	fclose(f);
+	return true;
 }
-void LejitTest_incval_loop()
-{
-	clock_t t = clock();
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(int)> stdf = [](int x){};
-	lr->registerParam("lua_square_loop_inc", stdf);
-	lr->readParam("lua_square_loop_inc", stdf);
 
-	stdf(NUM_ITERATIONS);
+/* Matrix helpers */
 
-	t = clock() - t;
-	printf("LEJIT test with incrementing arguments and computation done in Lua loop: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+double ** newMatrix()
+{
+	double **A = (double **) malloc(sizeof(double*)*N);
+	for (int i = 0; i < N; i++) {
+		A[i] = (double *) malloc(sizeof(double)*N);
+	}
+	return A;
 }
 
-/*
- * LU decomposition benchmark in C++
- */
-double LU_C()
+void fillMatrix(double **A)
 {
-	clock_t t = clock();
-
-	int pivot[N];
 	srand(SEED);
-
-	/* Generate a random matrix */
-	double **A = (double **) malloc(sizeof(double*)*N);
 	for (int i = 0; i < N; i++) {
-		A[i] = (double *) malloc(sizeof(double)*N);
 		for (int j = 0; j < N; j++) {
 			A[i][j] = ((double) rand() / (RAND_MAX));
 		}
 	}
+}
 
-    for (int j = 0; j < N; j++)
-    {
-
-        int jp = j;
-        
-        double t = fabs(A[j][j]);
-        for (int i = j + 1; i < N; i++)
-        {
-            double ab = fabs(A[i][j]);
-            if (ab > t)
-            {
-                jp = i;
-                t = ab;
-            }
-        }
-        
-        pivot[j] = jp;
-
-        if ( A[jp][j] == 0 ) {
-        	printf("Zero pivot\n");               
-            return 0;
-        }
-
-
-        if (jp != j)
-        {
-            double *tA = A[j];
-            A[j] = A[jp];
-            A[jp] = tA;
-        }
-
-        if (j < N - 1) 
-        {
-
-            double recp =  1.0 / A[j][j];
-            for (int k = j + 1; k < N; k++)
-                A[k][j] *= recp;
-        }
-
-
-        if (j < N - 1)
-        {
-
-            for (int ii = j + 1; ii < N; ii++)
-            {
-                double *Aii = A[ii];
-                double *Aj = A[j];
-                double AiiJ = Aii[j];
-                int jj;
-                for (jj = j + 1; jj < N; jj++) 
-                {
-                    Aii[jj] -= AiiJ * Aj[jj];
-                }
+void freeMatrix(double **A)
+{
+	for (int i = 0; i < N; i++) {
+		free(A[i]);
+	}
+	free(A);
+}
 
-            }
-        }
-    }
+double sumDiagonal(double **A)
+{
+	double sum = 0;
+	for (int i = 0; i < N; i++) {
+		sum += A[i][i];
+	}
+	return sum;
+}
 
-    /* Return sum of diagonals */
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += A[i][i];
-    }
 
-	t = clock() - t;
-	printf("C LU test: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+/* Square tests - testing the speed of calling a function to square an int */
 
-	return sum;
+int CFunction(int val)
+{
+	return val * val;
+}
+int LuaJITFunction(lua_State *L, int val)
+{
+	lua_getglobal(L, "lua_square");
+	lua_pushnumber(L, val);
+	lua_pcall(L, 1, 1, 0);
+	int retval = lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	return retval;
 }
 
 /*
- * LU decomposition benchmark with no timing to be called by LuaJIT FFI
+ * Square benchmark in C++
  */
-extern "C" double LU()
-{
-	int pivot[N];
-	srand(SEED);
-
-	/* Generate a random matrix */
-	double **A = (double **) malloc(sizeof(double*)*N);
-	for (int i = 0; i < N; i++) {
-		A[i] = (double *) malloc(sizeof(double)*N);
-		for (int j = 0; j < N; j++) {
-			A[i][j] = ((double) rand() / (RAND_MAX));
+class Square_C : public Benchmark {
+public:
+	double run()
+	{
+		volatile int res = 0;
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			res = CFunction(i);
 		}
+		return res;
 	}
+};
 
-    for (int j = 0; j < N; j++)
-    {
-
-        int jp = j;
-        
-        double t = fabs(A[j][j]);
-        for (int i = j + 1; i < N; i++)
-        {
-            double ab = fabs(A[i][j]);
-            if (ab > t)
-            {
-                jp = i;
-                t = ab;
-            }
-        }
-        
-        pivot[j] = jp;
-
-        if ( A[jp][j] == 0 ) {
-        	printf("Zero pivot\n");               
-            return 0;
-        }
-
-
-        if (jp != j)
-        {
-            double *tA = A[j];
-            A[j] = A[jp];
-            A[jp] = tA;
-        }
-
-        if (j < N - 1)
-        {
-            double recp =  1.0 / A[j][j];
-            for (int k = j + 1; k < N; k++)
-                A[k][j] *= recp;
-        }
+/*
+ * Square benchmark calling Lua through the plain Lua C API
+ */
+class Square_LuaJIT : public Benchmark {
+protected:
+	lua_State *L;
 
+public:
+	Square_LuaJIT()
+	{
+		this->L = luaL_newstate();
+		luaL_openlibs(this->L);
+		if (luaL_loadfile(this->L, LUA_FILENAME) || lua_pcall(this->L, 0, 0, 0)) {
+			lua_error(this->L, "error in config file: %s\n", lua_tostring(this->L, -1));
+		}
+	}
+	~Square_LuaJIT() { lua_close(this->L); }
 
-        if (j < N - 1)
-        {
+	double run()
+	{
+		int res = 0;
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			res = LuaJITFunction(this->L, i);
+		}
+		return res;
+	}
+};
 
-            for (int ii = j + 1; ii < N; ii++)
-            {
-                double *Aii = A[ii];
-                double *Aj = A[j];
-                double AiiJ = Aii[j];
-                int jj;
-                for (jj = j + 1; jj < N; jj++) 
-                {
-                    Aii[jj] -= AiiJ * Aj[jj];
-                }
+/*
+ * Square benchmark with the loop done in Lua, through the plain Lua C API
+ */
+class Square_LuaJIT_loop : public Square_LuaJIT {
+public:
+	double run()
+	{
+		lua_getglobal(this->L, "lua_square_loop_inc");
+		lua_pushnumber(this->L, NUM_ITERATIONS);
+		lua_pcall(this->L, 1, 0, 0);
+		return 0;
+	}
+};
 
-            }
-        }
-    }
+/*
+ * Square benchmark calling Lua through a LEJIT function parameter
+ */
+class Square_Lejit : public LejitBenchmark {
+private:
+	std::function<void(int,int*)> lua_square;
 
-    /* Return sum of diagonals */
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += A[i][i];
-    }
+public:
+	Square_Lejit() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_square", "i>i", this->lua_square);
+		this->lr->readParam("lua_square", this->lua_square);
+	}
 
-	return sum;
-}
+	double run()
+	{
+		int res = 0;
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			this->lua_square(i, &res);
+		}
+		return res;
+	}
+};
 
 /*
- * LU decomposition benchmark performed in C called by LuaJIT FFI
+ * Square benchmark with the loop done in Lua, through a LEJIT function parameter
  */
-double LU_FFI()
-{
-	clock_t t = clock();
+class Square_Lejit_loop : public LejitBenchmark {
+private:
+	std::function<void(int)> lua_square_loop_inc;
 
-	LEJITReader *lr = new LEJITReader(FFI_FILENAME);
-	std::function<void(double*)> lua_lu_ffi;
-	lr->registerParam("lua_lu_ffi", ">d", lua_lu_ffi);
-	lr->readParam("lua_lu_ffi", lua_lu_ffi);
+public:
+	Square_Lejit_loop() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_square_loop_inc", this->lua_square_loop_inc);
+		this->lr->readParam("lua_square_loop_inc", this->lua_square_loop_inc);
+	}
 
-	double res = 0;
-	lua_lu_ffi(&res);
+	double run()
+	{
+		this->lua_square_loop_inc(NUM_ITERATIONS);
+		return 0;
+	}
+};
 
-	t = clock() - t;
-	printf("Lejit LU test with computation done in C++ via LuaJIT FFI: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
 
-	return res;
-}
+/* LU decomposition tests */
 
 /*
- * LU decomposition benchmark with inner computation done in Lua
+ * LU decomposition of A in place with partial pivoting. Calls multsub for
+ * every element update if it is given, otherwise does the update in C++
  */
-double LU_Lejit()
+bool LU_decompose(double **A, std::function<void(double,double,double,double*)> *multsub)
 {
-	clock_t t = clock();
-
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double,double,double,double*)> lua_multsub;
-	lr->registerParam("lua_multsub", "ddd>d", lua_multsub);
-	lr->readParam("lua_multsub", lua_multsub);
-
 	int pivot[N];
-	srand(SEED);
-
-	/* Generate a random matrix */
-	double **A = (double **) malloc(sizeof(double*)*N);
-	for (int i = 0; i < N; i++) {
-		A[i] = (double *) malloc(sizeof(double)*N);
-		for (int j = 0; j < N; j++) {
-			A[i][j] = ((double) rand() / (RAND_MAX));
-		}
-	}
 
     for (int j = 0; j < N; j++)
     {
 
         int jp = j;
-        
+
         double t = fabs(A[j][j]);
         for (int i = j + 1; i < N; i++)
         {
@@ -440,12 +406,12 @@ double LU_Lejit()
                 t = ab;
             }
         }
-        
+
         pivot[j] = jp;
 
         if ( A[jp][j] == 0 ) {
-        	printf("Zero pivot\n");                
-            return 0;
+        	printf("Zero pivot\n");
+            return false;
         }
 
 
@@ -458,6 +424,7 @@ double LU_Lejit()
 
         if (j < N - 1)
         {
+
             double recp =  1.0 / A[j][j];
             for (int k = j + 1; k < N; k++)
                 A[k][j] *= recp;
@@ -473,102 +440,211 @@ double LU_Lejit()
                 double *Aj = A[j];
                 double AiiJ = Aii[j];
                 int jj;
-                for (jj = j + 1; jj < N; jj++) 
-                {
-                	lua_multsub(Aii[jj], AiiJ, Aj[jj], &Aii[jj]);
+                if (multsub) {
+                	for (jj = j + 1; jj < N; jj++)
+                	{
+                		(*multsub)(Aii[jj], AiiJ, Aj[jj], &Aii[jj]);
+                	}
+                }
+                else {
+                	for (jj = j + 1; jj < N; jj++)
+                	{
+                    	Aii[jj] -= AiiJ * Aj[jj];
+                	}
                 }
 
             }
         }
     }
 
-    /* Return sum of diagonals */
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += A[i][i];
-    }
+    (void) pivot;
+    return true;
+}
 
-	t = clock() - t;
-	printf("Lejit LU test with inner computation done in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+/*
+ * LU decomposition benchmark with no timing to be called by LuaJIT FFI
+ */
+extern "C" double LU()
+{
+	double **A = newMatrix();
+	fillMatrix(A);
+	LU_decompose(A, nullptr);
 
+	double sum = sumDiagonal(A);
+	freeMatrix(A);
 	return sum;
 }
 
 /*
- * LU decomposition benchmark with computation done entirely in Lua
+ * LU decomposition benchmark in C++
  */
-double LU_Lejit_loop()
-{
-	clock_t t = clock();
-
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double*)> lua_lu;
-	lr->registerParam("lua_lu", ">d", lua_lu);
-	lr->readParam("lua_lu", lua_lu);
+class LU_C : public Benchmark {
+protected:
+	double **A;
 
-	double sum = 0;
-	lua_lu(&sum);
+public:
+	LU_C() : A(newMatrix()) {}
+	~LU_C() { freeMatrix(this->A); }
 
-	t = clock() - t;
-	printf("Lejit LU test with computation done entirely in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	void reset() { fillMatrix(this->A); }
 
-	return sum;
-}
+	double run()
+	{
+		LU_decompose(this->A, nullptr);
+		return sumDiagonal(this->A);
+	}
+};
 
 /*
- * LU decomposition benchmark with computation done entirely in Lua
- * Repeated REPS times
+ * LU decomposition benchmark performed in C called by LuaJIT FFI. Matrix is
+ * generated inside the timed region
  */
-double LU_Lejit_loop_reps()
-{
-	clock_t t = clock();
+class LU_FFI : public LejitBenchmark {
+private:
+	std::function<void(double*)> lua_lu_ffi;
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double*)> lua_lu;
-	lr->registerParam("lua_lu", "d>", lua_lu);
-	lr->readParam("lua_lu", lua_lu);
+public:
+	LU_FFI() : LejitBenchmark(FFI_FILENAME)
+	{
+		this->lr->registerParam("lua_lu_ffi", ">d", this->lua_lu_ffi);
+		this->lr->readParam("lua_lu_ffi", this->lua_lu_ffi);
+	}
 
-	double sum = 0;
+	double run()
+	{
+		double res = 0;
+		this->lua_lu_ffi(&res);
+		return res;
+	}
+};
+
+/*
+ * LU decomposition benchmark with inner computation done in Lua, or in C
+ * translated from it if native
+ */
+class LU_Lejit : public LejitBenchmark {
+private:
+	double **A;
+	std::function<void(double,double,double,double*)> lua_multsub;
 
-	for (int r = 0; r < REPS; r++) {
-		lua_lu(&sum);
+public:
+	LU_Lejit(bool native = false) : LejitBenchmark(LUA_FILENAME), A(newMatrix())
+	{
+		this->lr->registerParam("lua_multsub", "ddd>d", this->lua_multsub);
+		this->lr->setNative("lua_multsub", native);
+		this->lr->readParam("lua_multsub", this->lua_multsub);
 	}
+	~LU_Lejit() { freeMatrix(this->A); }
 
-	t = clock() - t;
-	printf("Lejit LU test with computation done entirely in Lua, repeated %d times: %f secs\n", REPS, ((float)t)/CLOCKS_PER_SEC);
+	void reset() { fillMatrix(this->A); }
 
-	return sum;
-}
+	double run()
+	{
+		LU_decompose(this->A, &this->lua_multsub);
+		return sumDiagonal(this->A);
+	}
+};
 
-/* 
- * MonteCarlo benchmark in C++
+/*
+ * LU decomposition benchmark with inner computation done in Lua, one batched
+ * call per row
  */
-double MonteCarlo_C()
-{
-	clock_t t = clock();
+class LU_Lejit_batch : public LejitBenchmark {
+private:
+	double **A;
+	std::function<void(double,double,double,double*)> lua_multsub;
+	std::function<void(int,double*,double*,double*,double*)> lua_multsub_batch;
 
-    srand(SEED);
+public:
+	LU_Lejit_batch() : LejitBenchmark(LUA_FILENAME), A(newMatrix())
+	{
+		this->lr->registerParam("lua_multsub", "ddd>d", this->lua_multsub);
+		this->lr->readBatchParam("lua_multsub", this->lua_multsub_batch);
+	}
+	~LU_Lejit_batch() { freeMatrix(this->A); }
 
-    int under_curve = 0;
-    int count;
-    double x, y, res;
+	void reset() { fillMatrix(this->A); }
 
-    for (count=0; count < MC_ITERATIONS; count++)
-    {
-        x = ((double) rand() / (RAND_MAX));
-        y = ((double) rand() / (RAND_MAX));
+	double run()
+	{
+		double AiiJs[N];
+
+	    for (int j = 0; j < N; j++)
+	    {
+	        int jp = j;
+
+	        double t = fabs(this->A[j][j]);
+	        for (int i = j + 1; i < N; i++)
+	        {
+	            double ab = fabs(this->A[i][j]);
+	            if (ab > t)
+	            {
+	                jp = i;
+	                t = ab;
+	            }
+	        }
+
+	        if ( this->A[jp][j] == 0 ) {
+	        	printf("Zero pivot\n");
+	            return 0;
+	        }
+
+	        if (jp != j)
+	        {
+	            double *tA = this->A[j];
+	            this->A[j] = this->A[jp];
+	            this->A[jp] = tA;
+	        }
+
+	        if (j < N - 1)
+	        {
+	            double recp =  1.0 / this->A[j][j];
+	            for (int k = j + 1; k < N; k++)
+	                this->A[k][j] *= recp;
+
+	            for (int ii = j + 1; ii < N; ii++)
+	            {
+	                double *Aii = this->A[ii];
+	                double *Aj = this->A[j];
+	                double AiiJ = Aii[j];
+	                for (int jj = j + 1; jj < N; jj++)
+	                {
+	                	AiiJs[jj] = AiiJ;
+	                }
+	                this->lua_multsub_batch(N - j - 1, &Aii[j + 1], &AiiJs[j + 1], &Aj[j + 1], &Aii[j + 1]);
+	            }
+	        }
+	    }
+
+		return sumDiagonal(this->A);
+	}
+};
 
-        if ( x*x + y*y <= 1.0)
-             under_curve ++;       
-    }
+/*
+ * LU decomposition benchmark with computation done entirely in Lua. Matrix is
+ * generated inside the timed region
+ */
+class LU_Lejit_loop : public LejitBenchmark {
+private:
+	std::function<void(double*)> lua_lu;
+
+public:
+	LU_Lejit_loop() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_lu", ">d", this->lua_lu);
+		this->lr->readParam("lua_lu", this->lua_lu);
+	}
 
-    res = ((double) under_curve / MC_ITERATIONS) * 4.0;
+	double run()
+	{
+		double sum = 0;
+		this->lua_lu(&sum);
+		return sum;
+	}
+};
 
-    t = clock() - t;
-	printf("C montecarlo test: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
 
-    return res;
-}
+/* Monte Carlo tests */
 
 /*
  * MonteCarlo benchmark with no timing to be called from LuaJIT FFI
@@ -587,7 +663,7 @@ extern "C" double MonteCarlo()
 	    y = ((double) rand() / (RAND_MAX));
 
 	    if ( x*x + y*y <= 1.0)
-	         under_curve ++;       
+	         under_curve ++;
 	}
 
 	res = ((double) under_curve / MC_ITERATIONS) * 4.0;
@@ -596,156 +672,129 @@ extern "C" double MonteCarlo()
 }
 
 /*
- * MonteCarlo benchmark performed in C called by LuaJIT FFI
+ * MonteCarlo benchmark in C++
  */
-double MonteCarlo_FFI()
-{
-	clock_t t = clock();
+class MonteCarlo_C : public Benchmark {
+public:
+	double run() { return MonteCarlo(); }
+};
 
-	LEJITReader *lr = new LEJITReader(FFI_FILENAME);
+/*
+ * MonteCarlo benchmark performed in C called by LuaJIT FFI
+ */
+class MonteCarlo_FFI : public LejitBenchmark {
+private:
 	std::function<void(double*)> lua_montecarlo_ffi;
-	lr->registerParam("lua_montecarlo_ffi", ">d", lua_montecarlo_ffi);
-	lr->readParam("lua_montecarlo_ffi", lua_montecarlo_ffi);
 
-	double res = 0;
-	lua_montecarlo_ffi(&res);
-
-	t = clock() - t;
-	printf("Lejit montecarlo test with computation done in C++ via LuaJIT FFI: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+public:
+	MonteCarlo_FFI() : LejitBenchmark(FFI_FILENAME)
+	{
+		this->lr->registerParam("lua_montecarlo_ffi", ">d", this->lua_montecarlo_ffi);
+		this->lr->readParam("lua_montecarlo_ffi", this->lua_montecarlo_ffi);
+	}
 
-	return res;
-}
+	double run()
+	{
+		double res = 0;
+		this->lua_montecarlo_ffi(&res);
+		return res;
+	}
+};
 
-/* 
- * MonteCarlo benchmark with inner computation done in Lua
+/*
+ * MonteCarlo benchmark with random numbers generated in Lua
  */
-double MonteCarlo_Lejit()
-{
-	clock_t t = clock();
-
-    LEJITReader *lr = new LEJITReader(LUA_FILENAME);
+class MonteCarlo_Lejit : public LejitBenchmark {
+private:
 	std::function<void(int)> lua_srand;
 	std::function<void(double*)> lua_rand;
-	lr->registerParam("lua_srand", lua_srand);
-	lr->registerParam("lua_rand", ">d", lua_rand);
-	lr->readParam("lua_srand", lua_srand);
-	lr->readParam("lua_rand", lua_rand);
-
-    lua_srand(SEED);
-
-    int under_curve = 0;
-    int count;
-    double x, y, res;
-
-    for (count=0; count < MC_ITERATIONS; count++)
-    {
-        lua_rand(&x);
-        lua_rand(&y);
-
-        if ( x*x + y*y <= 1.0)
-             under_curve ++;    
-    }
-
-    res = ((double) under_curve / MC_ITERATIONS) * 4.0;
-
-    t = clock() - t;
-	printf("LEJIT montecarlo test with inner computation done in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
 
-    return res;
-}
+public:
+	MonteCarlo_Lejit() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_srand", this->lua_srand);
+		this->lr->registerParam("lua_rand", ">d", this->lua_rand);
+		this->lr->readParam("lua_srand", this->lua_srand);
+		this->lr->readParam("lua_rand", this->lua_rand);
+	}
 
-/* 
- * MonteCarlo benchmark with computation done entirely in Lua
- */
-double MonteCarlo_Lejit_loop()
-{
-	clock_t t = clock();
+	double run()
+	{
+	    this->lua_srand(SEED);
 
-    LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double*)> lua_montecarlo;
-	lr->registerParam("lua_montecarlo", ">d", lua_montecarlo);
-	lr->readParam("lua_montecarlo", lua_montecarlo);
+	    int under_curve = 0;
+	    double x, y;
 
-	double res = 0;
-	lua_montecarlo(&res);
+	    for (int count = 0; count < MC_ITERATIONS; count++)
+	    {
+	        this->lua_rand(&x);
+	        this->lua_rand(&y);
 
-    t = clock() - t;
-	printf("LEJIT montecarlo test with computation done entirely in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	        if ( x*x + y*y <= 1.0)
+	             under_curve ++;
+	    }
 
-    return res;
-}
+	    return ((double) under_curve / MC_ITERATIONS) * 4.0;
+	}
+};
 
-/* 
+/*
  * MonteCarlo benchmark with computation done entirely in Lua
- * Repeated REPS times
  */
-double MonteCarlo_Lejit_loop_reps()
-{
-	clock_t t = clock();
-
-    LEJITReader *lr = new LEJITReader(LUA_FILENAME);
+class MonteCarlo_Lejit_loop : public LejitBenchmark {
+private:
 	std::function<void(double*)> lua_montecarlo;
-	lr->registerParam("lua_montecarlo", ">d", lua_montecarlo);
-	lr->readParam("lua_montecarlo", lua_montecarlo);
-
-	double res = 0;
 
-	for (int r = 0; r < REPS; r++) {
-		lua_montecarlo(&res);
+public:
+	MonteCarlo_Lejit_loop() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_montecarlo", ">d", this->lua_montecarlo);
+		this->lr->readParam("lua_montecarlo", this->lua_montecarlo);
 	}
 
-    t = clock() - t;
-	printf("LEJIT montecarlo test with computation done entirely in Lua, repeated %d times: %f secs\n", REPS, ((float)t)/CLOCKS_PER_SEC);
-
-    return res;
-}
+	double run()
+	{
+		double res = 0;
+		this->lua_montecarlo(&res);
+		return res;
+	}
+};
 
-/* 
- * MonteCarlo benchmark with computation done entirely in Lua
- * Includes insitu vis done in Lua
+/*
+ * MonteCarlo benchmark with samples taken in Lua, spread across threads
+ * with parallelReduce
  */
-double MonteCarlo_Lejit_loop_insitu()
-{
-	clock_t t = clock();
+class MonteCarlo_Lejit_parallel : public LejitBenchmark {
+private:
+	std::function<void(int,int*)> lua_mcsample;
 
-    LEJITReader *lr = new LEJITReader(INSITU_FILENAME);
-	std::function<void(double*)> lua_montecarlo_insitu;
-	lr->registerParam("lua_montecarlo_insitu", ">d", lua_montecarlo_insitu);
-	lr->readParam("lua_montecarlo_insitu", lua_montecarlo_insitu);
+public:
+	MonteCarlo_Lejit_parallel() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_mcsample", "i>i", this->lua_mcsample);
+	}
 
-	double res = 0;
-	lua_montecarlo_insitu(&res);
+	double run()
+	{
+		int under_curve = this->lr->parallelReduce("lua_mcsample", MC_ITERATIONS, 0, [](int a, int b) { return a + b; });
+		return ((double) under_curve / MC_ITERATIONS) * 4.0;
+	}
+};
 
-    t = clock() - t;
-	printf("LEJIT montecarlo test with computation done entirely in Lua and insitu: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
 
-    return res;
-}
+/* SOR tests */
 
 /*
- * SOR benchmark in C++
+ * SOR sweeps over G in C++
  */
-double SOR_C()
+void SOR_sweep(double **G)
 {
-	clock_t t = clock();
-
-	srand(SEED);
-
-	/* Generate a random matrix */
-	double **G = (double **) malloc(sizeof(double*)*N);
-	for (int i = 0; i < N; i++) {
-		G[i] = (double *) malloc(sizeof(double)*N);
-		for (int j = 0; j < N; j++) {
-			G[i][j] = ((double) rand() / (RAND_MAX));
-		}
-	}
-
     double omega_over_four = OMEGA * 0.25;
     double one_minus_omega = 1.0 - OMEGA;
 
     /* Update interior points */
 
-    int Nm1 = N - 1; 
+    int Nm1 = N - 1;
     double *Gi, *Gim1, *Gip1;
 
     for (int p = 0; p < SOR_ITERATIONS; p++)
@@ -756,22 +805,11 @@ double SOR_C()
             Gim1 = G[i-1];
             Gip1 = G[i+1];
             for (int j = 1; j < Nm1; j++) {
-                Gi[j] = omega_over_four * (Gim1[j] + Gip1[j] + Gi[j-1] 
+                Gi[j] = omega_over_four * (Gim1[j] + Gip1[j] + Gi[j-1]
                             + Gi[j+1]) + one_minus_omega * Gi[j];
             }
         }
     }
-
-    // Return sum of diagonals
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += G[i][i];
-    }
-
-    t = clock() - t;
-	printf("C SOR test: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
-
-	return sum;
 }
 
 /*
@@ -779,268 +817,405 @@ double SOR_C()
  */
 extern "C" double SOR()
 {
-	srand(SEED);
+	double **G = newMatrix();
+	fillMatrix(G);
+	SOR_sweep(G);
 
-	/* Generate a random matrix */
-	double **G = (double **) malloc(sizeof(double*)*N);
-	for (int i = 0; i < N; i++) {
-		G[i] = (double *) malloc(sizeof(double)*N);
-		for (int j = 0; j < N; j++) {
-			G[i][j] = ((double) rand() / (RAND_MAX));
-		}
-	}
+	double sum = sumDiagonal(G);
+	freeMatrix(G);
+	return sum;
+}
 
-    double omega_over_four = OMEGA * 0.25;
-    double one_minus_omega = 1.0 - OMEGA;
+/*
+ * SOR benchmark in C++
+ */
+class SOR_C : public Benchmark {
+protected:
+	double **G;
 
-    /* Update interior points */
+public:
+	SOR_C() : G(newMatrix()) {}
+	~SOR_C() { freeMatrix(this->G); }
 
-    int Nm1 = N - 1; 
-    double *Gi, *Gim1, *Gip1;
+	void reset() { fillMatrix(this->G); }
 
-    for (int p = 0; p < SOR_ITERATIONS; p++)
-    {
-        for (int i = 1; i < Nm1; i++)
-        {
-            Gi = G[i];
-            Gim1 = G[i-1];
-            Gip1 = G[i+1];
-            for (int j = 1; j < Nm1; j++) {
-                Gi[j] = omega_over_four * (Gim1[j] + Gip1[j] + Gi[j-1] 
-                            + Gi[j+1]) + one_minus_omega * Gi[j];
-            }
-        }
-    }
+	double run()
+	{
+		SOR_sweep(this->G);
+		return sumDiagonal(this->G);
+	}
+};
 
-    // Return sum of diagonals
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += G[i][i];
-    }
+/*
+ * SOR benchmark performed in C called by LuaJIT FFI. Matrix is generated
+ * inside the timed region
+ */
+class SOR_FFI : public LejitBenchmark {
+private:
+	std::function<void(double*)> lua_sor_ffi;
 
-	return sum;
-}
+public:
+	SOR_FFI() : LejitBenchmark(FFI_FILENAME)
+	{
+		this->lr->registerParam("lua_sor_ffi", ">d", this->lua_sor_ffi);
+		this->lr->readParam("lua_sor_ffi", this->lua_sor_ffi);
+	}
+
+	double run()
+	{
+		double res = 0;
+		this->lua_sor_ffi(&res);
+		return res;
+	}
+};
 
 /*
- * SOR benchmark performed in C called by LuaJIT FFI
+ * SOR benchmark with inner computation done in Lua, or in C translated from
+ * it if native
  */
-double SOR_FFI()
-{
-	clock_t t = clock();
-
-	LEJITReader *lr = new LEJITReader(FFI_FILENAME);
-	std::function<void(double*)> lua_sor_ffi;
-	lr->registerParam("lua_sor_ffi", ">d", lua_sor_ffi);
-	lr->readParam("lua_sor_ffi", lua_sor_ffi);
+class SOR_Lejit : public LejitBenchmark {
+private:
+	double **G;
+	std::function<void(int,double,double,double*,double*,double*)> lua_sorinner;
 
-	double res = 0;
-	lua_sor_ffi(&res);
+public:
+	SOR_Lejit(bool native = false) : LejitBenchmark(LUA_FILENAME), G(newMatrix())
+	{
+		this->lr->registerParam("lua_sorinner", "iddad1ad1ad1", this->lua_sorinner);
+		this->lr->setNative("lua_sorinner", native);
+		this->lr->readParam("lua_sorinner", this->lua_sorinner);
+	}
+	~SOR_Lejit() { freeMatrix(this->G); }
 
-	t = clock() - t;
-	printf("Lejit SOR test with computation done in C++ via LuaJIT FFI: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	void reset() { fillMatrix(this->G); }
 
-	return res;
-}
+	double run()
+	{
+	    double omega_over_four = OMEGA * 0.25;
+	    double one_minus_omega = 1.0 - OMEGA;
+	    int Nm1 = N - 1;
+
+	    for (int p = 0; p < SOR_ITERATIONS; p++)
+	    {
+	        for (int i = 1; i < Nm1; i++)
+	        {
+	            for (int j = 1; j < Nm1; j++) {
+	            	// Array userdata is indexed from 1 in Lua
+	            	this->lua_sorinner(j + 1, omega_over_four, one_minus_omega, this->G[i], this->G[i-1], this->G[i+1]);
+	            }
+	        }
+	    }
+
+		return sumDiagonal(this->G);
+	}
+};
 
 /*
- * SOR benchmark with inner computation done in Lua
+ * SOR benchmark with 1 inner loop done in Lua. Rows are passed as array
+ * userdata, or as FFI cdata if signature uses c
  */
-double SOR_Lejit()
-{
-	clock_t t = clock();
+class SOR_Lejit_loop_1 : public LejitBenchmark {
+private:
+	double **G;
+	std::function<void(double,double,double*,double*,double*)> lua_sor1loop;
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(int,double,double,double*,double*,double*)> lua_sorinner;
-	lr->registerParam("lua_sorinner", "iddad1ad1ad1", lua_sorinner);
-	lr->readParam("lua_sorinner", lua_sorinner);
+public:
+	SOR_Lejit_loop_1(std::string id = "lua_sor1loop", std::string signature = "ddad1ad1ad1") : LejitBenchmark(LUA_FILENAME), G(newMatrix())
+	{
+		this->lr->registerParam(id, signature, this->lua_sor1loop);
+		this->lr->readParam(id, this->lua_sor1loop);
+	}
+	~SOR_Lejit_loop_1() { freeMatrix(this->G); }
 
-	srand(SEED);
+	void reset() { fillMatrix(this->G); }
 
-	/* Generate a random matrix */
-	double **G = (double **) malloc(sizeof(double*)*N);
-	for (int i = 0; i < N; i++) {
-		G[i] = (double *) malloc(sizeof(double)*N);
-		for (int j = 0; j < N; j++) {
-			G[i][j] = ((double) rand() / (RAND_MAX));
-		}
+	double run()
+	{
+	    double omega_over_four = OMEGA * 0.25;
+	    double one_minus_omega = 1.0 - OMEGA;
+	    int Nm1 = N - 1;
+
+	    for (int p = 0; p < SOR_ITERATIONS; p++)
+	    {
+	    	for (int i = 1; i < Nm1; i++)
+	        {
+	    		this->lua_sor1loop(omega_over_four, one_minus_omega, this->G[i], this->G[i-1], this->G[i+1]);
+	    	}
+	    }
+
+		return sumDiagonal(this->G);
 	}
+};
 
-    double omega_over_four = OMEGA * 0.25;
-    double one_minus_omega = 1.0 - OMEGA;
+/*
+ * SOR benchmark with entire computation (3 nested loops) done in Lua. Matrix
+ * is generated inside the timed region
+ */
+class SOR_Lejit_loop_3 : public LejitBenchmark {
+private:
+	std::function<void(double*)> lua_sor;
 
-    /* Update interior points */
+public:
+	SOR_Lejit_loop_3() : LejitBenchmark(LUA_FILENAME)
+	{
+		this->lr->registerParam("lua_sor", ">d", this->lua_sor);
+		this->lr->readParam("lua_sor", this->lua_sor);
+	}
 
-    int Nm1 = N - 1; 
-    double *Gi, *Gim1, *Gip1;
+	double run()
+	{
+		double sum = 0;
+		this->lua_sor(&sum);
+		return sum;
+	}
+};
 
-    for (int p = 0; p < SOR_ITERATIONS; p++)
-    {
-        for (int i = 1; i < Nm1; i++)
-        {
-            Gi = G[i];
-            Gim1 = G[i-1];
-            Gip1 = G[i+1];
-            for (int j = 1; j < Nm1; j++) {
-            	lua_sorinner(j, omega_over_four, one_minus_omega, Gi, Gim1, Gip1);
-            }
-        }
-    }
 
-    // Return sum of diagonals
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += G[i][i];
-    }
+/* Table conversion tests */
 
-    t = clock() - t;
-	printf("Lejit SOR test with inner computation done in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+/*
+ * Table benchmark base: creates a Lua table of TABLE_ELEMENTS numbers, as rows
+ * of cols numbers if cols > 0, in a plain Lua state
+ */
+class Table : public Benchmark {
+protected:
+	lua_State *L;
 
-	return sum;
-}
+public:
+	Table(int cols)
+	{
+		this->L = luaL_newstate();
+		luaL_openlibs(this->L);
+		if (luaL_loadfile(this->L, LUA_FILENAME) || lua_pcall(this->L, 0, 0, 0)) {
+			lua_error(this->L, "error in config file: %s\n", lua_tostring(this->L, -1));
+		}
+
+		lua_getglobal(this->L, "lua_maketable");
+		lua_pushinteger(this->L, (cols > 0) ? TABLE_ELEMENTS / cols : TABLE_ELEMENTS);
+		lua_pushinteger(this->L, cols);
+		lua_pcall(this->L, 2, 0, 0);
+	}
+	~Table() { lua_close(this->L); }
+};
 
 /*
- * SOR benchmark with 1 inner loop done in Lua
+ * gettable_vector: reference conversion of the table on the top of the stack
+ *		with one lua_gettable call per element, as LEJIT did before raw access
  */
-double SOR_Lejit_loop_1()
+void gettable_vector(lua_State *L, std::vector<double> &ptr)
 {
-	clock_t t = clock();
+	size_t size = lua_objlen(L, -1);
+	ptr.resize(size);
+	for (size_t i = 0; i < size; i++) {
+		lua_pushinteger(L, i + 1);
+		lua_gettable(L, -2);
+		double val = luaL_checknumber(L, -1);
+		lua_pop(L, 1);
+		ptr[i] = val;
+	}
+	lua_pop(L, 1);
+}
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double,double,double*,double*,double*)> lua_sor1loop;
-	lr->registerParam("lua_sor1loop", "ddad1ad1ad1", lua_sor1loop);
-	lr->readParam("lua_sor1loop", lua_sor1loop);
+/*
+ * 1D table benchmark converting element by element with lua_gettable
+ */
+class Table_gettable : public Table {
+private:
+	std::vector<double> v;
 
-	srand(SEED);
+public:
+	Table_gettable() : Table(0) {}
 
-	/* Generate a random matrix */
-	double **G = (double **) malloc(sizeof(double*)*N);
-	for (int i = 0; i < N; i++) {
-		G[i] = (double *) malloc(sizeof(double)*N);
-		for (int j = 0; j < N; j++) {
-			G[i][j] = ((double) rand() / (RAND_MAX));
-		}
+	double run()
+	{
+		lua_getglobal(this->L, "big_table");
+		gettable_vector(this->L, this->v);
+		return this->v.back();
 	}
+};
 
-    double omega_over_four = OMEGA * 0.25;
-    double one_minus_omega = 1.0 - OMEGA;
+/*
+ * 1D table benchmark converting with LEJIT's raw access path
+ */
+class Table_Lejit : public Table {
+private:
+	std::vector<double> v;
 
-    /* Update interior points */
+public:
+	Table_Lejit() : Table(0) {}
 
-    int Nm1 = N - 1; 
-    double *Gi, *Gim1, *Gip1;
+	double run()
+	{
+		lua_getglobal(this->L, "big_table");
+		lua_gettopvalue(this->L, this->v);
+		return this->v.back();
+	}
+};
 
-    for (int p = 0; p < SOR_ITERATIONS; p++)
-    {
-    	for (int i = 1; i < Nm1; i++)
-        {
-            Gi = G[i];
-            Gim1 = G[i-1];
-            Gip1 = G[i+1];
+/*
+ * 2D table benchmark converting row by row with lua_gettable
+ */
+class Table2D_gettable : public Table {
+private:
+	std::vector<std::vector<double>> v;
 
-    		lua_sor1loop(omega_over_four, one_minus_omega, Gi, Gim1, Gip1);
-    	}
-    }
+public:
+	Table2D_gettable() : Table(TABLE_COLS) {}
 
-    // Return sum of diagonals
-    double sum = 0;
-    for (int i = 0; i < N; i++) {
-    	sum += G[i][i];
-    }
+	double run()
+	{
+		lua_getglobal(this->L, "big_table");
+		size_t rows = lua_objlen(this->L, -1);
+		this->v.resize(rows);
+		for (size_t i = 0; i < rows; i++) {
+			lua_pushinteger(this->L, i + 1);
+			lua_gettable(this->L, -2);
+			gettable_vector(this->L, this->v[i]);
+		}
+		lua_pop(this->L, 1);
+		return this->v.back().back();
+	}
+};
+
+/*
+ * 2D table benchmark converting into a contiguous array with LEJIT's raw
+ * access path
+ */
+class Table2D_Lejit : public Table {
+private:
+	std::vector<double> v;
 
-	t = clock() - t;
-	printf("Lejit SOR test with 1/3 loops in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+public:
+	Table2D_Lejit() : Table(TABLE_COLS), v(TABLE_ELEMENTS) {}
 
-	return sum;
-}
+	double run()
+	{
+		size_t dims[] = { TABLE_ELEMENTS / TABLE_COLS, TABLE_COLS };
+		lua_getglobal(this->L, "big_table");
+		lua_rawtoarray(this->L, -1, this->v.data(), dims, 2);
+		lua_pop(this->L, 1);
+		return this->v.back();
+	}
+};
 
 
+/* Startup tests */
+
 /*
- * SOR benchmark with entire computation (3 nested loops) done in Lua
+ * Startup benchmark creating a reader and evaluating the config file, with
+ * the bytecode cache in cache_dir or parsing the source every time
  */
-double SOR_Lejit_loop_3()
-{
-	clock_t t = clock();
+class Startup_Lejit : public Benchmark {
+private:
+	std::string cache_dir;
 
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double*)> lua_sor;
-	lr->registerParam("lua_sor", ">d", lua_sor);
-	lr->readParam("lua_sor", lua_sor);
-
-	double sum = 0;
-	lua_sor(&sum);
+public:
+	Startup_Lejit(std::string cache_dir) : cache_dir(cache_dir) {}
 
-	t = clock() - t;
-	printf("Lejit SOR test with 3/3 loops in Lua: %f secs\n", ((float)t)/CLOCKS_PER_SEC);
+	double run()
+	{
+		LEJITReader *lr = new LEJITReader(LUA_FILENAME);
+		lr->setBytecodeCache(this->cache_dir);
+		lr->reload();
+		double hits = lr->getCacheHits();
+		delete lr;
+		return hits;
+	}
+};
 
-	return sum;
-}
 
 /*
- * SOR benchmark with entire computation (3 nested loops) done in Lua
- * Repeated REPS times
+ * main: runs all benchmarks matching the filter and reports their statistics
  */
-double SOR_Lejit_loop_3_reps()
+int main(int argc, char *argv[])
 {
-	clock_t t = clock();
-	LEJITReader *lr = new LEJITReader(LUA_FILENAME);
-	std::function<void(double*)> lua_sor;
-	lr->registerParam("lua_sor", ">d", lua_sor);
-	lr->readParam("lua_sor", lua_sor);
+	int warmup = WARMUP, reps = REPS;
+	const char *filter = nullptr, *json = nullptr, *csv = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--warmup") && i + 1 < argc) warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--reps") && i + 1 < argc) reps = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+		else if (!strcmp(argv[i], "--json") && i + 1 < argc) json = argv[++i];
+		else if (!strcmp(argv[i], "--csv") && i + 1 < argc) csv = argv[++i];
+		else {
+			printf("Usage: %s [--warmup W] [--reps R] [--filter GROUP] [--json FILE] [--csv FILE]\n", argv[0]);
+			return 1;
+		}
+	}
 
-	double sum = 0;
+	std::vector<BenchmarkCase> cases = {
+		{ "square", "C", NUM_ITERATIONS, [] { return new Square_C(); } },
+		{ "square", "LuaJIT", NUM_ITERATIONS, [] { return new Square_LuaJIT(); } },
+		{ "square", "LuaJIT loop", NUM_ITERATIONS, [] { return new Square_LuaJIT_loop(); }, true },
+		{ "square", "LEJIT", NUM_ITERATIONS, [] { return new Square_Lejit(); } },
+		{ "square", "LEJIT loop", NUM_ITERATIONS, [] { return new Square_Lejit_loop(); }, true },
+
+		{ "LU", "C", LU_CALLS, [] { return new LU_C(); } },
+		{ "LU", "FFI", LU_CALLS, [] { return new LU_FFI(); } },
+		{ "LU", "LEJIT", LU_CALLS, [] { return new LU_Lejit(); } },
+		{ "LU", "LEJIT batch", LU_CALLS, [] { return new LU_Lejit_batch(); } },
+		{ "LU", "LEJIT loop", LU_CALLS, [] { return new LU_Lejit_loop(); }, true },
+		{ "LU", "LEJIT native", LU_CALLS, [] { return new LU_Lejit(true); } },
+
+		{ "MonteCarlo", "C", MC_ITERATIONS, [] { return new MonteCarlo_C(); } },
+		{ "MonteCarlo", "FFI", MC_ITERATIONS, [] { return new MonteCarlo_FFI(); } },
+		{ "MonteCarlo", "LEJIT", MC_ITERATIONS, [] { return new MonteCarlo_Lejit(); }, true },
+		{ "MonteCarlo", "LEJIT loop", MC_ITERATIONS, [] { return new MonteCarlo_Lejit_loop(); }, true },
+		{ "MonteCarlo", "LEJIT parallel", MC_ITERATIONS, [] { return new MonteCarlo_Lejit_parallel(); }, true },
+
+		{ "SOR", "C", SOR_CALLS, [] { return new SOR_C(); } },
+		{ "SOR", "FFI", SOR_CALLS, [] { return new SOR_FFI(); } },
+		{ "SOR", "LEJIT", SOR_CALLS, [] { return new SOR_Lejit(); } },
+		{ "SOR", "LEJIT loop 1", SOR_CALLS, [] { return new SOR_Lejit_loop_1(); } },
+		{ "SOR", "LEJIT loop 1 cdata", SOR_CALLS, [] { return new SOR_Lejit_loop_1("lua_sor1loop_cdata", "ddcdcdcd"); } },
+		{ "SOR", "LEJIT loop 3", SOR_CALLS, [] { return new SOR_Lejit_loop_3(); }, true },
+		{ "SOR", "LEJIT native", SOR_CALLS, [] { return new SOR_Lejit(true); } },
+
+		{ "table", "gettable", TABLE_ELEMENTS, [] { return new Table_gettable(); } },
+		{ "table", "LEJIT", TABLE_ELEMENTS, [] { return new Table_Lejit(); } },
+		{ "table 2D", "gettable", TABLE_ELEMENTS, [] { return new Table2D_gettable(); } },
+		{ "table 2D", "LEJIT contiguous", TABLE_ELEMENTS, [] { return new Table2D_Lejit(); } },
+
+		{ "startup", "LEJIT source", 1, [] { return new Startup_Lejit(""); }, true },
+		{ "startup", "LEJIT cached", 1, [] { return new Startup_Lejit(DEFAULT_CACHE_DIR); }, true },
+	};
+
+	printf("%d warmup runs, %d timed runs\n\n", warmup, reps);
+	printf("%-12s %-20s %12s %12s %12s %12s\n", "group", "variant", "min ms", "median ms", "p95 ms", "ns/call");
+
+	std::vector<BenchmarkResult> results;
+	std::map<std::string, BenchmarkResult> references;	// First checked variant of each group
+	int mismatches = 0;
+	for (const BenchmarkCase &bc : cases) {
+		if (filter && bc.group != filter) {
+			continue;
+		}
 
-	for (int r = 0; r < REPS; r++) {
-		lua_sor(&sum);
+		BenchmarkResult r = runBenchmark(bc, warmup, reps);
+		printf("%-12s %-20s %12.3f %12.3f %12.3f %12.2f\n", r.group.c_str(), r.variant.c_str(),
+			r.min * 1e3, r.median * 1e3, r.p95 * 1e3, r.median * 1e9 / r.calls);
+
+		if (!bc.unchecked) {
+			auto ref = references.find(r.group);
+			if (ref == references.end()) {
+				references[r.group] = r;
+			} else if (!sameChecksum(r.checksum, ref->second.checksum)) {
+				printf("checksum mismatch: %s %s gave %.17g, %s gave %.17g\n", r.group.c_str(),
+					r.variant.c_str(), r.checksum, ref->second.variant.c_str(), ref->second.checksum);
+				mismatches++;
+			}
+		}
+		fflush(stdout);
+		results.push_back(r);
 	}
 
-	t = clock() - t;
-	printf("Lejit SOR test with 3/3 loops in Lua, repeated %d times: %f secs\n", REPS, ((float)t)/CLOCKS_PER_SEC);
+	if (json && !writeJSON(json, results)) {
+		return 1;
+	}
+	if (csv && !writeCSV(csv, results)) {
+		return 1;
+	}
 
-	return sum;
+	return mismatches ? 1 : 0;
 }
-
-/*
- * main: calls all the test functions
- */
-int main() 
-{
-	/* Square tests */
-	//CTest_sameval();
-	//CTest_incval();
-	//LuaJITTest_sameval();
-	//LuaJITTest_incval();
-	//LuaJITTest_sameval_loop();
-	//LuaJITTest_incval_loop();
-	//LejitTest_sameval();
-	//LejitTest_incval();
-	//LejitTest_sameval_loop();
-	//LejitTest_incval_loop();
-
-	printf("----- LU DECOMPOSITION (%d x %d) -----\n", N, N);
-	LU_C();
-	LU_FFI();
-	LU_Lejit();
-	LU_Lejit_loop();
-	LU_Lejit_loop_reps();
-	printf("\n");
-	
-	printf("----- MONTE CARLO PI CALC (%d samples) -----\n", NUM_ITERATIONS);
-	MonteCarlo_C();
-	MonteCarlo_FFI();
-	MonteCarlo_Lejit();
-	MonteCarlo_Lejit_loop();
-	MonteCarlo_Lejit_loop_reps();
-	MonteCarlo_Lejit_loop_insitu();
-	printf("\n");
-
-	printf("----- SOR (%d x %d) -----\n", N, N);
-	SOR_C();
-	SOR_FFI();
-	SOR_Lejit();
-	SOR_Lejit_loop_1();
-	SOR_Lejit_loop_3();
-	SOR_Lejit_loop_3_reps();
-	printf("\n");
-	
-	return 0;
-}
\ No newline at end of file